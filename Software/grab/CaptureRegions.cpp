@@ -0,0 +1,89 @@
+/*
+ * CaptureRegions.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CaptureRegions.hpp"
+
+namespace Grab {
+
+namespace {
+
+// Merging is free as long as the merged rectangle captures at most this
+// much more than the two regions did separately.
+const double freeMergeOverhead = 1.25;
+
+inline qint64 pixelsCount(const QRect &rect)
+{
+    return static_cast<qint64>(rect.width()) * rect.height();
+}
+
+inline qint64 mergeOverhead(const QRect &a, const QRect &b)
+{
+    return pixelsCount(a.united(b)) - pixelsCount(a) - pixelsCount(b);
+}
+
+}
+
+QList<QRect> captureRegions(const QList<QRect> &areas, int maxRegions)
+{
+    QList<QRect> regions;
+    for (int i = 0; i < areas.size(); ++i) {
+        if (areas[i].isValid())
+            regions.append(areas[i]);
+    }
+
+    bool isMerged = true;
+    while (isMerged) {
+        isMerged = false;
+        for (int i = 0; i < regions.size() && !isMerged; ++i) {
+            for (int j = i + 1; j < regions.size() && !isMerged; ++j) {
+                const QRect united = regions[i].united(regions[j]);
+                if (pixelsCount(united) <= (pixelsCount(regions[i]) + pixelsCount(regions[j])) * freeMergeOverhead) {
+                    regions[i] = united;
+                    regions.removeAt(j);
+                    isMerged = true;
+                }
+            }
+        }
+    }
+
+    while (regions.size() > qMax(1, maxRegions)) {
+        int bestI = 0, bestJ = 1;
+        qint64 bestOverhead = mergeOverhead(regions[0], regions[1]);
+        for (int i = 0; i < regions.size(); ++i) {
+            for (int j = i + 1; j < regions.size(); ++j) {
+                const qint64 overhead = mergeOverhead(regions[i], regions[j]);
+                if (overhead < bestOverhead) {
+                    bestOverhead = overhead;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        regions[bestI] = regions[bestI].united(regions[bestJ]);
+        regions.removeAt(bestJ);
+    }
+
+    return regions;
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+ * ColorsTripleBuffer.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ColorsTripleBuffer.hpp"
+
+namespace Grab {
+
+ColorsTripleBuffer::ColorsTripleBuffer(int capacity)
+    : m_capacity(capacity)
+    , m_colors(3 * capacity, 0)
+    , m_middle(1)
+    , m_writeSlot(0)
+    , m_readSlot(2)
+{
+    m_counts[0] = m_counts[1] = m_counts[2] = 0;
+}
+
+void ColorsTripleBuffer::publish(int colorsCount)
+{
+    m_counts[m_writeSlot] = qBound(0, colorsCount, m_capacity);
+    // release: colors of the slot are visible to the reader taking it
+    const int previous = m_middle.fetchAndStoreOrdered(m_writeSlot | freshFlag);
+    m_writeSlot = previous & slotMask;
+}
+
+bool ColorsTripleBuffer::fetch()
+{
+    if (!(m_middle.loadAcquire() & freshFlag))
+        return false;
+
+    const int previous = m_middle.fetchAndStoreOrdered(m_readSlot);
+    m_readSlot = previous & slotMask;
+    return true;
+}
+
+}
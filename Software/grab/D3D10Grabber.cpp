@@ -32,8 +32,7 @@
 
 #include <QObject>
 #include <QThread>
-#include <QApplication>
-#include <QDesktopWidget>
+#include <QTimer>
 #include <D3D10_1.h>
 #include <D3D10.h>
 #include <cstdlib>
@@ -102,7 +101,8 @@ class D3D10GrabberImpl: public QObject
 
 public:
     D3D10GrabberImpl(D3D10Grabber &owner, GrabberContext *context, GetHwndCallback_t getHwndCb)
-        : m_sharedMem(NULL),
+        : QObject(&owner),
+          m_sharedMem(NULL),
           m_mutex(NULL),
           m_isStarted(false),
           m_memMap(NULL),
@@ -504,16 +504,17 @@ private:
 
 D3D10Grabber::D3D10Grabber(QObject *parent, GrabberContext *context, GetHwndCallback_t getHwndCb)
     : GrabberBase(parent, context) {
-    m_impl.reset(new D3D10GrabberImpl(*this, context, getHwndCb));
+    // a child, so it follows the grabber to the grab thread
+    m_impl = new D3D10GrabberImpl(*this, context, getHwndCb);
 }
 
 void D3D10Grabber::init() {
     m_impl->init();
-    connect(m_impl.data(), SIGNAL(frameGrabbed()), this, SLOT(grab()));
+    connect(m_impl, SIGNAL(frameGrabbed()), this, SLOT(grab()));
     _screensWithWidgets.clear();
+    // runs in the grab thread, the GUI thread left the screen in the context
     GrabbedScreen grabbedScreen;
-    grabbedScreen.screenInfo.handle = reinterpret_cast<void *>(QApplication::desktop()->primaryScreen());
-    grabbedScreen.screenInfo.rect = QApplication::desktop()->screenGeometry(QApplication::desktop()->primaryScreen());
+    grabbedScreen.screenInfo = _context->primaryScreen();
     _screensWithWidgets.append(grabbedScreen);
 }
 
@@ -573,6 +574,7 @@ GrabResult D3D10Grabber::grabScreens()
 }
 
 D3D10Grabber::~D3D10Grabber() {
+    delete m_impl;
 }
 
 bool D3D10Grabber::isGrabbingStarted() const {
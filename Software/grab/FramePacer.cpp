@@ -0,0 +1,75 @@
+/*
+ * FramePacer.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FramePacer.hpp"
+#include <QtGlobal>
+
+namespace Grab {
+
+namespace {
+// weight of the latest frame in the average cost
+const double costSmoothing = 0.125;
+// headroom left above the frame cost
+const double costHeadroom = 1.25;
+// static content stretches the period by this factor per frame
+const double slowDownFactor = 1.25;
+}
+
+FramePacer::FramePacer()
+    : m_minInterval(50)
+    , m_maxInterval(50)
+    , m_avgCost(0)
+    , m_staticFrames(0)
+    , m_interval(50)
+{
+}
+
+void FramePacer::setBounds(int minIntervalMs, int maxIntervalMs)
+{
+    m_minInterval = qMax(minIntervalMs, 0);
+    m_maxInterval = qMax(maxIntervalMs, m_minInterval);
+    m_interval = qBound(fastestInterval(), m_interval, m_maxInterval);
+}
+
+int FramePacer::update(double costMs, int change)
+{
+    m_avgCost += (costMs - m_avgCost) * costSmoothing;
+
+    if (change >= MotionThreshold) {
+        m_staticFrames = 0;
+        m_interval = fastestInterval();
+    } else if (++m_staticFrames > StaticFramesToSlowDown) {
+        const int slowedDown = qRound(m_interval * slowDownFactor) + 1;
+        m_interval = qMin(slowedDown, m_maxInterval);
+    }
+    m_interval = qMax(m_interval, fastestInterval());
+    return m_interval;
+}
+
+int FramePacer::fastestInterval() const
+{
+    const int costBound = qRound(m_avgCost * costHeadroom);
+    return qBound(m_minInterval, costBound, m_maxInterval);
+}
+
+}
@@ -25,10 +25,12 @@
 
 #include "GrabberBase.hpp"
 
+#include <QElapsedTimer>
 #include "common/DebugOut.hpp"
 #include "common/PrintHelpers.hpp"
 #include "GrabbedArea.hpp"
 #include "GrabberContext.hpp"
+#include "CaptureRegions.hpp"
 
 namespace
 {
@@ -51,10 +53,31 @@ inline QRect & getValidRect(QRect & rect)
     return rect;
 }
 
+const int bytesPerPixel = 4;
+
+inline unsigned int pitchOf(const GrabbedScreen &screen)
+{
+    return screen.imgPitch ? screen.imgPitch : screen.screenInfo.rect.width() * bytesPerPixel;
+}
+
+// Below this amount of pixels per frame waking up the workers costs more
+// than it saves, so areas are reduced on the grabbing thread.
+const int parallelReductionMinPixels = 128 * 1024;
+const int reductionBandPixels = 32 * 1024;
+
+// Clusters of areas that get their own summed-area table. Tables of close
+// clusters are merged beyond it.
+const int maxIntegralImagesPerScreen = 16;
+
 } // anonymous namespace
 
 
-GrabberBase::GrabberBase(QObject *parent, GrabberContext *grabberContext) : QObject(parent)
+GrabberBase::GrabberBase(QObject *parent, GrabberContext *grabberContext)
+    : QObject(parent)
+    , m_reductionMode(Grab::ReductionModeDefault)
+    , m_sampleBudget(256)
+    , m_idleGrabInterval(0)
+    , m_colorsChange(0)
 {
     _context = grabberContext;
     if (m_timer && m_timer->isActive())
@@ -66,7 +89,18 @@ GrabberBase::GrabberBase(QObject *parent, GrabberContext *grabberContext) : QObj
 void GrabberBase::setGrabInterval(int msec)
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO <<  this->metaObject()->className();
-    m_timer->setInterval(msec);
+    m_framePacer.setBounds(msec, m_idleGrabInterval);
+    m_timer->setInterval(m_framePacer.interval());
+    emit grabIntervalChanged(m_framePacer.interval());
+}
+
+void GrabberBase::setIdleGrabInterval(int msec)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO <<  this->metaObject()->className() << msec;
+    m_idleGrabInterval = msec;
+    m_framePacer.setBounds(m_framePacer.minInterval(), msec);
+    m_timer->setInterval(m_framePacer.interval());
+    emit grabIntervalChanged(m_framePacer.interval());
 }
 
 void GrabberBase::startGrabbing()
@@ -89,18 +123,71 @@ bool GrabberBase::isGrabbingStarted() const
     return m_timer->isActive();
 }
 
-const GrabbedScreen * GrabberBase::screenOfRect(const QRect &rect) const
+void GrabberBase::setReductionMode(Grab::ReductionMode mode)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << this->metaObject()->className() << mode;
+    m_reductionMode = mode;
+    if (m_reductionMode != Grab::ReductionModeIntegralImage) {
+        m_integralImages.clear();
+        m_integralImageScreens.clear();
+        m_integralImageRects.clear();
+        m_integralImageOfArea.clear();
+        m_integralImageAreas.clear();
+    }
+    if (m_reductionMode != Grab::ReductionModeSparseSampling)
+        m_samplePatterns.clear();
+    m_reducedAreas.clear();
+}
+
+void GrabberBase::setSampleBudget(int samplesPerArea)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << this->metaObject()->className() << samplesPerArea;
+    // patterns notice the new budget and rebuild on the next frame
+    m_sampleBudget = samplesPerArea;
+    m_reducedAreas.clear();
+}
+
+void GrabberBase::setReductionThreads(int threadsCount)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << this->metaObject()->className() << threadsCount;
+    m_reductionPool.setThreadsCount(threadsCount);
+}
+
+int GrabberBase::screenIndexOfRect(const QRect &rect) const
 {
+    // grabbers capturing parts of a screen may report overlapping rects,
+    // the one holding the whole area wins then
+    for (int i = 0; i < _screensWithWidgets.size(); ++i) {
+        if (_screensWithWidgets[i].screenInfo.rect.contains(rect))
+            return i;
+    }
     QPoint center = rect.center();
     for (int i = 0; i < _screensWithWidgets.size(); ++i) {
         if (_screensWithWidgets[i].screenInfo.rect.contains(center))
-            return &_screensWithWidgets[i];
+            return i;
     }
     for (int i = 0; i < _screensWithWidgets.size(); ++i) {
         if (_screensWithWidgets[i].screenInfo.rect.intersects(rect))
-            return &_screensWithWidgets[i];
+            return i;
     }
-    return NULL;
+    return -1;
+}
+
+const GrabbedScreen * GrabberBase::screenOfRect(const QRect &rect) const
+{
+    const int screenIndex = screenIndexOfRect(rect);
+    return screenIndex < 0 ? NULL : &_screensWithWidgets[screenIndex];
+}
+
+bool GrabberBase::isAreaDamaged(int screenIndex, const QRect &rect) const
+{
+    Q_UNUSED(screenIndex);
+    Q_UNUSED(rect);
+    return true;
+}
+
+void GrabberBase::prefetchScreens()
+{
 }
 
 bool GrabberBase::isReallocationNeeded(const QList< ScreenInfo > &screensWithWidgets) const
@@ -118,6 +205,9 @@ bool GrabberBase::isReallocationNeeded(const QList< ScreenInfo > &screensWithWid
 void GrabberBase::grab()
 {
     DEBUG_MID_LEVEL << Q_FUNC_INFO << this->metaObject()->className();
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    _context->syncGrabbedAreas();
     QList< ScreenInfo > screens2Grab;
     screens2Grab.reserve(5);
     screensWithWidgets(&screens2Grab, *_context->grabWidgets);
@@ -131,57 +221,262 @@ void GrabberBase::grab()
     _lastGrabResult = grabScreens();
     ++grabScreensCount;
     if (_lastGrabResult == GrabResultOk) {
-        _context->grabResult->clear();
+        prefetchScreens();
+        prepareAreas();
+        if (m_reductionMode == Grab::ReductionModeIntegralImage)
+            buildIntegralImages();
+        else if (m_reductionMode == Grab::ReductionModeSparseSampling)
+            updateSamplePatterns();
+        reduceAreas();
+        updateGrabInterval(frameTimer.nsecsElapsed() / 1e6, m_colorsChange);
+    } else if (_lastGrabResult == GrabResultFrameNotReady) {
+        updateGrabInterval(frameTimer.nsecsElapsed() / 1e6, 0);
+    }
+    emit frameGrabAttempted(_lastGrabResult);
+}
 
-        for (int i = 0; i < _context->grabWidgets->size(); ++i) {
-            QRect widgetRect = _context->grabWidgets->at(i)->geometry();
-            getValidRect(widgetRect);
+void GrabberBase::prepareAreas()
+{
+    const int areasCount = _context->grabWidgets->size();
+    m_preparedAreas.resize(areasCount);
 
-            const GrabbedScreen *grabbedScreen = screenOfRect(widgetRect);
-            if (grabbedScreen == NULL) {
-                DEBUG_HIGH_LEVEL << Q_FUNC_INFO << " widget is out of screen " << Debug::toString(widgetRect);
-                _context->grabResult->append(0);
-                continue;
-            }
-            DEBUG_HIGH_LEVEL << Q_FUNC_INFO << Debug::toString(widgetRect);
-            QRect monitorRect = grabbedScreen->screenInfo.rect;
+    for (int i = 0; i < areasCount; ++i) {
+        PreparedArea &area = m_preparedAreas[i];
+        area.screenIndex = -1;
+        area.fallbackColor = qRgb(0,0,0);
+
+        // disabled areas may be left out of partial captures, keep them black
+        if (!_context->grabWidgets->at(i)->isEnabled())
+            continue;
+
+        QRect widgetRect = _context->grabWidgets->at(i)->geometry();
+        getValidRect(widgetRect);
 
-            QRect clippedRect = monitorRect.intersected(widgetRect);
+        const int screenIndex = screenIndexOfRect(widgetRect);
+        if (screenIndex < 0) {
+            DEBUG_HIGH_LEVEL << Q_FUNC_INFO << " widget is out of screen " << Debug::toString(widgetRect);
+            area.fallbackColor = 0;
+            continue;
+        }
+        DEBUG_HIGH_LEVEL << Q_FUNC_INFO << Debug::toString(widgetRect);
+        QRect monitorRect = _screensWithWidgets[screenIndex].screenInfo.rect;
+
+        QRect clippedRect = monitorRect.intersected(widgetRect);
 
-            // Checking for the 'grabme' widget position inside the monitor that is used to capture color
-            if( !clippedRect.isValid() ){
+        // Checking for the 'grabme' widget position inside the monitor that is used to capture color
+        if( !clippedRect.isValid() ){
 
-                DEBUG_MID_LEVEL << "Widget 'grabme' is out of screen:" << Debug::toString(clippedRect);
+            DEBUG_MID_LEVEL << "Widget 'grabme' is out of screen:" << Debug::toString(clippedRect);
+            continue;
+        }
 
-                _context->grabResult->append(qRgb(0,0,0));
-                continue;
+        // Convert coordinates from "Main" desktop coord-system to capture-monitor coord-system
+        QRect preparedRect = clippedRect.translated(-monitorRect.x(), -monitorRect.y());
+
+        // Align width by 4 for accelerated calculations
+        preparedRect.setWidth(preparedRect.width() - (preparedRect.width() % 4));
+
+        if( !preparedRect.isValid() ){
+            qWarning() << Q_FUNC_INFO << " preparedRect is not valid:" << Debug::toString(preparedRect);
+            // width and height can't be negative
+            continue;
+        }
+
+        area.screenIndex = screenIndex;
+        area.rect = preparedRect;
+    }
+}
+
+void GrabberBase::planIntegralImages()
+{
+    m_integralImageAreas = m_preparedAreas;
+    m_integralImageOfArea.fill(-1, m_preparedAreas.size());
+    m_integralImageScreens.clear();
+    m_integralImageRects.clear();
+
+    // A table over the bounding box of all areas is the whole screen once
+    // there are edge strips, so areas are integrated in the same clusters
+    // partial captures are planned with.
+    for (int screenIndex = 0; screenIndex < _screensWithWidgets.size(); ++screenIndex) {
+        QList<QRect> areaRects;
+        for (int i = 0; i < m_preparedAreas.size(); ++i) {
+            if (m_preparedAreas[i].screenIndex == screenIndex)
+                areaRects.append(m_preparedAreas[i].rect);
+        }
+
+        const QList<QRect> regions = Grab::captureRegions(areaRects, maxIntegralImagesPerScreen);
+        for (int r = 0; r < regions.size(); ++r) {
+            const int tableIndex = m_integralImageRects.size();
+            m_integralImageScreens.append(screenIndex);
+            m_integralImageRects.append(regions[r]);
+
+            for (int i = 0; i < m_preparedAreas.size(); ++i) {
+                if (m_integralImageOfArea[i] < 0
+                    && m_preparedAreas[i].screenIndex == screenIndex
+                    && regions[r].contains(m_preparedAreas[i].rect))
+                    m_integralImageOfArea[i] = tableIndex;
             }
+        }
+    }
+}
+
+void GrabberBase::buildIntegralImages()
+{
+    // Clustering is quadratic in areas count, redo it only when the layout changes
+    bool isPlanned = m_integralImageAreas.size() == m_preparedAreas.size();
+    for (int i = 0; isPlanned && i < m_preparedAreas.size(); ++i) {
+        isPlanned = m_integralImageAreas[i].screenIndex == m_preparedAreas[i].screenIndex
+            && m_integralImageAreas[i].rect == m_preparedAreas[i].rect;
+    }
+    if (!isPlanned)
+        planIntegralImages();
+
+    m_integralImages.resize(m_integralImageRects.size());
+    for (int i = 0; i < m_integralImageRects.size(); ++i) {
+        const GrabbedScreen &grabbedScreen = _screensWithWidgets[m_integralImageScreens[i]];
+        m_integralImages[i].build(grabbedScreen.imgData, grabbedScreen.imgFormat, pitchOf(grabbedScreen), m_integralImageRects[i]);
+    }
+}
+
+void GrabberBase::updateSamplePatterns()
+{
+    m_samplePatterns.resize(m_preparedAreas.size());
+    for (int i = 0; i < m_preparedAreas.size(); ++i) {
+        const PreparedArea &area = m_preparedAreas[i];
+        if (area.screenIndex < 0)
+            continue;
+        m_samplePatterns[i].update(pitchOf(_screensWithWidgets[area.screenIndex]), area.rect, m_sampleBudget);
+    }
+}
+
+QRgb GrabberBase::reduceArea(int areaIndex) const
+{
+    const PreparedArea &area = m_preparedAreas[areaIndex];
+    const GrabbedScreen &grabbedScreen = _screensWithWidgets[area.screenIndex];
+    QRgb avgColor;
+
+    const int tableIndex = areaIndex < m_integralImageOfArea.size() ? m_integralImageOfArea[areaIndex] : -1;
 
-            // Convert coordinates from "Main" desktop coord-system to capture-monitor coord-system
-            QRect preparedRect = clippedRect.translated(-monitorRect.x(), -monitorRect.y());
+    if (m_reductionMode == Grab::ReductionModeIntegralImage
+        && tableIndex >= 0
+        && m_integralImages[tableIndex].isValid()) {
+        m_integralImages[tableIndex].calculateAvgColor(&avgColor, area.rect);
+    } else if (m_reductionMode == Grab::ReductionModeSparseSampling
+               && areaIndex < m_samplePatterns.size()) {
+        Grab::Calculations::calculateAvgColor(&avgColor, grabbedScreen.imgData, grabbedScreen.imgFormat, m_samplePatterns[areaIndex]);
+    } else {
+        Grab::Calculations::calculateAvgColor(&avgColor, grabbedScreen.imgData, grabbedScreen.imgFormat, pitchOf(grabbedScreen), area.rect);
+    }
+    return avgColor;
+}
+
+int GrabberBase::prepareReductionJobs()
+{
+    m_reductionJobs.resize(0);
+    int pixelsCount = 0;
+
+    for (int i = 0; i < m_preparedAreas.size(); ++i) {
+        const PreparedArea &area = m_preparedAreas[i];
+        if (area.screenIndex < 0)
+            continue;
 
-            // Align width by 4 for accelerated calculations
-            preparedRect.setWidth(preparedRect.width() - (preparedRect.width() % 4));
+        // color of the previous frame is still valid
+        if (i < m_reducedAreas.size()
+            && m_reducedAreas[i].screenIndex == area.screenIndex
+            && m_reducedAreas[i].rect == area.rect
+            && !isAreaDamaged(area.screenIndex, area.rect))
+            continue;
 
-            if( !preparedRect.isValid() ){
-                qWarning() << Q_FUNC_INFO << " preparedRect is not valid:" << Debug::toString(preparedRect);
-                // width and height can't be negative
+        ReductionJob job;
+        job.areaIndex = i;
+        job.rect = area.rect;
 
-                _context->grabResult->append(qRgb(0,0,0));
-                continue;
+        if (m_reductionMode == Grab::ReductionModePerArea) {
+            const int areaPixels = area.rect.width() * area.rect.height();
+            const int bandsCount = qBound(1, areaPixels / reductionBandPixels, area.rect.height());
+            for (int band = 0; band < bandsCount; ++band) {
+                const int top = area.rect.height() * band / bandsCount;
+                const int bottom = area.rect.height() * (band + 1) / bandsCount;
+                job.rect = QRect(area.rect.x(), area.rect.y() + top, area.rect.width(), bottom - top);
+                m_reductionJobs.append(job);
             }
+            pixelsCount += areaPixels;
+        } else {
+            m_reductionJobs.append(job);
+            if (m_reductionMode == Grab::ReductionModeSparseSampling && i < m_samplePatterns.size())
+                pixelsCount += m_samplePatterns[i].offsets().size();
+        }
+    }
+    return pixelsCount;
+}
+
+void GrabberBase::runReductionJob(int jobIndex)
+{
+    ReductionJob &job = m_reductionJobs[jobIndex];
+    if (m_reductionMode == Grab::ReductionModePerArea) {
+        const GrabbedScreen &grabbedScreen = _screensWithWidgets[m_preparedAreas[job.areaIndex].screenIndex];
+        job.sums = Grab::Calculations::ColorSums();
+        Grab::Calculations::accumulateColor(&job.sums, grabbedScreen.imgData, grabbedScreen.imgFormat, pitchOf(grabbedScreen), job.rect);
+    } else {
+        m_areaColors[job.areaIndex] = reduceArea(job.areaIndex);
+    }
+}
 
-            using namespace Grab;
-            const int bytesPerPixel = 4;
-            QRgb avgColor;
-            if (_context->grabWidgets->at(i)->isEnabled()) {
-                Calculations::calculateAvgColor(&avgColor, grabbedScreen->imgData, grabbedScreen->imgFormat, grabbedScreen->screenInfo.rect.width() * bytesPerPixel, preparedRect );
-                _context->grabResult->append(avgColor);
-            } else {
-                _context->grabResult->append(qRgb(0,0,0));
+void GrabberBase::reduceAreas()
+{
+    const int pixelsCount = prepareReductionJobs();
+    m_areaColors.resize(m_preparedAreas.size());
+
+    if (pixelsCount >= parallelReductionMinPixels) {
+        ReductionTask task(this);
+        m_reductionPool.run(m_reductionJobs.size(), &task);
+    } else {
+        for (int i = 0; i < m_reductionJobs.size(); ++i)
+            runReductionJob(i);
+    }
+
+    if (m_reductionMode == Grab::ReductionModePerArea) {
+        // bands of an area are consecutive jobs
+        for (int i = 0; i < m_reductionJobs.size();) {
+            const int areaIndex = m_reductionJobs[i].areaIndex;
+            Grab::Calculations::ColorSums sums;
+            for (; i < m_reductionJobs.size() && m_reductionJobs[i].areaIndex == areaIndex; ++i) {
+                sums.r += m_reductionJobs[i].sums.r;
+                sums.g += m_reductionJobs[i].sums.g;
+                sums.b += m_reductionJobs[i].sums.b;
+                sums.count += m_reductionJobs[i].sums.count;
             }
+            Grab::Calculations::averageColor(&m_areaColors[areaIndex], sums);
         }
+    }
+
+    m_reducedAreas = m_preparedAreas;
 
+    Grab::ColorsTripleBuffer &grabbedColors = _context->grabbedColors;
+    QRgb *colors = grabbedColors.writeBuffer();
+    const int colorsCount = qMin(m_preparedAreas.size(), grabbedColors.capacity());
+    // a changed set of areas counts as motion
+    m_colorsChange = colorsCount == m_publishedColors.size() ? 0 : 255;
+    m_publishedColors.resize(colorsCount);
+    for (int i = 0; i < colorsCount; ++i) {
+        const PreparedArea &area = m_preparedAreas[i];
+        colors[i] = area.screenIndex < 0 ? area.fallbackColor : m_areaColors[i];
+        const QRgb previous = m_publishedColors[i];
+        m_colorsChange = qMax(m_colorsChange, qAbs(qRed(colors[i]) - qRed(previous)));
+        m_colorsChange = qMax(m_colorsChange, qAbs(qGreen(colors[i]) - qGreen(previous)));
+        m_colorsChange = qMax(m_colorsChange, qAbs(qBlue(colors[i]) - qBlue(previous)));
+        m_publishedColors[i] = colors[i];
+    }
+    grabbedColors.publish(colorsCount);
+}
+
+void GrabberBase::updateGrabInterval(double frameCostMs, int colorsChange)
+{
+    const int previousInterval = m_framePacer.interval();
+    const int interval = m_framePacer.update(frameCostMs, colorsChange);
+    if (interval != previousInterval) {
+        DEBUG_MID_LEVEL << Q_FUNC_INFO << this->metaObject()->className() << interval;
+        m_timer->setInterval(interval);
+        emit grabIntervalChanged(interval);
     }
-    emit frameGrabAttempted(_lastGrabResult);
 }
@@ -80,3 +80,47 @@ void GrabberContext::freeReleasedBufs() {
         _allocatedBufs.erase(avails, _allocatedBufs.end());
     }
 }
+
+void GrabberContext::updateGrabbedAreas(const GrabberBase::GrabbedAreas &areas) {
+    bool isChanged = areas.size() != m_lastAreas.size();
+    m_lastAreas.resize(areas.size());
+    for (int i = 0; i < areas.size(); ++i) {
+        const GrabbedAreaCopy area(*areas[i]);
+        if (area != m_lastAreas[i]) {
+            m_lastAreas[i] = area;
+            isChanged = true;
+        }
+    }
+    if (!isChanged)
+        return;
+
+    QMutexLocker locker(&m_areasMutex);
+    m_updatedAreas = m_lastAreas;
+    m_isAreasUpdated.storeRelease(1);
+}
+
+void GrabberContext::syncGrabbedAreas() {
+    // the lock is taken only when areas were moved or toggled
+    if (!m_isAreasUpdated.loadAcquire())
+        return;
+
+    {
+        QMutexLocker locker(&m_areasMutex);
+        m_areaCopies = m_updatedAreas;
+        m_isAreasUpdated.storeRelease(0);
+    }
+
+    m_areas.clear();
+    for (int i = 0; i < m_areaCopies.size(); ++i)
+        m_areas.append(&m_areaCopies[i]);
+}
+
+void GrabberContext::setPrimaryScreen(const ScreenInfo &screen) {
+    QMutexLocker locker(&m_areasMutex);
+    m_primaryScreen = screen;
+}
+
+ScreenInfo GrabberContext::primaryScreen() {
+    QMutexLocker locker(&m_areasMutex);
+    return m_primaryScreen;
+}
@@ -0,0 +1,106 @@
+/*
+ * ReductionPool.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ReductionPool.hpp"
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+
+namespace Grab {
+
+namespace {
+
+struct SharedJobs {
+    SharedJobs(int jobsCount, ParallelTask *task)
+        : jobsCount(jobsCount)
+        , task(task)
+        , nextJob(0)
+    {}
+
+    void runPending() {
+        int jobIndex;
+        while ((jobIndex = nextJob.fetchAndAddOrdered(1)) < jobsCount)
+            task->run(jobIndex);
+    }
+
+    const int jobsCount;
+    ParallelTask * const task;
+    QAtomicInt nextJob;
+    QSemaphore finishedWorkers;
+};
+
+class Worker : public QRunnable {
+public:
+    explicit Worker(SharedJobs *jobs) : m_jobs(jobs) {}
+
+    virtual void run() {
+        m_jobs->runPending();
+        m_jobs->finishedWorkers.release();
+    }
+
+private:
+    SharedJobs *m_jobs;
+};
+
+}
+
+ReductionPool::ReductionPool()
+    : m_threadsCount(1)
+{
+    // keep threads alive between frames instead of respawning them
+    m_workers.setExpiryTimeout(-1);
+    m_workers.setMaxThreadCount(1);
+}
+
+ReductionPool::~ReductionPool()
+{
+    m_workers.waitForDone();
+}
+
+void ReductionPool::setThreadsCount(int threadsCount)
+{
+    if (threadsCount <= 0)
+        threadsCount = QThread::idealThreadCount();
+    m_threadsCount = qMax(1, threadsCount);
+    m_workers.setMaxThreadCount(qMax(1, m_threadsCount - 1));
+}
+
+void ReductionPool::run(int jobsCount, ParallelTask *task)
+{
+    const int workersCount = qMin(m_threadsCount, jobsCount) - 1;
+    if (workersCount <= 0) {
+        for (int i = 0; i < jobsCount; ++i)
+            task->run(i);
+        return;
+    }
+
+    SharedJobs jobs(jobsCount, task);
+    for (int i = 0; i < workersCount; ++i)
+        m_workers.start(new Worker(&jobs));
+
+    jobs.runPending();
+    jobs.finishedWorkers.acquire(workersCount);
+}
+
+}
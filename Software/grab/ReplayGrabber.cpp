@@ -0,0 +1,230 @@
+/*
+ * ReplayGrabber.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ReplayGrabber.hpp"
+
+#ifdef REPLAY_GRAB_SUPPORT
+
+#include <limits.h>
+#include <string.h>
+#include "common/DebugOut.hpp"
+#include "calculations.hpp"
+
+namespace Grab {
+
+const char ReplayFileHeader::Magic[8] = {'P', 'R', 'S', 'M', 'R', 'A', 'W', '\0'};
+
+void ReplayFileHeader::init(int width, int height, int pitch, BufferFormat format, int framesCount)
+{
+    memcpy(this->magic, Magic, sizeof(Magic));
+    this->version = Version;
+    this->width = width;
+    this->height = height;
+    this->pitch = pitch;
+    this->format = format;
+    this->framesCount = framesCount;
+}
+
+bool ReplayFileHeader::isValid(qint64 fileSize) const
+{
+    if (memcmp(magic, Magic, sizeof(Magic)) != 0 || version != Version)
+        return false;
+    // frames are addressed by int and the screen is a QRect
+    const quint32 maxInt = INT_MAX;
+    if (width == 0 || height == 0 || framesCount == 0
+        || width > maxInt / 4 || height > maxInt || framesCount > maxInt)
+        return false;
+    if (static_cast<qint64>(pitch) < static_cast<qint64>(width) * 4)
+        return false;
+    // only formats the reduction code has channel offsets for
+    Calculations::ChannelOffsets offsets;
+    if (!Calculations::channelOffsets(static_cast<BufferFormat>(format), &offsets))
+        return false;
+    const qint64 framesSize = fileSize - static_cast<qint64>(sizeof(ReplayFileHeader));
+    return framesSize >= 0 && frameSize() <= framesSize / framesCount;
+}
+
+}
+
+ReplayGrabber::ReplayGrabber(QObject *parent, GrabberContext *context)
+    : GrabberBase(parent, context)
+    , m_mappedData(NULL)
+    , m_frameRate(0)
+    , m_requestedGrabInterval(0)
+    , m_requestedIdleGrabInterval(0)
+    , m_currentFrame(-1)
+{
+    memset(&m_header, 0, sizeof(m_header));
+    m_replayClock.start();
+}
+
+ReplayGrabber::~ReplayGrabber()
+{
+    closeReplayFile();
+}
+
+int ReplayGrabber::framesCount() const
+{
+    return m_mappedData ? m_header.framesCount : 0;
+}
+
+bool ReplayGrabber::setReplayFile(const QString &fileName)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << fileName;
+    closeReplayFile();
+    if (fileName.isEmpty())
+        return true;
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << "couldn't open" << fileName << m_file.errorString();
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(m_header))) {
+        qWarning() << Q_FUNC_INFO << fileName << "is too short for a replay";
+        m_file.close();
+        return false;
+    }
+
+    uchar *mappedData = m_file.map(0, fileSize);
+    if (!mappedData) {
+        qWarning() << Q_FUNC_INFO << "couldn't map" << fileName << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    memcpy(&m_header, mappedData, sizeof(m_header));
+    if (!m_header.isValid(fileSize)) {
+        qWarning() << Q_FUNC_INFO << fileName << "has invalid replay header";
+        m_file.unmap(mappedData);
+        m_file.close();
+        memset(&m_header, 0, sizeof(m_header));
+        return false;
+    }
+
+    m_mappedData = mappedData;
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << m_header.width << "x" << m_header.height
+                    << "pitch" << m_header.pitch << "frames" << m_header.framesCount;
+    return true;
+}
+
+void ReplayGrabber::setReplayFrameRate(int fps)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << fps;
+    m_frameRate = qMax(fps, 0);
+    m_replayClock.start();
+    // grab intervals depend on the mode
+    setGrabInterval(m_requestedGrabInterval);
+    setIdleGrabInterval(m_requestedIdleGrabInterval);
+}
+
+void ReplayGrabber::startGrabbing()
+{
+    m_replayClock.start();
+    GrabberBase::startGrabbing();
+}
+
+void ReplayGrabber::setGrabInterval(int msec)
+{
+    m_requestedGrabInterval = msec;
+    GrabberBase::setGrabInterval(m_frameRate ? msec : 0);
+}
+
+void ReplayGrabber::setIdleGrabInterval(int msec)
+{
+    m_requestedIdleGrabInterval = msec;
+    GrabberBase::setIdleGrabInterval(m_frameRate ? msec : 0);
+}
+
+QList< ScreenInfo > * ReplayGrabber::screensWithWidgets(QList< ScreenInfo > * result, const GrabbedAreas& grabWidgets)
+{
+    Q_UNUSED(grabWidgets);
+    result->clear();
+    if (m_mappedData) {
+        ScreenInfo screenInfo;
+        screenInfo.rect = QRect(0, 0, m_header.width, m_header.height);
+        result->append(screenInfo);
+    }
+    return result;
+}
+
+bool ReplayGrabber::reallocate(const QList< ScreenInfo > &grabScreens)
+{
+    _screensWithWidgets.clear();
+    if (!m_mappedData || grabScreens.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "no replay file";
+        return false;
+    }
+
+    // replay has a single screen, see screensWithWidgets()
+    GrabbedScreen grabScreen;
+    grabScreen.imgData = const_cast<uchar *>(frameData(0));
+    grabScreen.imgDataSize = m_header.frameSize();
+    grabScreen.imgFormat = static_cast<BufferFormat>(m_header.format);
+    grabScreen.imgPitch = m_header.pitch;
+    grabScreen.screenInfo = grabScreens.first();
+    _screensWithWidgets.append(grabScreen);
+    return true;
+}
+
+GrabResult ReplayGrabber::grabScreens()
+{
+    if (!m_mappedData || _screensWithWidgets.isEmpty())
+        return GrabResultError;
+
+    int frame;
+    if (m_frameRate == 0) {
+        frame = (m_currentFrame + 1) % m_header.framesCount;
+    } else {
+        frame = (m_replayClock.elapsed() * m_frameRate / 1000) % m_header.framesCount;
+        if (frame == m_currentFrame)
+            return GrabResultFrameNotReady;
+    }
+
+    m_currentFrame = frame;
+    _screensWithWidgets[0].imgData = const_cast<uchar *>(frameData(frame));
+    return GrabResultOk;
+}
+
+void ReplayGrabber::closeReplayFile()
+{
+    if (m_mappedData) {
+        m_file.unmap(m_mappedData);
+        m_mappedData = NULL;
+    }
+    if (m_file.isOpen())
+        m_file.close();
+    memset(&m_header, 0, sizeof(m_header));
+    m_currentFrame = -1;
+    // screens point into the mapping
+    _screensWithWidgets.clear();
+}
+
+const uchar * ReplayGrabber::frameData(int frame) const
+{
+    return m_mappedData + sizeof(m_header) + m_header.frameSize() * frame;
+}
+
+#endif // REPLAY_GRAB_SUPPORT
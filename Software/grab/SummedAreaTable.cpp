@@ -0,0 +1,115 @@
+/*
+ * SummedAreaTable.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SummedAreaTable.hpp"
+#include <cstring>
+#include "calculations.hpp"
+
+namespace Grab {
+
+namespace {
+static const int bytesPerPixel = 4;
+}
+
+SummedAreaTable::SummedAreaTable()
+    : m_stride(0)
+{
+}
+
+void SummedAreaTable::clear()
+{
+    m_sums.clear();
+    m_rect = QRect();
+    m_stride = 0;
+}
+
+bool SummedAreaTable::build(const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect)
+{
+    Calculations::ChannelOffsets offsets;
+    if (!rect.isValid() || !Calculations::channelOffsets(bufferFormat, &offsets)) {
+        clear();
+        return false;
+    }
+
+    const int width = rect.width();
+    const int height = rect.height();
+    m_rect = rect;
+    m_stride = width + 1;
+    // QVector keeps its capacity, so same-sized frames don't reallocate
+    m_sums.resize(m_stride * (height + 1));
+
+    Sum *table = m_sums.data();
+    memset(table, 0, m_stride * sizeof(Sum));
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *pixel = buffer + pitch * (rect.y() + y) + rect.x() * bytesPerPixel;
+        Sum *row = table + (y + 1) * m_stride;
+        const Sum *above = row - m_stride;
+
+        // Unsigned sums wrap exactly like the accumulators of calculateAvgColor,
+        // so corner differences stay exact even past 2^32.
+        unsigned int r = 0, g = 0, b = 0;
+        row[0].r = row[0].g = row[0].b = 0;
+        for (int x = 1; x <= width; ++x) {
+            r += pixel[offsets.r];
+            g += pixel[offsets.g];
+            b += pixel[offsets.b];
+            row[x].r = above[x].r + r;
+            row[x].g = above[x].g + g;
+            row[x].b = above[x].b + b;
+            pixel += bytesPerPixel;
+        }
+    }
+    return true;
+}
+
+QRgb SummedAreaTable::calculateAvgColor(QRgb *result, const QRect &rect) const
+{
+    Q_ASSERT_X(m_rect.contains(rect), "average color calculation", "rect is out of summed area table");
+
+    const int left = rect.x() - m_rect.x();
+    const int top = rect.y() - m_rect.y();
+    const int right = left + rect.width();
+    const int bottom = top + rect.height();
+
+    const Sum &br = at(right, bottom);
+    const Sum &bl = at(left, bottom);
+    const Sum &tr = at(right, top);
+    const Sum &tl = at(left, top);
+
+    int r = br.r - bl.r - tr.r + tl.r;
+    int g = br.g - bl.g - tr.g + tl.g;
+    int b = br.b - bl.b - tr.b + tl.b;
+
+    const int count = rect.width() * rect.height();
+    if ( count > 1 ) {
+        r = ( r / count) & 0xff;
+        g = ( g / count) & 0xff;
+        b = ( b / count) & 0xff;
+    }
+
+    *result = qRgb(r, g, b);
+    return *result;
+}
+
+}
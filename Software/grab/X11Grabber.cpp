@@ -28,70 +28,249 @@
 #ifdef X11_GRAB_SUPPORT
 
 #include <X11/Xutil.h>
-// x shared-mem extension
+#include <X11/Xlib-xcb.h>
+// x shared-mem extension, used through xcb for asynchronous requests
 #include <sys/shm.h>
-#include <X11/extensions/XShm.h>
+#include <xcb/shm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
 #include <cmath>
 #include <sys/ipc.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
 
 #include "common/DebugOut.hpp"
+#include "CaptureRegions.hpp"
+#include "GrabbedArea.hpp"
 
+namespace {
+// Every region costs a request to the X server
+const int maxCaptureRegionsPerScreen = 8;
+const int bytesPerPixel = 4;
+
+bool intersectsAny(const QList<QRect> &rects, const QRect &rect)
+{
+    for (int i = 0; i < rects.size(); ++i) {
+        if (rects[i].intersects(rect))
+            return true;
+    }
+    return false;
+}
+}
+
+struct X11ShmBuffer
+{
+    X11ShmBuffer()
+        : shmid(-1)
+        , shmaddr(NULL)
+        , segment(0)
+    {}
+
+    int shmid;
+    unsigned char *shmaddr;
+    xcb_shm_seg_t segment;
+};
+
+/*!
+  Capture of a region is double buffered: GrabberBase reduces the front
+  buffer while the X server fills the back one with the next frame.
+*/
 struct X11GrabberData
 {
     X11GrabberData()
-        : image(NULL)
+        : front(0)
+        , isPending(false)
     {
-        memset(&shminfo, 0, sizeof(shminfo));
+        cookie.sequence = 0;
     }
 
-    XImage *image;
-    XShmSegmentInfo shminfo;
+    unsigned char * frontData() const { return buffers[front].shmaddr; }
+    const X11ShmBuffer & back() const { return buffers[front ^ 1]; }
+
+    X11ShmBuffer buffers[2];
+    int front;
+    bool isPending;
+    xcb_shm_get_image_cookie_t cookie;
 };
 
 X11Grabber::X11Grabber(QObject *parent, GrabberContext * context)
     : GrabberBase(parent, context)
+    , m_isDamageSupported(false)
+    , m_damageEventBase(0)
+    , m_damagedRegion(0)
+    , m_isFullGrabPending(true)
+    , m_isFullGrab(true)
+    , m_isRequestedFull(true)
+    , m_isReducedFull(true)
 {
     _display = XOpenDisplay(NULL);
+    m_connection = XGetXCBConnection(_display);
+    initDamage();
 }
 
 X11Grabber::~X11Grabber()
 {
     freeScreens();
+    freeDamage();
     XCloseDisplay(_display);
 }
 
+void X11Grabber::initDamage()
+{
+    int damageErrorBase, fixesEventBase, fixesErrorBase;
+    if (!XDamageQueryExtension(_display, &m_damageEventBase, &damageErrorBase)
+        || !XFixesQueryExtension(_display, &fixesEventBase, &fixesErrorBase)) {
+        qWarning() << Q_FUNC_INFO << "XDamage extension is not available, every frame will be grabbed";
+        return;
+    }
+
+    for (int i = 0; i < ScreenCount(_display); ++i)
+        m_damages.append(XDamageCreate(_display, RootWindow(_display, i), XDamageReportNonEmpty));
+    m_damagedRects.resize(m_damages.size());
+    m_damagedRegion = XFixesCreateRegion(_display, NULL, 0);
+    m_isDamageSupported = true;
+}
+
+void X11Grabber::freeDamage()
+{
+    if (!m_isDamageSupported)
+        return;
+
+    for (int i = 0; i < m_damages.size(); ++i)
+        XDamageDestroy(_display, m_damages[i]);
+    m_damages.clear();
+    XFixesDestroyRegion(_display, m_damagedRegion);
+    m_isDamageSupported = false;
+}
+
+void X11Grabber::fetchDamage()
+{
+    m_isFullGrab = m_isFullGrabPending || !m_isDamageSupported;
+    m_isFullGrabPending = false;
+    if (!m_isDamageSupported)
+        return;
+
+    // notifications only say that damage is not empty, the region is fetched anyway
+    XEvent event;
+    while (XCheckTypedEvent(_display, m_damageEventBase + XDamageNotify, &event)) {}
+
+    for (int i = 0; i < m_damages.size(); ++i) {
+        m_damagedRects[i].clear();
+        XDamageSubtract(_display, m_damages[i], None, m_damagedRegion);
+
+        int rectsCount = 0;
+        XRectangle *rects = XFixesFetchRegion(_display, m_damagedRegion, &rectsCount);
+        for (int r = 0; r < rectsCount; ++r)
+            m_damagedRects[i].append(QRect(rects[r].x, rects[r].y, rects[r].width, rects[r].height));
+        if (rects)
+            XFree(rects);
+    }
+}
+
+bool X11Grabber::isDamaged(int screenId, const QRect &rect) const
+{
+    if (m_isFullGrab || screenId >= m_damagedRects.size())
+        return true;
+    return intersectsAny(m_damagedRects[screenId], rect);
+}
+
+bool X11Grabber::isAreaDamaged(int screenIndex, const QRect &rect) const
+{
+    // pixels of the front buffers changed by the damage that was current
+    // when they were requested, not by the latest one
+    const ScreenInfo &region = _screensWithWidgets[screenIndex].screenInfo;
+    const int screenId = reinterpret_cast<intptr_t>(region.handle);
+    if (m_isReducedFull || screenId >= m_reducedDamage.size())
+        return true;
+    return intersectsAny(m_reducedDamage[screenId], rect.translated(region.rect.topLeft()));
+}
+
 QList<ScreenInfo> * X11Grabber::screensWithWidgets(QList<ScreenInfo> *result, const GrabbedAreas& grabWidgets)
 {
     result->clear();
 
+    QList<QRect> screenRects;
     for (int i = 0; i < ScreenCount(_display); ++i) {
         XWindowAttributes xwa;
         XGetWindowAttributes(_display, RootWindow(_display, i), &xwa);
-        ScreenInfo screen;
-        intptr_t handle = i;
-        screen.handle = reinterpret_cast<void *>(handle);
-        screen.rect = QRect(xwa.x, xwa.y, xwa.width, xwa.height);
-        for (int k = 0; k < grabWidgets.size(); ++k) {
-            if (screen.rect.intersects(grabWidgets[k]->rect())) {
-                result->append(screen);
-                break;
+        screenRects.append(QRect(xwa.x, xwa.y, xwa.width, xwa.height));
+    }
+
+    QList<QRect> areaRects;
+    for (int k = 0; k < grabWidgets.size(); ++k) {
+        if (grabWidgets[k]->isEnabled())
+            areaRects.append(grabWidgets[k]->geometry());
+    }
+
+    // Planning is quadratic in areas count, redo it only when the layout changes
+    if (screenRects != m_plannedScreens || areaRects != m_plannedAreas) {
+        m_plannedScreens = screenRects;
+        m_plannedAreas = areaRects;
+        m_plannedRegions.clear();
+
+        for (int i = 0; i < screenRects.size(); ++i) {
+            QList<QRect> clippedAreas;
+            for (int k = 0; k < areaRects.size(); ++k)
+                clippedAreas.append(screenRects[i].intersected(areaRects[k]));
+
+            const QList<QRect> regions = captureRegions(clippedAreas, maxCaptureRegionsPerScreen);
+            for (int r = 0; r < regions.size(); ++r) {
+                ScreenInfo region;
+                intptr_t handle = i;
+                region.handle = reinterpret_cast<void *>(handle);
+                region.rect = regions[r];
+                m_plannedRegions.append(region);
             }
         }
     }
 
+    *result = m_plannedRegions;
     return result;
 }
 
+bool X11Grabber::allocateBuffer(X11ShmBuffer *buffer, size_t size)
+{
+    buffer->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT|0777);
+    if (buffer->shmid == -1) {
+        qCritical() << Q_FUNC_INFO << " error occured while trying to get shared memory: " << strerror(errno);
+        return false;
+    }
+
+    void *mem = shmat(buffer->shmid, 0, 0);
+    if (mem == reinterpret_cast<void *>(-1)) {
+        qCritical() << Q_FUNC_INFO << " error occured while trying to attach shared memory: " << strerror(errno);
+        shmctl(buffer->shmid, IPC_RMID, 0);
+        buffer->shmid = -1;
+        return false;
+    }
+    buffer->shmaddr = static_cast<unsigned char *>(mem);
+
+    buffer->segment = xcb_generate_id(m_connection);
+    xcb_shm_attach(m_connection, buffer->segment, buffer->shmid, 0);
+    return true;
+}
+
+void X11Grabber::freeBuffer(X11ShmBuffer *buffer)
+{
+    if (buffer->shmid == -1)
+        return;
+
+    xcb_shm_detach(m_connection, buffer->segment);
+    shmdt(buffer->shmaddr);
+    shmctl(buffer->shmid, IPC_RMID, 0);
+    *buffer = X11ShmBuffer();
+}
+
 void X11Grabber::freeScreens()
 {
     for (int i = 0; i < _screensWithWidgets.size(); ++i) {
         X11GrabberData *d = reinterpret_cast<X11GrabberData *>(_screensWithWidgets[i].associatedData);
-        XShmDetach(_display, &d->shminfo);
-        XDestroyImage(d->image);
-        shmdt (d->shminfo.shmaddr);
-        shmctl(d->shminfo.shmid, IPC_RMID, 0);
+        // the server handles the request before the detach, the reply is not needed
+        if (d->isPending)
+            xcb_discard_reply(m_connection, d->cookie.sequence);
+        freeBuffer(&d->buffers[0]);
+        freeBuffer(&d->buffers[1]);
         delete d;
         d = NULL;
     }
@@ -102,6 +281,14 @@ void X11Grabber::freeScreens()
 bool X11Grabber::reallocate(const QList<ScreenInfo> &screens)
 {
     freeScreens();
+    // fresh images hold nothing yet
+    m_isFullGrabPending = true;
+
+    const xcb_query_extension_reply_t *shmExtension = xcb_get_extension_data(m_connection, &xcb_shm_id);
+    if (!shmExtension || !shmExtension->present) {
+        qCritical() << Q_FUNC_INFO << " MIT-SHM extension is not available";
+        return false;
+    }
 
     for (int i = 0; i < screens.size(); ++i) {
 
@@ -112,54 +299,112 @@ bool X11Grabber::reallocate(const QList<ScreenInfo> &screens)
 
         X11GrabberData *d = new X11GrabberData();
 
-        int screenid = reinterpret_cast<intptr_t>(screens[i].handle);
-
-        Screen * xscreen = ScreenOfDisplay(_display, screenid);
-
-        d->image = XShmCreateImage(_display, DefaultVisualOfScreen(xscreen),
-                                   DefaultDepthOfScreen(xscreen),
-                                   ZPixmap, NULL, &d->shminfo,
-                                   width, height );
-        uint imagesize;
-        imagesize = d->image->bytes_per_line * d->image->height;
-        d->shminfo.shmid = shmget(    IPC_PRIVATE,
-                                      imagesize,
-                                      IPC_CREAT|0777
-                                      );
-        if (d->shminfo.shmid == -1) {
-            qCritical() << Q_FUNC_INFO << " error occured while trying to get shared memory: " << strerror(errno);
-        }
-
-        char* mem = (char*)shmat(d->shminfo.shmid, 0, 0);
-        d->shminfo.shmaddr = mem;
-        d->image->data = mem;
-        d->shminfo.readOnly = False;
-
-        XShmAttach(_display, &d->shminfo);
-
         GrabbedScreen grabScreen;
-        grabScreen.imgData = (unsigned char *)mem;
         grabScreen.imgFormat = BufferFormatArgb;
         grabScreen.screenInfo = screens[i];
         grabScreen.associatedData = d;
         _screensWithWidgets.append(grabScreen);
+
+        // ZPixmap of 24 and 32 bit visuals has 4 bytes per pixel and no padding
+        const size_t imageSize = width * height * bytesPerPixel;
+        if (!allocateBuffer(&d->buffers[0], imageSize) || !allocateBuffer(&d->buffers[1], imageSize)) {
+            freeScreens();
+            return false;
+        }
+        _screensWithWidgets.last().imgData = d->frontData();
+        _screensWithWidgets.last().imgDataSize = imageSize;
     }
 
+    return true;
+}
+
+void X11Grabber::requestRegion(int index)
+{
+    X11GrabberData *d = reinterpret_cast<X11GrabberData *>(_screensWithWidgets[index].associatedData);
+    if (d->isPending)
+        return;
+
+    // Root windows are always placed at (0, 0), so region coordinates are
+    // root window coordinates as well
+    const ScreenInfo &region = _screensWithWidgets[index].screenInfo;
+    d->cookie = xcb_shm_get_image(m_connection,
+                                  RootWindow(_display, reinterpret_cast<intptr_t>(region.handle)),
+                                  region.rect.x(), region.rect.y(),
+                                  region.rect.width(), region.rect.height(),
+                                  0x00FFFFFF,
+                                  XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                  d->back().segment,
+                                  0);
+    d->isPending = true;
+}
+
+bool X11Grabber::collectRegion(int index)
+{
+    X11GrabberData *d = reinterpret_cast<X11GrabberData *>(_screensWithWidgets[index].associatedData);
+    if (!d->isPending)
+        return false;
+
+    xcb_generic_error_t *error = NULL;
+    xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(m_connection, d->cookie, &error);
+    d->isPending = false;
+    if (!reply) {
+        qWarning() << Q_FUNC_INFO << "xcb_shm_get_image failed, error code" << (error ? error->error_code : 0);
+        free(error);
+        return false;
+    }
+    free(reply);
 
+    d->front ^= 1;
+    _screensWithWidgets[index].imgData = d->frontData();
     return true;
 }
 
-GrabResult X11Grabber::grabScreens()
+bool X11Grabber::requestDamagedRegions()
 {
+    bool isAnyRequested = false;
     for (int i = 0; i < _screensWithWidgets.size(); ++i) {
-        XShmGetImage(_display,
-                     RootWindow(_display, reinterpret_cast<intptr_t>(_screensWithWidgets[i].screenInfo.handle)),
-                     reinterpret_cast<X11GrabberData *>(_screensWithWidgets[i].associatedData)->image,
-                     0,
-                     0,
-                     0x00FFFFFF
-                     );
+        const ScreenInfo &region = _screensWithWidgets[i].screenInfo;
+        if (isDamaged(reinterpret_cast<intptr_t>(region.handle), region.rect)) {
+            requestRegion(i);
+            isAnyRequested = true;
+        }
+    }
+
+    if (isAnyRequested) {
+        m_requestedDamage = m_damagedRects;
+        m_isRequestedFull = m_isFullGrab;
+        xcb_flush(m_connection);
+    }
+    return isAnyRequested;
+}
+
+bool X11Grabber::collectRegions()
+{
+    bool isAnyCollected = false;
+    for (int i = 0; i < _screensWithWidgets.size(); ++i)
+        isAnyCollected = collectRegion(i) || isAnyCollected;
+
+    if (isAnyCollected) {
+        // front buffers show the screen as it was when they were requested
+        m_reducedDamage = m_requestedDamage;
+        m_isReducedFull = m_isRequestedFull;
     }
+    return isAnyCollected;
+}
+
+GrabResult X11Grabber::grabScreens()
+{
+    fetchDamage();
+
+    // Frame requested by the previous tick is ready
+    if (collectRegions())
+        return GrabResultOk;
+
+    // Nothing was in flight, capture damaged regions right away so changes on
+    // an idle screen don't wait for the next tick
+    if (!requestDamagedRegions() || !collectRegions())
+        return GrabResultFrameNotReady;
+
 #if 0
     DEBUG_LOW_LEVEL << "QImage";
     QImage *pic = new QImage(1024,768,QImage::Format_RGB32);
@@ -190,4 +435,11 @@ GrabResult X11Grabber::grabScreens()
     return GrabResultOk;
 }
 
+void X11Grabber::prefetchScreens()
+{
+    // Content that is changing now is likely to change further, the server
+    // captures it into back buffers while the front ones are being reduced
+    requestDamagedRegions();
+}
+
 #endif // X11_GRAB_SUPPORT
@@ -25,6 +25,27 @@
 
 #include "calculations.hpp"
 
+#include <cmath>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#   define GRAB_X86_KERNELS
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   define GRAB_NEON_KERNELS
+#   include <arm_neon.h>
+#endif
+
+// Lets us build SSSE3/AVX2 kernels without raising the baseline ISA of the
+// whole library; MSVC exposes all intrinsics unconditionally.
+#if defined(__GNUC__)
+#   define GRAB_TARGET(isa) __attribute__((target(isa)))
+#else
+#   define GRAB_TARGET(isa)
+#endif
+
 namespace {
     static const int bytesPerPixel = 4;
 
@@ -131,42 +152,343 @@ namespace {
         resultColor->b = b;
         return count;
     }
+
+    // Scalar kernels walk the row 4 pixels at a time, do the same to cover
+    // exactly the same pixels.
+    inline int alignedWidth(const QRect &rect) {
+        return (rect.width() + 3) & ~3;
+    }
+
+    inline const unsigned char * rowStart(const unsigned char *buffer, unsigned int pitch, const QRect &rect, int currentY) {
+        return buffer + pitch * (rect.y() + currentY) + rect.x() * bytesPerPixel;
+    }
+
+#if defined(GRAB_X86_KERNELS)
+    GRAB_TARGET("sse2")
+    static int accumulateChannelsSse2(
+            const unsigned char *buffer,
+            unsigned int pitch,
+            const QRect &rect,
+            unsigned int sums[4]) {
+        const int width = alignedWidth(rect);
+        const int height = rect.height();
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        for(int currentY = 0; currentY < height; currentY++) {
+            const unsigned char *row = rowStart(buffer, pitch, rect, currentY);
+            for(int currentX = 0; currentX < width; currentX += 4) {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+                // widen to 16 bit and fold pixels 0,1 onto 2,3
+                const __m128i pairs = _mm_add_epi16(_mm_unpacklo_epi8(pixels, zero),
+                                                    _mm_unpackhi_epi8(pixels, zero));
+                acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(pairs, zero));
+                acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(pairs, zero));
+                row += bytesPerPixel * 4;
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), acc);
+        return height > 0 ? width * height : 0;
+    }
+
+    // Sums 4 pixels into per-channel 32 bit lanes: [c0, c1, c2, c3].
+    GRAB_TARGET("ssse3")
+    inline __m128i sumChannelsSsse3(__m128i pixels, __m128i deinterleave, __m128i ones8, __m128i ones16) {
+        const __m128i planar = _mm_shuffle_epi8(pixels, deinterleave);
+        return _mm_madd_epi16(_mm_maddubs_epi16(planar, ones8), ones16);
+    }
+
+    GRAB_TARGET("ssse3")
+    static int accumulateChannelsSsse3(
+            const unsigned char *buffer,
+            unsigned int pitch,
+            const QRect &rect,
+            unsigned int sums[4]) {
+        const int width = alignedWidth(rect);
+        const int height = rect.height();
+        const __m128i deinterleave = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        const __m128i ones8 = _mm_set1_epi8(1);
+        const __m128i ones16 = _mm_set1_epi16(1);
+        __m128i acc = _mm_setzero_si128();
+        for(int currentY = 0; currentY < height; currentY++) {
+            const unsigned char *row = rowStart(buffer, pitch, rect, currentY);
+            for(int currentX = 0; currentX < width; currentX += 4) {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+                acc = _mm_add_epi32(acc, sumChannelsSsse3(pixels, deinterleave, ones8, ones16));
+                row += bytesPerPixel * 4;
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), acc);
+        return height > 0 ? width * height : 0;
+    }
+
+    GRAB_TARGET("avx2")
+    static int accumulateChannelsAvx2(
+            const unsigned char *buffer,
+            unsigned int pitch,
+            const QRect &rect,
+            unsigned int sums[4]) {
+        const int width = alignedWidth(rect);
+        const int height = rect.height();
+        const __m256i deinterleave = _mm256_setr_epi8(
+                0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        const __m256i ones8 = _mm256_set1_epi8(1);
+        const __m256i ones16 = _mm256_set1_epi16(1);
+        __m256i acc = _mm256_setzero_si256();
+        __m128i accTail = _mm_setzero_si128();
+        for(int currentY = 0; currentY < height; currentY++) {
+            const unsigned char *row = rowStart(buffer, pitch, rect, currentY);
+            int currentX = 0;
+            for(; currentX + 8 <= width; currentX += 8) {
+                const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row));
+                const __m256i planar = _mm256_shuffle_epi8(pixels, deinterleave);
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(planar, ones8), ones16));
+                row += bytesPerPixel * 8;
+            }
+            if (currentX < width) {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+                accTail = _mm_add_epi32(accTail, sumChannelsSsse3(pixels,
+                                                                  _mm256_castsi256_si128(deinterleave),
+                                                                  _mm256_castsi256_si128(ones8),
+                                                                  _mm256_castsi256_si128(ones16)));
+            }
+        }
+        accTail = _mm_add_epi32(accTail, _mm256_castsi256_si128(acc));
+        accTail = _mm_add_epi32(accTail, _mm256_extracti128_si256(acc, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), accTail);
+        return height > 0 ? width * height : 0;
+    }
+
+    struct CpuFeatures {
+        bool sse2, ssse3, avx2;
+    };
+
+    static CpuFeatures detectCpuFeatures() {
+        CpuFeatures features = {false, false, false};
+#   if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        features.sse2 = (info[3] & (1 << 26)) != 0;
+        features.ssse3 = (info[2] & (1 << 9)) != 0;
+        const bool isOsXsave = (info[2] & (1 << 27)) != 0;
+        const bool isAvx = (info[2] & (1 << 28)) != 0;
+        // AVX state must be enabled by the OS too, not only by the CPU
+        if (maxLeaf >= 7 && isOsXsave && isAvx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            features.avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#   else
+        __builtin_cpu_init();
+        features.sse2 = __builtin_cpu_supports("sse2");
+        features.ssse3 = __builtin_cpu_supports("ssse3");
+        features.avx2 = __builtin_cpu_supports("avx2");
+#   endif
+        return features;
+    }
+
+    static const CpuFeatures cpuFeatures = detectCpuFeatures();
+#endif // GRAB_X86_KERNELS
+
+#if defined(GRAB_NEON_KERNELS)
+    static int accumulateChannelsNeon(
+            const unsigned char *buffer,
+            unsigned int pitch,
+            const QRect &rect,
+            unsigned int sums[4]) {
+        const int width = alignedWidth(rect);
+        const int height = rect.height();
+        uint32x4_t acc[4] = { vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0) };
+        unsigned int tail[4] = {0, 0, 0, 0};
+        for(int currentY = 0; currentY < height; currentY++) {
+            const unsigned char *row = rowStart(buffer, pitch, rect, currentY);
+            int currentX = 0;
+            for(; currentX + 16 <= width; currentX += 16) {
+                // vld4 splits 16 pixels into one register per channel
+                const uint8x16x4_t pixels = vld4q_u8(row);
+                for (int c = 0; c < 4; ++c)
+                    acc[c] = vpadalq_u16(acc[c], vpaddlq_u8(pixels.val[c]));
+                row += bytesPerPixel * 16;
+            }
+            for(; currentX < width; currentX++) {
+                for (int c = 0; c < 4; ++c)
+                    tail[c] += row[c];
+                row += bytesPerPixel;
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            sums[c] = tail[c]
+                    + vgetq_lane_u32(acc[c], 0) + vgetq_lane_u32(acc[c], 1)
+                    + vgetq_lane_u32(acc[c], 2) + vgetq_lane_u32(acc[c], 3);
+        }
+        return height > 0 ? width * height : 0;
+    }
+#endif // GRAB_NEON_KERNELS
+
+    static int accumulateChannels(
+            Grab::Calculations::AccumulationKernel kernel,
+            const unsigned char *buffer,
+            unsigned int pitch,
+            const QRect &rect,
+            unsigned int sums[4]) {
+        using namespace Grab::Calculations;
+        switch(kernel) {
+#if defined(GRAB_X86_KERNELS)
+        case KernelSse2:
+            return accumulateChannelsSse2(buffer, pitch, rect, sums);
+        case KernelSsse3:
+            return accumulateChannelsSsse3(buffer, pitch, rect, sums);
+        case KernelAvx2:
+            return accumulateChannelsAvx2(buffer, pitch, rect, sums);
+#endif
+#if defined(GRAB_NEON_KERNELS)
+        case KernelNeon:
+            return accumulateChannelsNeon(buffer, pitch, rect, sums);
+#endif
+        default:
+            Q_ASSERT_X(false, "accumulateChannels", "kernel is not supported on this platform");
+            return 0;
+        }
+    }
+
+    static Grab::Calculations::AccumulationKernel detectBestKernel() {
+        using namespace Grab::Calculations;
+        static const AccumulationKernel kernelsByPreference[] = {
+            KernelAvx2, KernelSsse3, KernelSse2, KernelNeon
+        };
+        for (size_t i = 0; i < sizeof(kernelsByPreference) / sizeof(kernelsByPreference[0]); ++i) {
+            if (isKernelSupported(kernelsByPreference[i]))
+                return kernelsByPreference[i];
+        }
+        return KernelScalar;
+    }
+
+    static const Grab::Calculations::AccumulationKernel bestKernel = detectBestKernel();
+
+    // Deterministic jitter, so a rebuilt pattern samples the same pixels again
+    // and colors don't flicker on resize of unrelated areas.
+    inline unsigned int nextJitter(unsigned int *state) {
+        *state = *state * 1103515245u + 12345u;
+        return (*state >> 16) & 0x7fff;
+    }
 } // namespace
 
 namespace Grab {
     namespace Calculations {
+        bool channelOffsets(BufferFormat bufferFormat, ChannelOffsets *offsets) {
+            switch(bufferFormat) {
+            case BufferFormatArgb:
+                offsets->r = 2; offsets->g = 1; offsets->b = 0;
+                return true;
+            case BufferFormatAbgr:
+                offsets->r = 0; offsets->g = 1; offsets->b = 2;
+                return true;
+            case BufferFormatRgba:
+                offsets->r = 3; offsets->g = 2; offsets->b = 1;
+                return true;
+            case BufferFormatBgra:
+                offsets->r = 1; offsets->g = 2; offsets->b = 3;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        bool isKernelSupported(AccumulationKernel kernel) {
+            switch(kernel) {
+            case KernelScalar:
+                return true;
+#if defined(GRAB_X86_KERNELS)
+            case KernelSse2:
+                return cpuFeatures.sse2;
+            case KernelSsse3:
+                return cpuFeatures.ssse3;
+            case KernelAvx2:
+                return cpuFeatures.avx2;
+#endif
+#if defined(GRAB_NEON_KERNELS)
+            case KernelNeon:
+                return true;
+#endif
+            default:
+                return false;
+            }
+        }
+
+        AccumulationKernel bestSupportedKernel() {
+            return bestKernel;
+        }
+
         QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect ) {
+            return calculateAvgColor(result, buffer, bufferFormat, pitch, rect, bestKernel);
+        }
+
+        QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect, AccumulationKernel kernel) {
+            ColorSums sums;
+            if (!accumulateColor(&sums, buffer, bufferFormat, pitch, rect, kernel))
+                return -1;
+            return averageColor(result, sums);
+        }
+
+        bool accumulateColor(ColorSums *sums, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect) {
+            return accumulateColor(sums, buffer, bufferFormat, pitch, rect, bestKernel);
+        }
+
+        bool accumulateColor(ColorSums *sums, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect, AccumulationKernel kernel) {
 
             Q_ASSERT_X(rect.width() % 4 == 0, "average color calculation", "rect width should be aligned by 4 bytes");
+            Q_ASSERT_X(isKernelSupported(kernel), "average color calculation", "unsupported kernel requested");
 
             int count = 0; // count the amount of pixels taken into account
             ColorValue color = {0, 0, 0};
 
-            switch(bufferFormat) {
-            case BufferFormatArgb:
-                count = accumulateBufferFormatArgb(buffer, pitch, rect, &color);
-                break;
+            if (kernel != KernelScalar && isKernelSupported(kernel)) {
+                ChannelOffsets offsets;
+                if (!channelOffsets(bufferFormat, &offsets))
+                    return false;
 
-            case BufferFormatAbgr:
-                count = accumulateBufferFormatAbgr(buffer, pitch, rect, &color);
-                break;
+                unsigned int channels[4] = {0, 0, 0, 0};
+                count = accumulateChannels(kernel, buffer, pitch, rect, channels);
+                color.r = channels[offsets.r];
+                color.g = channels[offsets.g];
+                color.b = channels[offsets.b];
+            } else {
+                switch(bufferFormat) {
+                case BufferFormatArgb:
+                    count = accumulateBufferFormatArgb(buffer, pitch, rect, &color);
+                    break;
 
-            case BufferFormatRgba:
-                count = accumulateBufferFormatRgba(buffer, pitch, rect, &color);
-                break;
+                case BufferFormatAbgr:
+                    count = accumulateBufferFormatAbgr(buffer, pitch, rect, &color);
+                    break;
 
-            case BufferFormatBgra:
-                count = accumulateBufferFormatBgra(buffer, pitch, rect, &color);
-                break;
-            default:
-                return -1;
-                break;
+                case BufferFormatRgba:
+                    count = accumulateBufferFormatRgba(buffer, pitch, rect, &color);
+                    break;
+
+                case BufferFormatBgra:
+                    count = accumulateBufferFormatBgra(buffer, pitch, rect, &color);
+                    break;
+                default:
+                    return false;
+                    break;
+                }
             }
 
-            if ( count > 1 ) {
-                color.r = ( color.r / count) & 0xff;
-                color.g = ( color.g / count) & 0xff;
-                color.b = ( color.b / count) & 0xff;
+            sums->r += color.r;
+            sums->g += color.g;
+            sums->b += color.b;
+            sums->count += count;
+            return true;
+        }
+
+        QRgb averageColor(QRgb *result, const ColorSums &sums) {
+            ColorValue color = {static_cast<int>(sums.r), static_cast<int>(sums.g), static_cast<int>(sums.b)};
+            if ( sums.count > 1 ) {
+                color.r = ( color.r / sums.count) & 0xff;
+                color.g = ( color.g / sums.count) & 0xff;
+                color.b = ( color.b / sums.count) & 0xff;
             }
 
             *result = qRgb(color.r, color.g, color.b);
@@ -187,5 +509,70 @@ namespace Grab {
             b = b / size;
             return qRgb(r, g, b);
         }
+
+        SamplePattern::SamplePattern()
+            : m_pitch(0)
+            , m_budget(0)
+        {}
+
+        bool SamplePattern::update(unsigned int pitch, const QRect &rect, int budget) {
+            if (pitch == m_pitch && rect == m_rect && budget == m_budget)
+                return false;
+
+            m_pitch = pitch;
+            m_rect = rect;
+            m_budget = budget;
+            m_offsets.clear();
+
+            const int width = rect.width();
+            const int height = rect.height();
+            if (width <= 0 || height <= 0 || budget <= 0)
+                return true;
+
+            if (width * height <= budget) {
+                m_offsets.reserve(width * height);
+                for (int y = 0; y < height; ++y)
+                    for (int x = 0; x < width; ++x)
+                        m_offsets.append(pitch * (rect.y() + y) + (rect.x() + x) * bytesPerPixel);
+                return true;
+            }
+
+            // Grid keeps the aspect ratio of the area, so cells are close to square
+            int columns = static_cast<int>(std::sqrt(static_cast<double>(budget) * width / height) + 0.5);
+            columns = qBound(1, columns, qMin(width, budget));
+            const int rows = qBound(1, budget / columns, height);
+
+            m_offsets.reserve(columns * rows);
+            unsigned int jitterState = 0x9e3779b9u;
+            for (int row = 0; row < rows; ++row) {
+                const int y0 = row * height / rows;
+                const int y1 = (row + 1) * height / rows;
+                for (int column = 0; column < columns; ++column) {
+                    const int x0 = column * width / columns;
+                    const int x1 = (column + 1) * width / columns;
+                    const int x = x0 + nextJitter(&jitterState) % (x1 - x0);
+                    const int y = y0 + nextJitter(&jitterState) % (y1 - y0);
+                    m_offsets.append(pitch * (rect.y() + y) + (rect.x() + x) * bytesPerPixel);
+                }
+            }
+            return true;
+        }
+
+        QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, const SamplePattern &pattern) {
+            ChannelOffsets channels;
+            if (!channelOffsets(bufferFormat, &channels))
+                return -1;
+
+            const QVector<unsigned int> &offsets = pattern.offsets();
+            ColorSums sums;
+            sums.count = offsets.size();
+            for (int i = 0; i < sums.count; ++i) {
+                const unsigned char *pixel = buffer + offsets[i];
+                sums.r += pixel[channels.r];
+                sums.g += pixel[channels.g];
+                sums.b += pixel[channels.b];
+            }
+            return averageColor(result, sums);
+        }
     }
 }
@@ -68,6 +68,11 @@ win32 {
     }
 }
 
+contains(DEFINES, REPLAY_GRAB_SUPPORT) {
+    GRABBERS_HEADERS += include/ReplayGrabber.hpp
+    GRABBERS_SOURCES += ReplayGrabber.cpp
+}
+
 # Common Qt grabbers
 contains(DEFINES, QT_GRAB_SUPPORT) {
     GRABBERS_HEADERS += \
@@ -85,12 +90,22 @@ HEADERS += \
     include/GrabberBase.hpp \
     include/ColorProvider.hpp \
     include/GrabberContext.hpp \
+    include/SummedAreaTable.hpp \
+    include/ReductionPool.hpp \
+    include/CaptureRegions.hpp \
+    include/ColorsTripleBuffer.hpp \
+    include/FramePacer.hpp \
     $${GRABBERS_HEADERS}
 
 SOURCES += \
     calculations.cpp \
     GrabberBase.cpp \
     GrabberContext.cpp \
+    SummedAreaTable.cpp \
+    ReductionPool.cpp \
+    CaptureRegions.cpp \
+    ColorsTripleBuffer.cpp \
+    FramePacer.cpp \
     include/ColorProvider.cpp \
     $${GRABBERS_SOURCES}
 
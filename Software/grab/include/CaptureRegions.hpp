@@ -0,0 +1,42 @@
+/*
+ * CaptureRegions.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QList>
+#include <QRect>
+
+namespace Grab {
+
+/*!
+  Plans which parts of a screen have to be captured to cover \a areas.
+  Neighbouring areas are merged while the merged rectangle does not waste
+  much more than the areas cover, so edge strips stay strips instead of
+  growing into the whole screen. Every area is fully contained in one of
+  the returned regions. Regions may overlap.
+  \param maxRegions upper bound on the result size, the cheapest merges
+  are forced beyond it to limit the amount of capture requests.
+*/
+QList<QRect> captureRegions(const QList<QRect> &areas, int maxRegions);
+
+}
@@ -0,0 +1,75 @@
+/*
+ * ColorsTripleBuffer.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QAtomicInt>
+#include <QRgb>
+#include <QVector>
+
+namespace Grab {
+
+/*!
+  Hands grabbed colors from the grab thread to the GUI thread without locks.
+  The writer fills its own slot and swaps it with the shared middle slot on
+  \a publish(), the reader swaps the middle slot with its own one on
+  \a fetch(). Neither side ever waits for the other one and the reader always
+  gets the latest complete frame, older unread frames are dropped.
+  One writer and one reader thread at a time.
+*/
+class ColorsTripleBuffer {
+public:
+    explicit ColorsTripleBuffer(int capacity);
+
+    int capacity() const { return m_capacity; }
+
+    // Writer side
+    QRgb * writeBuffer() { return slot(m_writeSlot); }
+    void publish(int colorsCount);
+
+    // Reader side
+    /*!
+      \return true if a frame was published since the previous call,
+      \a readBuffer() holds it then
+    */
+    bool fetch();
+    const QRgb * readBuffer() const { return slot(m_readSlot); }
+    int readCount() const { return m_counts[m_readSlot]; }
+
+private:
+    QRgb * slot(int index) { return m_colors.data() + index * m_capacity; }
+    const QRgb * slot(int index) const { return m_colors.data() + index * m_capacity; }
+
+    // middle slot index with freshFlag set when it holds an unread frame
+    static const int freshFlag = 4;
+    static const int slotMask = 3;
+
+    const int m_capacity;
+    QVector<QRgb> m_colors;
+    int m_counts[3];
+    QAtomicInt m_middle;
+    int m_writeSlot;
+    int m_readSlot;
+};
+
+}
@@ -29,7 +29,6 @@
 #ifdef D3D10_GRAB_SUPPORT
 
 #include<QList>
-#include<QScopedPointer>
 
 typedef void* (*GetHwndCallback_t)();
 
@@ -59,7 +58,7 @@ protected slots:
     virtual QList< ScreenInfo > * screensWithWidgets(QList< ScreenInfo > * result, const GrabbedAreas& grabWidgets);
 
 private:
-    QScopedPointer<D3D10GrabberImpl> m_impl;
+    D3D10GrabberImpl *m_impl;
 };
 
 #endif
@@ -0,0 +1,72 @@
+/*
+ * FramePacer.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+namespace Grab {
+
+/*!
+  Picks the grab period from the cost of recent frames and from how much
+  the colors change. Moving content is grabbed at the fastest allowed rate
+  right away, static content slows the grabbing down towards the idle
+  bound after a few frames. The period never drops below the frame cost,
+  so the grab thread is left some room between frames.
+*/
+class FramePacer {
+public:
+    FramePacer();
+
+    /*!
+      \a minIntervalMs is used for moving content, \a maxIntervalMs for
+      static one. Pacing is off when \a maxIntervalMs isn't above
+      \a minIntervalMs.
+    */
+    void setBounds(int minIntervalMs, int maxIntervalMs);
+    int minInterval() const { return m_minInterval; }
+    int maxInterval() const { return m_maxInterval; }
+
+    /*!
+      \param costMs time taken to grab and reduce the frame
+      \param change largest channel difference of the frame colors against
+      the previous frame, 0 when the grabber skipped an unchanged frame
+      \return period until the next grab, in ms
+    */
+    int update(double costMs, int change);
+    int interval() const { return m_interval; }
+
+    // colors differing by less are treated as noise of the content
+    static const int MotionThreshold = 3;
+    // static frames to see before slowing down, keeps short pauses smooth
+    static const int StaticFramesToSlowDown = 8;
+
+private:
+    int fastestInterval() const;
+
+    int m_minInterval;
+    int m_maxInterval;
+    double m_avgCost;
+    int m_staticFrames;
+    int m_interval;
+};
+
+}
@@ -28,7 +28,12 @@
 #include <QSharedPointer>
 #include <QColor>
 #include <QTimer>
+#include <QVector>
 #include "calculations.hpp"
+#include "SummedAreaTable.hpp"
+#include "ReductionPool.hpp"
+#include "FramePacer.hpp"
+#include "prismatic/enums.hpp"
 
 class GrabberContext;
 class GrabbedArea;
@@ -53,11 +58,14 @@ struct ScreenInfo {
 struct GrabbedScreen {
     GrabbedScreen()
         : imgFormat(BufferFormatUnknown)
+        , imgPitch(0)
         , associatedData(NULL)
     {}
     unsigned char * imgData;
     size_t imgDataSize;
     BufferFormat imgFormat;
+    // bytes per row of imgData, 0 when rows have no padding
+    unsigned int imgPitch;
     ScreenInfo screenInfo;
     void * associatedData;
 };
@@ -93,6 +101,15 @@ public slots:
     virtual void stopGrabbing();
     virtual bool isGrabbingStarted() const;
     virtual void setGrabInterval(int msec);
+    /*!
+      Period static content is grabbed with, the grab interval is used for
+      moving content. Adaptive pacing is off when it's not above the grab
+      interval.
+    */
+    virtual void setIdleGrabInterval(int msec);
+    virtual void setReductionMode(Grab::ReductionMode mode);
+    virtual void setSampleBudget(int samplesPerArea);
+    virtual void setReductionThreads(int threadsCount);
 
     virtual void grab();
 
@@ -121,12 +138,74 @@ protected slots:
 
     virtual bool isReallocationNeeded(const QList< ScreenInfo > &grabScreens) const;
 
+    /*!
+      Lets grabbers which track screen updates keep the color of an area from
+      the previous frame. \a rect is in coordinates of the grabbed screen.
+      \return false if pixels of \a rect didn't change since the last grab
+    */
+    virtual bool isAreaDamaged(int screenIndex, const QRect &rect) const;
+
+    /*!
+      Called after \a grabScreens() succeeded, before the frame is reduced.
+      Grabbers capturing asynchronously start the next frame here, so it is
+      captured while the current one is processed, and hand it out from the
+      next \a grabScreens() call. Buffers of the current frame must stay
+      untouched until then.
+    */
+    virtual void prefetchScreens();
+
 protected:
+    /*!
+      Grab area clipped to its screen and converted to the screen coordinates.
+      \a screenIndex is -1 when there is nothing to reduce and
+      \a fallbackColor has to be reported instead.
+    */
+    struct PreparedArea {
+        int screenIndex;
+        QRect rect;
+        QRgb fallbackColor;
+    };
+
     const GrabbedScreen * screenOfRect(const QRect &rect) const;
+    int screenIndexOfRect(const QRect &rect) const;
+
+    /*!
+      Part of the per-frame reduction. Large areas are split into row bands
+      in \a Grab::ReductionModePerArea, so a single huge area is shared
+      between threads too; \a sums collects channel sums of the band.
+    */
+    struct ReductionJob {
+        int areaIndex;
+        QRect rect;
+        Grab::Calculations::ColorSums sums;
+    };
+
+    class ReductionTask : public Grab::ParallelTask {
+    public:
+        explicit ReductionTask(GrabberBase *grabber) : m_grabber(grabber) {}
+        virtual void run(int jobIndex) { m_grabber->runReductionJob(jobIndex); }
+    private:
+        GrabberBase *m_grabber;
+    };
+
+    void prepareAreas();
+    void planIntegralImages();
+    void buildIntegralImages();
+    void updateSamplePatterns();
+    int prepareReductionJobs();
+    void runReductionJob(int jobIndex);
+    QRgb reduceArea(int areaIndex) const;
+    void reduceAreas();
+    void updateGrabInterval(double frameCostMs, int colorsChange);
 
 signals:
     void frameGrabAttempted(GrabResult grabResult);
 
+    /*!
+      Reports the period chosen by the frame pacing
+    */
+    void grabIntervalChanged(int msec);
+
     /*!
       Signals \a GrabManager that the grabber wants to be started or stopped
     */
@@ -138,4 +217,26 @@ protected:
     int grabScreensCount;
     QList<GrabbedScreen> _screensWithWidgets;
     QScopedPointer<QTimer> m_timer;
+    Grab::ReductionMode m_reductionMode;
+    QVector<PreparedArea> m_preparedAreas;
+    // one table per cluster of neighbouring areas
+    QVector<Grab::SummedAreaTable> m_integralImages;
+    QVector<int> m_integralImageScreens;
+    QVector<QRect> m_integralImageRects;
+    // table every prepared area is reduced with, -1 if there is none
+    QVector<int> m_integralImageOfArea;
+    // areas the tables were planned for
+    QVector<PreparedArea> m_integralImageAreas;
+    int m_sampleBudget;
+    QVector<Grab::Calculations::SamplePattern> m_samplePatterns;
+    Grab::ReductionPool m_reductionPool;
+    QVector<ReductionJob> m_reductionJobs;
+    QVector<QRgb> m_areaColors;
+    // areas m_areaColors were calculated for
+    QVector<PreparedArea> m_reducedAreas;
+    Grab::FramePacer m_framePacer;
+    int m_idleGrabInterval;
+    // largest channel difference of the published colors to the previous ones
+    int m_colorsChange;
+    QVector<QRgb> m_publishedColors;
 };
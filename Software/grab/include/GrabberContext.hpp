@@ -27,12 +27,15 @@
 #ifndef GRABBERCONTEXT_HPP
 #define GRABBERCONTEXT_HPP
 
+#include <QAtomicInt>
 #include <QList>
+#include <QMutex>
 #include <QRgb>
+#include <QVector>
 
 #include "GrabberBase.hpp"
-
-class GrabbedArea;
+#include "GrabbedArea.hpp"
+#include "ColorsTripleBuffer.hpp"
 
 struct AllocatedBuf {
     AllocatedBuf()
@@ -46,11 +49,43 @@ struct AllocatedBuf {
     bool isAvail;
 };
 
+/*!
+  Copy of a \a GrabbedArea state, safe to read from the grab thread while
+  the area itself lives in the GUI thread.
+*/
+class GrabbedAreaCopy : public GrabbedArea {
+public:
+    GrabbedAreaCopy()
+        : m_isEnabled(false)
+        , m_id(0)
+    {}
+    explicit GrabbedAreaCopy(const GrabbedArea &area)
+        : m_rect(area.geometry())
+        , m_isEnabled(area.isEnabled())
+        , m_id(area.id())
+    {}
+
+    virtual bool isEnabled() const { return m_isEnabled; }
+    virtual QRect geometry() const { return m_rect; }
+    virtual uintptr_t id() const { return m_id; }
+
+    bool operator== (const GrabbedAreaCopy &other) const {
+        return m_rect == other.m_rect && m_isEnabled == other.m_isEnabled && m_id == other.m_id;
+    }
+    bool operator!= (const GrabbedAreaCopy &other) const { return !(*this == other); }
+
+private:
+    QRect m_rect;
+    bool m_isEnabled;
+    uintptr_t m_id;
+};
+
 class GrabberContext {
 public:
-    GrabberContext()
-        : grabWidgets(0)
-        , grabResult(0) {
+    explicit GrabberContext(int maxColorsCount = 0)
+        : grabWidgets(&m_areas)
+        , grabbedColors(maxColorsCount)
+        , m_isAreasUpdated(0) {
     }
 
     ~GrabberContext() {
@@ -63,12 +98,42 @@ public:
     void freeReleasedBufs();
     int buffersCount() const { return _allocatedBufs.size(); }
 
+    /*!
+      Called from the thread owning \a areas whenever they may have changed,
+      copies are handed over to grabbers only if something differs.
+    */
+    void updateGrabbedAreas(const GrabberBase::GrabbedAreas &areas);
+
+    /*!
+      Called by grabbers before every grab, refreshes \a grabWidgets.
+    */
+    void syncGrabbedAreas();
+
+    /*!
+      Screen geometry for grabbers that can't query it themselves off the GUI
+      thread, set from the GUI thread and read from the grab thread.
+    */
+    void setPrimaryScreen(const ScreenInfo &screen);
+    ScreenInfo primaryScreen();
+
 public:
     const GrabberBase::GrabbedAreas *grabWidgets;
-    QList<QRgb> *grabResult;
+    // Colors of reduced areas in \a grabWidgets order
+    Grab::ColorsTripleBuffer grabbedColors;
 
 private:
     QList<AllocatedBuf> _allocatedBufs;
+
+    // owner side
+    QVector<GrabbedAreaCopy> m_lastAreas;
+    // shared, guarded by m_areasMutex, so is m_primaryScreen
+    QMutex m_areasMutex;
+    QVector<GrabbedAreaCopy> m_updatedAreas;
+    QAtomicInt m_isAreasUpdated;
+    ScreenInfo m_primaryScreen;
+    // grabber side
+    QVector<GrabbedAreaCopy> m_areaCopies;
+    GrabberBase::GrabbedAreas m_areas;
 };
 
 
@@ -0,0 +1,65 @@
+/*
+ * ReductionPool.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QThreadPool>
+
+namespace Grab {
+
+/*!
+  Unit of work for \a ReductionPool. \a run() is called once for every job
+  index, possibly from several threads at once.
+*/
+class ParallelTask {
+public:
+    virtual ~ParallelTask() {}
+    virtual void run(int jobIndex) = 0;
+};
+
+/*!
+  Persistent set of worker threads splitting independent jobs between cores.
+  Workers pull the next job index from a shared counter, so a slow job does
+  not hold back the rest. The calling thread takes jobs too and returns when
+  all of them are done.
+*/
+class ReductionPool {
+public:
+    ReductionPool();
+    ~ReductionPool();
+
+    /*!
+      \a threadsCount includes the calling thread, 0 means one thread per core
+      and 1 disables parallel execution.
+    */
+    void setThreadsCount(int threadsCount);
+    int threadsCount() const { return m_threadsCount; }
+
+    void run(int jobsCount, ParallelTask *task);
+
+private:
+    QThreadPool m_workers;
+    int m_threadsCount;
+};
+
+}
@@ -0,0 +1,117 @@
+/*
+ * ReplayGrabber.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "GrabberBase.hpp"
+
+#ifdef REPLAY_GRAB_SUPPORT
+
+#include <QElapsedTimer>
+#include <QFile>
+
+namespace Grab {
+
+/*!
+  Header of a replay file. \a framesCount frames of \a pitch * \a height
+  bytes follow it back to back. Fields are stored in the native byte order.
+*/
+struct ReplayFileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 width;
+    quint32 height;
+    quint32 pitch;
+    qint32 format; // BufferFormat
+    quint32 framesCount;
+
+    static const char Magic[8];
+    static const quint32 Version = 1;
+
+    /*!
+      Fills the header of a file with given frames, use it to record one.
+    */
+    void init(int width, int height, int pitch, BufferFormat format, int framesCount);
+    bool isValid(qint64 fileSize) const;
+    qint64 frameSize() const { return static_cast<qint64>(pitch) * height; }
+};
+
+}
+
+/*!
+  Serves frames of a memory mapped replay file instead of capturing the
+  screen, so grabbing and processing can be benchmarked on the same input
+  and without a display. Frames are handed out right from the mapping and
+  are placed at the desktop origin.
+*/
+class ReplayGrabber : public GrabberBase
+{
+    Q_OBJECT
+public:
+    ReplayGrabber(QObject *parent, GrabberContext *context);
+    virtual ~ReplayGrabber();
+
+    DECLARE_GRABBER_NAME("ReplayGrabber")
+
+    int framesCount() const;
+    // index of the frame served last, -1 before the first grab
+    int currentFrame() const { return m_currentFrame; }
+
+public slots:
+    /*!
+      Maps \a fileName, an empty name closes the current file.
+      \return false if the file can't be mapped or isn't a valid replay
+    */
+    bool setReplayFile(const QString &fileName);
+
+    /*!
+      0 serves the next frame on every grab and grabs back to back,
+      otherwise frames follow the wall clock at \a fps and the grab interval
+      applies as usual.
+    */
+    void setReplayFrameRate(int fps);
+
+    virtual void startGrabbing();
+    virtual void setGrabInterval(int msec);
+    virtual void setIdleGrabInterval(int msec);
+
+protected slots:
+    virtual GrabResult grabScreens();
+    virtual bool reallocate(const QList< ScreenInfo > &grabScreens);
+    virtual QList< ScreenInfo > * screensWithWidgets(QList< ScreenInfo > * result, const GrabbedAreas& grabWidgets);
+
+private:
+    void closeReplayFile();
+    const uchar * frameData(int frame) const;
+
+    QFile m_file;
+    uchar *m_mappedData;
+    Grab::ReplayFileHeader m_header;
+    int m_frameRate;
+    int m_requestedGrabInterval;
+    int m_requestedIdleGrabInterval;
+    QElapsedTimer m_replayClock;
+    int m_currentFrame;
+};
+
+#endif // REPLAY_GRAB_SUPPORT
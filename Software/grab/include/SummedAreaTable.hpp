@@ -0,0 +1,72 @@
+/*
+ * SummedAreaTable.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QRect>
+#include <QRgb>
+#include <QVector>
+#include "common/BufferFormat.h"
+
+namespace Grab {
+
+/*!
+  Integral image of a grabbed buffer. Built once per frame over a cluster of
+  grab areas, it turns every average color into a four-corner lookup
+  instead of a pass over the area pixels.
+*/
+class SummedAreaTable {
+public:
+    SummedAreaTable();
+
+    /*!
+      Builds the table over \a rect of \a buffer, \a rect is in buffer
+      coordinates.
+      \return false if \a bufferFormat is not supported
+    */
+    bool build(const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect);
+    void clear();
+
+    bool isValid() const { return !m_sums.isEmpty(); }
+    const QRect & rect() const { return m_rect; }
+
+    /*!
+      Gives the same result as \a Grab::Calculations::calculateAvgColor over
+      the same buffer. \a rect must lie inside \a rect() of the table.
+    */
+    QRgb calculateAvgColor(QRgb *result, const QRect &rect) const;
+
+private:
+    struct Sum {
+        unsigned int r, g, b;
+    };
+
+    const Sum & at(int x, int y) const { return m_sums[y * m_stride + x]; }
+
+    // (width + 1) x (height + 1) entries, first row and column are zeros
+    QVector<Sum> m_sums;
+    QRect m_rect;
+    int m_stride;
+};
+
+}
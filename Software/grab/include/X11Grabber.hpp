@@ -32,7 +32,9 @@
 #include <QScopedPointer>
 
 struct X11GrabberData;
+struct X11ShmBuffer;
 struct _XDisplay;
+struct xcb_connection_t;
 
 using namespace Grab;
 
@@ -48,11 +50,46 @@ protected:
     virtual GrabResult grabScreens();
     virtual bool reallocate(const QList<ScreenInfo> &screens);
     virtual QList<ScreenInfo> * screensWithWidgets(QList<ScreenInfo> *result, const GrabbedAreas& grabWidgets);
+    virtual bool isAreaDamaged(int screenIndex, const QRect &rect) const;
+    virtual void prefetchScreens();
 
 private:
+    bool allocateBuffer(X11ShmBuffer *buffer, size_t size);
+    void freeBuffer(X11ShmBuffer *buffer);
     void freeScreens();
+    void requestRegion(int index);
+    bool collectRegion(int index);
+    bool requestDamagedRegions();
+    bool collectRegions();
+    void initDamage();
+    void freeDamage();
+    void fetchDamage();
+    bool isDamaged(int screenId, const QRect &rect) const;
 
 private:
     _XDisplay *_display;
+    xcb_connection_t *m_connection;
+    // Capture regions are planned per screen from the enabled areas, every
+    // region is grabbed into its own shared memory image
+    QList<QRect> m_plannedScreens;
+    QList<QRect> m_plannedAreas;
+    QList<ScreenInfo> m_plannedRegions;
+
+    // XDamage tracking of root windows, XIDs are kept as unsigned long to
+    // keep X headers out of here
+    bool m_isDamageSupported;
+    int m_damageEventBase;
+    QVector<unsigned long> m_damages;
+    unsigned long m_damagedRegion;
+    // rects damaged since the previous grab, per X screen
+    QVector< QList<QRect> > m_damagedRects;
+    bool m_isFullGrabPending;
+    bool m_isFullGrab;
+    // damage current when the pending capture was requested and the one
+    // front buffers correspond to
+    QVector< QList<QRect> > m_requestedDamage;
+    bool m_isRequestedFull;
+    QVector< QList<QRect> > m_reducedDamage;
+    bool m_isReducedFull;
 };
 #endif // X11_GRAB_SUPPORT
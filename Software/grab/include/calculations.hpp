@@ -28,12 +28,93 @@
 #include <QRect>
 #include <QRgb>
 #include <QList>
+#include <QVector>
 #include "common/BufferFormat.h"
 
 namespace Grab {
     namespace Calculations {
 
+        /*!
+          Implementations of the pixel accumulation loop. The best one supported
+          by the CPU is detected once at startup and used by \a calculateAvgColor.
+          All kernels produce bit-identical results.
+        */
+        enum AccumulationKernel {
+            KernelScalar,
+            KernelSse2,
+            KernelSsse3,
+            KernelAvx2,
+            KernelNeon,
+
+            KernelsCount
+        };
+
+        /*!
+          Byte offsets of the color channels inside a 4-byte pixel of the given
+          format. SIMD kernels sum all four bytes of a pixel at once and pick
+          the channels afterwards, so one kernel serves every \a BufferFormat.
+        */
+        struct ChannelOffsets {
+            int r, g, b;
+        };
+
+        bool channelOffsets(BufferFormat bufferFormat, ChannelOffsets *offsets);
+
+        bool isKernelSupported(AccumulationKernel kernel);
+        AccumulationKernel bestSupportedKernel();
+
         QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect );
+        QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect, AccumulationKernel kernel);
         QRgb calculateAvgColor(QList<QRgb> *colors);
+
+        /*!
+          Raw channel sums behind an average color. Sums of disjoint parts of an
+          area add up to the sums of the whole area, so the area can be split
+          into row bands and reduced in parallel with the same result.
+        */
+        struct ColorSums {
+            ColorSums() : r(0), g(0), b(0), count(0) {}
+
+            unsigned int r, g, b;
+            int count;
+        };
+
+        /*!
+          Adds channel sums of \a rect to \a sums.
+          \return false if \a bufferFormat is not supported
+        */
+        bool accumulateColor(ColorSums *sums, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect);
+        bool accumulateColor(ColorSums *sums, const unsigned char *buffer, BufferFormat bufferFormat, unsigned int pitch, const QRect &rect, AccumulationKernel kernel);
+        QRgb averageColor(QRgb *result, const ColorSums &sums);
+
+        /*!
+          Fixed set of pixels standing for a whole area: a jittered grid with at
+          most \a budget samples, one per cell. Areas smaller than the budget
+          are sampled completely. Averaging over the pattern costs the same for
+          any resolution.
+        */
+        class SamplePattern {
+        public:
+            SamplePattern();
+
+            /*!
+              Rebuilds sample offsets if \a pitch, \a rect or \a budget differ
+              from the ones the pattern was built for.
+              \return true if the pattern was rebuilt
+            */
+            bool update(unsigned int pitch, const QRect &rect, int budget);
+
+            const QRect & rect() const { return m_rect; }
+            // Byte offsets of sampled pixels from the buffer start
+            const QVector<unsigned int> & offsets() const { return m_offsets; }
+
+        private:
+            QVector<unsigned int> m_offsets;
+            QRect m_rect;
+            unsigned int m_pitch;
+            int m_budget;
+        };
+
+        QRgb calculateAvgColor(QRgb *result, const unsigned char *buffer, BufferFormat bufferFormat, const SamplePattern &pattern);
     }
 }
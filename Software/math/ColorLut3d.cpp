@@ -0,0 +1,274 @@
+/*
+ * ColorLut3d.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ColorLut3d.hpp"
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include "common/DebugOut.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLOR_LUT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    bool parseTriple(const QStringList &fields, int first, float *values)
+    {
+        if (fields.count() != first + 3)
+            return false;
+        bool ok = true;
+        for (int c = 0; c < 3 && ok; ++c)
+            values[c] = fields[first + c].toFloat(&ok);
+        return ok;
+    }
+}
+
+ColorLut3d::ColorLut3d()
+    : m_size(0)
+{
+    for (int c = 0; c < 3; ++c) {
+        m_domainMin[c] = 0;
+        m_domainScale[c] = 0;
+    }
+}
+
+bool ColorLut3d::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << Q_FUNC_INFO << "can't open" << fileName << file.errorString();
+        return false;
+    }
+
+    int size = 0;
+    float domainMin[3] = { 0, 0, 0 };
+    float domainMax[3] = { 1, 1, 1 };
+    QVector<float> red, green, blue;
+
+    QTextStream stream(&file);
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine();
+        ++lineNumber;
+        const int commentIndex = line.indexOf('#');
+        if (commentIndex >= 0)
+            line.truncate(commentIndex);
+        const QStringList fields = line.simplified().split(' ', QString::SkipEmptyParts);
+        if (fields.isEmpty())
+            continue;
+
+        const QString &keyword = fields.first();
+        bool ok = true;
+        float values[3];
+        if (keyword == "TITLE") {
+            continue;
+        } else if (keyword == "LUT_3D_SIZE") {
+            size = fields.count() == 2 ? fields[1].toInt(&ok) : 0;
+            ok = ok && size >= MinSize && size <= MaxSize && red.isEmpty();
+            if (ok) {
+                red.reserve(size * size * size);
+                green.reserve(size * size * size);
+                blue.reserve(size * size * size);
+            }
+        } else if (keyword == "DOMAIN_MIN") {
+            ok = parseTriple(fields, 1, domainMin);
+        } else if (keyword == "DOMAIN_MAX") {
+            ok = parseTriple(fields, 1, domainMax);
+        } else if (keyword == "LUT_3D_INPUT_RANGE") {
+            ok = fields.count() == 3;
+            const float min = ok ? fields[1].toFloat(&ok) : 0;
+            const float max = ok ? fields[2].toFloat(&ok) : 0;
+            for (int c = 0; c < 3; ++c) {
+                domainMin[c] = min;
+                domainMax[c] = max;
+            }
+        } else if (parseTriple(fields, 0, values)) {
+            ok = size > 0 && red.count() < size * size * size;
+            if (ok) {
+                red.append(values[0] * 4095);
+                green.append(values[1] * 4095);
+                blue.append(values[2] * 4095);
+            }
+        } else {
+            // 1D tables and unknown keywords
+            ok = false;
+        }
+
+        if (!ok) {
+            qWarning() << Q_FUNC_INFO << fileName << "unsupported or invalid line" << lineNumber;
+            return false;
+        }
+    }
+
+    if (size == 0 || red.count() != size * size * size) {
+        qWarning() << Q_FUNC_INFO << fileName << "has" << red.count() << "entries, expected" << size * size * size;
+        return false;
+    }
+    for (int c = 0; c < 3; ++c) {
+        if (domainMax[c] <= domainMin[c]) {
+            qWarning() << Q_FUNC_INFO << fileName << "has an empty domain";
+            return false;
+        }
+    }
+
+    m_size = size;
+    for (int c = 0; c < 3; ++c) {
+        m_domainMin[c] = domainMin[c];
+        m_domainScale[c] = (size - 1) / (domainMax[c] - domainMin[c]);
+    }
+    m_red = red;
+    m_green = green;
+    m_blue = blue;
+    return true;
+}
+
+void ColorLut3d::clear()
+{
+    m_size = 0;
+    m_red.clear();
+    m_green.clear();
+    m_blue.clear();
+}
+
+void ColorLut3d::apply(const RgbBuffer &colors, RgbBuffer &result) const
+{
+    result.resize(colors.count());
+    if (isNull())
+        return;
+
+    const int strides[3] = { 1, m_size, m_size * m_size };
+    const float maxCoord = m_size - 1;
+    const float *lutRed = m_red.constData();
+    const float *lutGreen = m_green.constData();
+    const float *lutBlue = m_blue.constData();
+    const quint16 *in[3] = { colors.red(), colors.green(), colors.blue() };
+    quint16 *out[3] = { result.red(), result.green(), result.blue() };
+    const int count = colors.count();
+    int i = 0;
+
+#ifdef COLOR_LUT_SSE2
+    // the same steps four LEDs at a time, the tetrahedron comes from compare masks instead of
+    // branches. Offsets are exact in floats, the largest table has 65^3 points
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 maxCoord4 = _mm_set1_ps(maxCoord);
+    const __m128 maxIndex4 = _mm_set1_ps(m_size - 2);
+    const __m128 stride4[3] = { one, _mm_set1_ps(strides[1]), _mm_set1_ps(strides[2]) };
+    const __m128 diagonal = _mm_set1_ps(strides[0] + strides[1] + strides[2]);
+    for (; i + 4 <= count; i += 4) {
+        __m128 f[3];
+        __m128 base = zero;
+        for (int c = 0; c < 3; ++c) {
+            const __m128i channel = _mm_unpacklo_epi16(
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in[c] + i)), _mm_setzero_si128());
+            __m128 coord = _mm_mul_ps(_mm_cvtepi32_ps(channel), _mm_set1_ps(1.0f / 4095));
+            coord = _mm_mul_ps(_mm_sub_ps(coord, _mm_set1_ps(m_domainMin[c])), _mm_set1_ps(m_domainScale[c]));
+            coord = _mm_min_ps(_mm_max_ps(coord, zero), maxCoord4);
+            const __m128 index = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(coord)), maxIndex4);
+            f[c] = _mm_sub_ps(coord, index);
+            base = _mm_add_ps(base, _mm_mul_ps(index, stride4[c]));
+        }
+
+        const __m128 rg = _mm_cmpge_ps(f[0], f[1]);
+        const __m128 gb = _mm_cmpge_ps(f[1], f[2]);
+        const __m128 rb = _mm_cmpge_ps(f[0], f[2]);
+        const __m128 largestIsRed = _mm_and_ps(rg, rb);
+        const __m128 largestIsGreen = _mm_andnot_ps(rg, gb);
+        const __m128 largestIsBlue = _mm_andnot_ps(_mm_or_ps(largestIsRed, largestIsGreen), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+        const __m128 smallestIsRed = _mm_andnot_ps(_mm_or_ps(rg, rb), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+        const __m128 smallestIsGreen = _mm_andnot_ps(gb, rg);
+        const __m128 smallestIsBlue = _mm_andnot_ps(_mm_or_ps(smallestIsRed, smallestIsGreen), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+        const __m128 largestStride = _mm_or_ps(_mm_or_ps(_mm_and_ps(largestIsRed, stride4[0]), _mm_and_ps(largestIsGreen, stride4[1])),
+                                               _mm_and_ps(largestIsBlue, stride4[2]));
+        const __m128 smallestStride = _mm_or_ps(_mm_or_ps(_mm_and_ps(smallestIsRed, stride4[0]), _mm_and_ps(smallestIsGreen, stride4[1])),
+                                                _mm_and_ps(smallestIsBlue, stride4[2]));
+
+        const __m128 largest = _mm_max_ps(f[0], _mm_max_ps(f[1], f[2]));
+        const __m128 smallest = _mm_min_ps(f[0], _mm_min_ps(f[1], f[2]));
+        const __m128 middle = _mm_max_ps(_mm_min_ps(f[0], f[1]), _mm_min_ps(_mm_max_ps(f[0], f[1]), f[2]));
+        const __m128 w0 = _mm_sub_ps(one, largest);
+        const __m128 w1 = _mm_sub_ps(largest, middle);
+        const __m128 w2 = _mm_sub_ps(middle, smallest);
+        const __m128 w3 = smallest;
+
+        int v[4][4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v[0]), _mm_cvttps_epi32(base));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v[1]), _mm_cvttps_epi32(_mm_add_ps(base, largestStride)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v[2]), _mm_cvttps_epi32(
+                             _mm_sub_ps(_mm_add_ps(base, diagonal), smallestStride)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v[3]), _mm_cvttps_epi32(_mm_add_ps(base, diagonal)));
+
+        const float *luts[3] = { lutRed, lutGreen, lutBlue };
+        for (int c = 0; c < 3; ++c) {
+            const float *lut = luts[c];
+            __m128 value = _mm_mul_ps(w0, _mm_setr_ps(lut[v[0][0]], lut[v[0][1]], lut[v[0][2]], lut[v[0][3]]));
+            value = _mm_add_ps(value, _mm_mul_ps(w1, _mm_setr_ps(lut[v[1][0]], lut[v[1][1]], lut[v[1][2]], lut[v[1][3]])));
+            value = _mm_add_ps(value, _mm_mul_ps(w2, _mm_setr_ps(lut[v[2][0]], lut[v[2][1]], lut[v[2][2]], lut[v[2][3]])));
+            value = _mm_add_ps(value, _mm_mul_ps(w3, _mm_setr_ps(lut[v[3][0]], lut[v[3][1]], lut[v[3][2]], lut[v[3][3]])));
+            value = _mm_add_ps(_mm_min_ps(_mm_max_ps(value, zero), _mm_set1_ps(4095.0f)), _mm_set1_ps(0.5f));
+
+            int rounded[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(rounded), _mm_cvttps_epi32(value));
+            for (int k = 0; k < 4; ++k)
+                out[c][i + k] = static_cast<quint16>(rounded[k]);
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        int base = 0;
+        float f[3];
+        for (int c = 0; c < 3; ++c) {
+            const float coord = qBound(0.0f, (in[c][i] * (1.0f / 4095) - m_domainMin[c]) * m_domainScale[c], maxCoord);
+            const int index = qMin(static_cast<int>(coord), m_size - 2);
+            f[c] = coord - index;
+            base += index * strides[c];
+        }
+
+        // the tetrahedron is picked by the order of the fractions: walk from the base corner
+        // along the largest fraction, then the middle one, then the smallest
+        const bool rg = f[0] >= f[1], gb = f[1] >= f[2], rb = f[0] >= f[2];
+        const int largest = rg && rb ? 0 : (!rg && gb ? 1 : 2);
+        const int smallest = !rg && !rb ? 0 : (rg && !gb ? 1 : 2);
+        const int middle = 3 - largest - smallest;
+
+        const int v0 = base;
+        const int v1 = v0 + strides[largest];
+        const int v2 = v1 + strides[middle];
+        const int v3 = v2 + strides[smallest];
+        const float w0 = 1 - f[largest];
+        const float w1 = f[largest] - f[middle];
+        const float w2 = f[middle] - f[smallest];
+        const float w3 = f[smallest];
+
+        const float r = w0 * lutRed[v0] + w1 * lutRed[v1] + w2 * lutRed[v2] + w3 * lutRed[v3];
+        const float g = w0 * lutGreen[v0] + w1 * lutGreen[v1] + w2 * lutGreen[v2] + w3 * lutGreen[v3];
+        const float b = w0 * lutBlue[v0] + w1 * lutBlue[v1] + w2 * lutBlue[v2] + w3 * lutBlue[v3];
+        out[0][i] = static_cast<quint16>(qBound(0.0f, r, 4095.0f) + 0.5f);
+        out[1][i] = static_cast<quint16>(qBound(0.0f, g, 4095.0f) + 0.5f);
+        out[2][i] = static_cast<quint16>(qBound(0.0f, b, 4095.0f) + 0.5f);
+    }
+}
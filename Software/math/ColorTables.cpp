@@ -0,0 +1,134 @@
+/*
+ * ColorTables.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ColorTables.hpp"
+
+namespace PrismatikMath
+{
+    namespace
+    {
+        template <int... I>
+        struct Indices {};
+
+        template <typename First, typename Second>
+        struct JoinedIndices;
+
+        template <int... First, int... Second>
+        struct JoinedIndices<Indices<First...>, Indices<Second...> > {
+            typedef Indices<First..., (sizeof...(First) + Second)...> Type;
+        };
+
+        // Indices<0, 1, ..., Size - 1>, halving keeps the template recursion shallow
+        template <int Size>
+        struct MakeIndices {
+            typedef typename JoinedIndices<typename MakeIndices<Size / 2>::Type,
+                                           typename MakeIndices<Size - Size / 2>::Type>::Type Type;
+        };
+
+        template <>
+        struct MakeIndices<0> {
+            typedef Indices<> Type;
+        };
+
+        template <>
+        struct MakeIndices<1> {
+            typedef Indices<0> Type;
+        };
+
+        template <typename Generator, int Size, int... I>
+        constexpr ColorTable<typename Generator::Value, Size> generate(Indices<I...>) {
+            return {{ Generator::at(I)... }};
+        }
+
+        template <typename Generator, int Size>
+        constexpr ColorTable<typename Generator::Value, Size> generate() {
+            return generate<Generator, Size>(typename MakeIndices<Size>::Type());
+        }
+
+        constexpr double linearized(double c) {
+            return c > 0.04045 ? Constexpr::pow((c + 0.055) / 1.055, 2.4) : c / 12.92;
+        }
+
+        constexpr double companded(double c) {
+            return c > 0.0031308 ? 1.055 * Constexpr::pow(c, 1 / 2.4) - 0.055 : 12.92 * c;
+        }
+
+        constexpr double labCompressed(double t) {
+            return t > 0.008856 ? Constexpr::pow(t, 1.0 / 3) : 7.787 * t + 16.0 / 116;
+        }
+
+        constexpr quint32 fixedPoint(double x, int shift = FixedPointShift) {
+            return static_cast<quint32>(x * (1 << shift) + 0.5);
+        }
+
+        struct Linearization {
+            typedef quint32 Value;
+            static constexpr quint32 at(int i) {
+                return fixedPoint(linearized(i / 4095.0));
+            }
+        };
+
+        struct Companding {
+            typedef quint32 Value;
+            static constexpr quint32 at(int i) {
+                return fixedPoint(companded(static_cast<double>(i) / CompandingTableSize) * 4095, CompandedShift);
+            }
+        };
+
+        struct LabCompression {
+            typedef quint32 Value;
+            static constexpr quint32 at(int i) {
+                return fixedPoint(labCompressed(static_cast<double>(i) / LabCompressionTableSize));
+            }
+        };
+
+        struct Luminance {
+            typedef quint16 Value;
+            // Rec. 709 weights of toXyz() with \a i running over red, green and blue tables
+            static constexpr quint16 at(int i) {
+                return static_cast<quint16>((i < TransferLutSize ? 0.2126 : i < 2 * TransferLutSize ? 0.7152 : 0.0722)
+                                            * linearized((i % TransferLutSize) / 4095.0) * LuminanceScale + 0.5);
+            }
+        };
+
+        // DefaultGamma is 2 and pow(x, 2) is exactly x * x, so this matches
+        // fillGammaLut() to the last bit
+        struct DefaultGammaCurve {
+            typedef quint16 Value;
+            static constexpr quint16 at(int i) {
+                return static_cast<quint16>(4095 * Constexpr::square(i / 4095.0));
+            }
+        };
+    }
+
+    constexpr ColorTable<quint32, TransferLutSize> LinearizationTable =
+            generate<Linearization, TransferLutSize>();
+    constexpr ColorTable<quint32, CompandingTableSize + 2> CompandingTable =
+            generate<Companding, CompandingTableSize + 2>();
+    constexpr ColorTable<quint32, LabCompressionTableSize + 2> LabCompressionTable =
+            generate<LabCompression, LabCompressionTableSize + 2>();
+    constexpr ColorTable<quint16, 3 * TransferLutSize> LuminanceTable =
+            generate<Luminance, 3 * TransferLutSize>();
+    constexpr ColorTable<quint16, TransferLutSize> DefaultGammaTable =
+            generate<DefaultGammaCurve, TransferLutSize>();
+}
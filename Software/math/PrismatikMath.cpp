@@ -24,8 +24,10 @@
  */
 
 #include "PrismatikMath.hpp"
+#include "ColorTables.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include "common/DebugOut.hpp"
 
 namespace PrismatikMath
@@ -63,6 +65,24 @@ namespace PrismatikMath
         eRgb.b = (brightness / 100.0) * eRgb.b;
     }
 
+    void fillGammaLut(double gamma, quint16 *lut) {
+        if (gamma == DefaultGamma) {
+            memcpy(lut, DefaultGammaTable.values, sizeof(DefaultGammaTable.values));
+            return;
+        }
+        for (int i = 0; i < TransferLutSize; ++i)
+            lut[i] = static_cast<unsigned>(4095 * pow(i / 4095.0, gamma));
+    }
+
+    void fillBrightnessLut(unsigned int brightness, quint16 *lut) {
+        for (int i = 0; i < TransferLutSize; ++i) {
+            StructRgb rgb;
+            rgb.r = i;
+            brightnessCorrection(brightness, rgb);
+            lut[i] = rgb.r;
+        }
+    }
+
     void maxCorrection(unsigned int max, StructRgb & eRgb) {
         if (eRgb.r > max) eRgb.r = max;
         if (eRgb.g > max) eRgb.g = max;
@@ -129,17 +149,30 @@ namespace PrismatikMath
         return qRgb(r,g,b);
     }
 
-    StructRgb avgColor(const QList<StructRgb> &colors) {
+    void maxCorrection(unsigned int max, RgbBuffer &colors) {
+        const quint16 limit = std::min(max, 0xffffu);
+        quint16 *planes[] = { colors.red(), colors.green(), colors.blue() };
+        for (int c = 0; c < 3; ++c) {
+            quint16 *plane = planes[c];
+            for (int i = 0; i < colors.count(); ++i)
+                plane[i] = std::min(plane[i], limit);
+        }
+    }
+
+    StructRgb avgColor(const RgbBuffer &colors) {
         StructRgb result;
-        if (colors.size() > 0) {
-            for (int i = 0; i < colors.size(); ++i) {
-                result.r += colors[i].r;
-                result.g += colors[i].g;
-                result.b += colors[i].b;
+        if (colors.count() > 0) {
+            const quint16 *r = colors.red();
+            const quint16 *g = colors.green();
+            const quint16 *b = colors.blue();
+            for (int i = 0; i < colors.count(); ++i) {
+                result.r += r[i];
+                result.g += g[i];
+                result.b += b[i];
             }
-            result.r /= colors.size();
-            result.g /= colors.size();
-            result.b /= colors.size();
+            result.r /= colors.count();
+            result.g /= colors.count();
+            result.b /= colors.count();
         }
         return result;
     }
@@ -280,4 +313,118 @@ namespace PrismatikMath
     StructRgb toRgb(const StructLab &lab) {
         return toRgb(toXyz(lab));
     }
+
+    namespace
+    {
+        constexpr qint64 fixedPoint(double x) {
+            return static_cast<qint64>(x * FixedPointScale + (x < 0 ? -0.5 : 0.5));
+        }
+
+        // Rows of the toXyz() matrix over the reference white
+        const int XyzMatrixShift = FixedPointShift;
+        constexpr quint64 xyzCoefficient(double k, double reference) {
+            return static_cast<quint64>(k * 100 / reference * (1 << XyzMatrixShift) + 0.5);
+        }
+        const quint64 XyzMatrix[3][3] = {
+            { xyzCoefficient(0.4124, 95.047), xyzCoefficient(0.3576, 95.047), xyzCoefficient(0.1805, 95.047) },
+            { xyzCoefficient(0.2126, 100.0), xyzCoefficient(0.7152, 100.0), xyzCoefficient(0.0722, 100.0) },
+            { xyzCoefficient(0.0193, 108.883), xyzCoefficient(0.1192, 108.883), xyzCoefficient(0.9505, 108.883) }
+        };
+
+        // Rows of the toRgb() matrix with the reference white folded in
+        const qint64 RgbMatrix[3][3] = {
+            { fixedPoint(3.2406 * 0.95047), fixedPoint(-1.5372), fixedPoint(-0.4986 * 1.08883) },
+            { fixedPoint(-0.9689 * 0.95047), fixedPoint(1.8758), fixedPoint(0.0415 * 1.08883) },
+            { fixedPoint(0.0557 * 0.95047), fixedPoint(-0.2040), fixedPoint(1.0570 * 1.08883) }
+        };
+
+        const qint64 LabOffset = fixedPoint(16.0 / 116);
+        // cube root of the 0.008856 where f(t) turns linear
+        const qint64 LabKnee = fixedPoint(0.206893);
+
+        inline quint64 linearized(quint16 channel) {
+            return LinearizationTable.values[std::min<quint16>(channel, TransferLutSize - 1)];
+        }
+
+        // \a t with \a shift fraction bits to a value of \a table between its steps
+        inline qint64 interpolated(const quint32 *table, qint64 t, int shift) {
+            const quint32 *values = table + (t >> shift);
+            const qint64 fraction = t & ((Q_INT64_C(1) << shift) - 1);
+            return values[0] + ((static_cast<qint64>(values[1]) - values[0]) * fraction >> shift);
+        }
+
+        inline qint64 labCompressed(quint64 t) {
+            return interpolated(LabCompressionTable.values, std::min<quint64>(t, FixedPointScale), LabCompressionTableShift);
+        }
+
+        inline qint64 labExpanded(qint64 f) {
+            if (f > LabKnee)
+                return (f * f >> FixedPointShift) * f >> FixedPointShift;
+            // divided by 7.787, truncating towards zero for negative values too
+            return (f - LabOffset) * 1000 / 7787;
+        }
+
+        // Sum of a row of RgbMatrix, twice FixedPointShift fraction bits
+        inline quint16 companded(qint64 linear) {
+            const qint64 one = static_cast<qint64>(FixedPointScale) * FixedPointScale;
+            const qint64 value = interpolated(CompandingTable.values, withinRange<qint64, qint64>(linear, 0, one),
+                                              FixedPointShift + CompandingTableShift);
+            return static_cast<quint16>((value + (1 << (CompandedShift - 1))) >> CompandedShift);
+        }
+
+        // \a value in fixed point to the nearest integer within \a min and \a max
+        inline int rounded(qint64 value, int min, int max) {
+            value = withinRange<qint64, qint64>(value, static_cast<qint64>(min) * FixedPointScale,
+                                                static_cast<qint64>(max) * FixedPointScale);
+            return static_cast<int>((value - static_cast<qint64>(min) * FixedPointScale + FixedPointScale / 2) >> FixedPointShift) + min;
+        }
+    }
+
+    void toLab(const RgbBuffer &rgb, StructLab *lab) {
+        const quint16 *red = rgb.red();
+        const quint16 *green = rgb.green();
+        const quint16 *blue = rgb.blue();
+        for (int i = 0; i < rgb.count(); ++i) {
+            const quint64 r = linearized(red[i]);
+            const quint64 g = linearized(green[i]);
+            const quint64 b = linearized(blue[i]);
+            qint64 f[3];
+            for (int row = 0; row < 3; ++row) {
+                const quint64 *k = XyzMatrix[row];
+                f[row] = labCompressed((r * k[0] + g * k[1] + b * k[2]) >> XyzMatrixShift);
+            }
+            lab[i].l = static_cast<unsigned char>(rounded(116 * f[1] - 16 * FixedPointScale, 0, 255));
+            lab[i].a = static_cast<char>(rounded(500 * (f[0] - f[1]), -128, 127));
+            lab[i].b = static_cast<char>(rounded(200 * (f[1] - f[2]), -128, 127));
+        }
+    }
+
+    void toLuminance(const RgbBuffer &rgb, quint32 *luminance) {
+        const quint16 *red = rgb.red();
+        const quint16 *green = rgb.green();
+        const quint16 *blue = rgb.blue();
+        const quint16 *redTable = LuminanceTable.values;
+        const quint16 *greenTable = redTable + TransferLutSize;
+        const quint16 *blueTable = greenTable + TransferLutSize;
+        for (int i = 0; i < rgb.count(); ++i) {
+            luminance[i] = redTable[std::min<quint16>(red[i], TransferLutSize - 1)]
+                    + greenTable[std::min<quint16>(green[i], TransferLutSize - 1)]
+                    + blueTable[std::min<quint16>(blue[i], TransferLutSize - 1)];
+        }
+    }
+
+    void toRgb(const StructLab *lab, int count, RgbBuffer &rgb) {
+        rgb.resize(count);
+        quint16 *planes[] = { rgb.red(), rgb.green(), rgb.blue() };
+        for (int i = 0; i < count; ++i) {
+            const qint64 fy = ((lab[i].l + 16) * static_cast<qint64>(FixedPointScale) + 58) / 116;
+            const qint64 x = labExpanded(fy + lab[i].a * static_cast<qint64>(FixedPointScale) / 500);
+            const qint64 y = labExpanded(fy);
+            const qint64 z = labExpanded(fy - lab[i].b * static_cast<qint64>(FixedPointScale) / 200);
+            for (int row = 0; row < 3; ++row) {
+                const qint64 *k = RgbMatrix[row];
+                planes[row][i] = companded(x * k[0] + y * k[1] + z * k[2]);
+            }
+        }
+    }
 }
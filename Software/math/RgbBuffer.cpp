@@ -0,0 +1,116 @@
+/*
+ * RgbBuffer.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "RgbBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const int kPlaneGranularity = RgbBuffer::Alignment / sizeof(quint16);
+}
+
+RgbBuffer::RgbBuffer()
+    : m_count(0)
+    , m_planeSize(0)
+    , m_data(NULL)
+{
+}
+
+RgbBuffer::RgbBuffer(int count)
+    : m_count(0)
+    , m_planeSize(0)
+    , m_data(NULL)
+{
+    resize(count);
+}
+
+RgbBuffer::RgbBuffer(const RgbBuffer &other)
+    : m_count(0)
+    , m_planeSize(0)
+    , m_data(NULL)
+{
+    *this = other;
+}
+
+RgbBuffer & RgbBuffer::operator=(const RgbBuffer &other)
+{
+    if (this == &other)
+        return *this;
+
+    resize(other.count());
+    std::copy(other.red(), other.red() + m_count, red());
+    std::copy(other.green(), other.green() + m_count, green());
+    std::copy(other.blue(), other.blue() + m_count, blue());
+    return *this;
+}
+
+RgbBuffer::~RgbBuffer()
+{
+    qFreeAligned(m_data);
+}
+
+void RgbBuffer::resize(int count)
+{
+    count = std::max(count, 0);
+    if (count > m_planeSize) {
+        const int planeSize = (count + kPlaneGranularity - 1) / kPlaneGranularity * kPlaneGranularity;
+        quint16 *data = static_cast<quint16 *>(qMallocAligned(3 * planeSize * sizeof(quint16), Alignment));
+        memset(data, 0, 3 * planeSize * sizeof(quint16));
+        if (m_data) {
+            for (int c = 0; c < 3; ++c)
+                memcpy(data + c * planeSize, m_data + c * m_planeSize, m_count * sizeof(quint16));
+            qFreeAligned(m_data);
+        }
+        m_data = data;
+        m_planeSize = planeSize;
+    } else if (count > m_count) {
+        for (int c = 0; c < 3; ++c)
+            memset(m_data + c * m_planeSize + m_count, 0, (count - m_count) * sizeof(quint16));
+    }
+    m_count = count;
+}
+
+void RgbBuffer::fill(const StructRgb &color)
+{
+    std::fill_n(red(), m_count, static_cast<quint16>(color.r));
+    std::fill_n(green(), m_count, static_cast<quint16>(color.g));
+    std::fill_n(blue(), m_count, static_cast<quint16>(color.b));
+}
+
+StructRgb RgbBuffer::at(int index) const
+{
+    StructRgb color;
+    color.r = red()[index];
+    color.g = green()[index];
+    color.b = blue()[index];
+    return color;
+}
+
+void RgbBuffer::set(int index, const StructRgb &color)
+{
+    red()[index] = color.r;
+    green()[index] = color.g;
+    blue()[index] = color.b;
+}
@@ -0,0 +1,236 @@
+/*
+ * TemporalInterpolator.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TemporalInterpolator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const int kFractionBits = 16;
+const qint32 kOne = 1 << kFractionBits;
+// positions must not overflow 16.16
+const int kMaxChannelValue = 0x7fff;
+// closer than one 12 bit step counts as reached
+const qint32 kSettleDistance = kOne;
+
+// coefficients of a frame are 2.30 fixed-point
+const int kCoefBits = 30;
+
+inline qint64 coef(double value)
+{
+    return static_cast<qint64>(std::floor(value * (Q_INT64_C(1) << kCoefBits) + 0.5));
+}
+
+inline quint16 toChannel(qint32 position)
+{
+    return static_cast<quint16>(qBound(0, (position + kOne / 2) >> kFractionBits, kMaxChannelValue));
+}
+}
+
+TemporalInterpolator::TemporalInterpolator()
+    : m_mode(ModeOff)
+    , m_smoothingTime(100)
+    , m_isSettled(true)
+    , m_progress(kOne)
+{
+}
+
+void TemporalInterpolator::setMode(Mode mode)
+{
+    if (mode == m_mode)
+        return;
+
+    m_mode = mode;
+    if (mode == ModeOff) {
+        jumpToTarget();
+        return;
+    }
+    // the way to the target starts over from the current colors
+    std::copy(m_positions.constBegin(), m_positions.constEnd(), m_starts.begin());
+    m_velocities.fill(0);
+    m_progress = 0;
+    m_isSettled = false;
+}
+
+void TemporalInterpolator::setSmoothingTime(int msec)
+{
+    m_smoothingTime = qMax(1, msec);
+}
+
+void TemporalInterpolator::setTarget(const RgbBuffer &target)
+{
+    const bool isJump = m_mode == ModeOff || target.count() != m_target.count()
+            || m_positions.count() != 3 * target.count();
+    m_target = target;
+    if (isJump) {
+        jumpToTarget();
+        return;
+    }
+
+    std::copy(m_positions.constBegin(), m_positions.constEnd(), m_starts.begin());
+    m_progress = 0;
+    m_isSettled = false;
+}
+
+void TemporalInterpolator::reset()
+{
+    m_target.resize(0);
+    m_positions.clear();
+    m_starts.clear();
+    m_velocities.clear();
+    m_progress = kOne;
+    m_isSettled = true;
+}
+
+void TemporalInterpolator::jumpToTarget()
+{
+    const int count = m_target.count();
+    m_positions.resize(3 * count);
+    m_starts.resize(3 * count);
+    m_velocities.resize(3 * count);
+
+    const quint16 *planes[] = { m_target.red(), m_target.green(), m_target.blue() };
+    for (int c = 0; c < 3; ++c) {
+        qint32 *positions = m_positions.data() + c * count;
+        for (int i = 0; i < count; ++i)
+            positions[i] = qMin<qint32>(planes[c][i], kMaxChannelValue) << kFractionBits;
+    }
+    std::copy(m_positions.constBegin(), m_positions.constEnd(), m_starts.begin());
+    m_velocities.fill(0);
+    m_progress = kOne;
+    m_isSettled = true;
+}
+
+bool TemporalInterpolator::advance(qint64 elapsedUsec, RgbBuffer &colors)
+{
+    bool isMoving = false;
+    if (!m_isSettled) {
+        elapsedUsec = qMax<qint64>(0, elapsedUsec);
+        switch (m_mode) {
+        case ModeLinear:
+            isMoving = advanceLinear(elapsedUsec);
+            break;
+        case ModeExponential:
+            isMoving = advanceExponential(elapsedUsec);
+            break;
+        case ModeCriticallyDamped:
+            isMoving = advanceCriticallyDamped(elapsedUsec);
+            break;
+        default:
+            break;
+        }
+        if (!isMoving)
+            jumpToTarget();
+    }
+
+    const int count = m_target.count();
+    colors.resize(count);
+    quint16 *planes[] = { colors.red(), colors.green(), colors.blue() };
+    for (int c = 0; c < 3; ++c) {
+        const qint32 *positions = m_positions.constData() + c * count;
+        quint16 *plane = planes[c];
+        for (int i = 0; i < count; ++i)
+            plane[i] = toChannel(positions[i]);
+    }
+    return isMoving;
+}
+
+bool TemporalInterpolator::advanceLinear(qint64 elapsedUsec)
+{
+    const qint64 duration = static_cast<qint64>(m_smoothingTime) * 1000;
+    m_progress = static_cast<qint32>(qMin<qint64>(kOne, m_progress + elapsedUsec * kOne / duration));
+    if (m_progress >= kOne)
+        return false;
+
+    const int count = m_target.count();
+    const quint16 *planes[] = { m_target.red(), m_target.green(), m_target.blue() };
+    for (int c = 0; c < 3; ++c) {
+        const quint16 *target = planes[c];
+        const qint32 *starts = m_starts.constData() + c * count;
+        qint32 *positions = m_positions.data() + c * count;
+        for (int i = 0; i < count; ++i) {
+            const qint32 end = qMin<qint32>(target[i], kMaxChannelValue) << kFractionBits;
+            positions[i] = starts[i] + static_cast<qint32>((static_cast<qint64>(end - starts[i]) * m_progress) >> kFractionBits);
+        }
+    }
+    return true;
+}
+
+bool TemporalInterpolator::advanceExponential(qint64 elapsedUsec)
+{
+    const qint64 alpha = coef(1 - std::exp(-elapsedUsec / (m_smoothingTime * 1000.0)));
+
+    const int count = m_target.count();
+    const quint16 *planes[] = { m_target.red(), m_target.green(), m_target.blue() };
+    bool isMoving = false;
+    for (int c = 0; c < 3; ++c) {
+        const quint16 *target = planes[c];
+        qint32 *positions = m_positions.data() + c * count;
+        for (int i = 0; i < count; ++i) {
+            const qint32 end = qMin<qint32>(target[i], kMaxChannelValue) << kFractionBits;
+            const qint32 distance = end - positions[i];
+            const qint32 left = distance - static_cast<qint32>((distance * alpha) >> kCoefBits);
+            positions[i] = end - left;
+            isMoving |= qAbs(left) > kSettleDistance;
+        }
+    }
+    return isMoving;
+}
+
+/*!
+  Exact solution of x'' = -x - 2x' over the frame with time in halves of the
+  smoothing time, so frames of any length give the same curve and it can't
+  become unstable. The offset crosses zero at most once: never from rest, once
+  when the carried speed is too high for the distance left.
+*/
+bool TemporalInterpolator::advanceCriticallyDamped(qint64 elapsedUsec)
+{
+    const double h = 2 * elapsedUsec / (m_smoothingTime * 1000.0);
+    const double e = std::exp(-h);
+    const qint64 positionOfPosition = coef((1 + h) * e);
+    const qint64 positionOfVelocity = coef(h * e);
+    const qint64 velocityOfPosition = coef(-h * e);
+    const qint64 velocityOfVelocity = coef((1 - h) * e);
+
+    const int count = m_target.count();
+    const quint16 *planes[] = { m_target.red(), m_target.green(), m_target.blue() };
+    bool isMoving = false;
+    for (int c = 0; c < 3; ++c) {
+        const quint16 *target = planes[c];
+        qint32 *positions = m_positions.data() + c * count;
+        qint32 *velocities = m_velocities.data() + c * count;
+        for (int i = 0; i < count; ++i) {
+            const qint32 end = qMin<qint32>(target[i], kMaxChannelValue) << kFractionBits;
+            const qint64 offset = positions[i] - end;
+            const qint64 velocity = velocities[i];
+            const qint32 newOffset = static_cast<qint32>((offset * positionOfPosition + velocity * positionOfVelocity) >> kCoefBits);
+            const qint32 newVelocity = static_cast<qint32>((offset * velocityOfPosition + velocity * velocityOfVelocity) >> kCoefBits);
+            positions[i] = end + newOffset;
+            velocities[i] = newVelocity;
+            isMoving |= qAbs(newOffset) > kSettleDistance || qAbs(newVelocity) > kSettleDistance;
+        }
+    }
+    return isMoving;
+}
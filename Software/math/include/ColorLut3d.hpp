@@ -0,0 +1,68 @@
+/*
+ * ColorLut3d.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include "RgbBuffer.hpp"
+
+/*!
+  3D color lookup table, e.g. from a colorimeter calibration. Maps every
+  12 bit color to another one with tetrahedral interpolation between the
+  lattice points, so cross-channel corrections are possible.
+*/
+class ColorLut3d
+{
+public:
+    static const int MinSize = 2;
+    static const int MaxSize = 65;
+
+    ColorLut3d();
+
+    /*!
+      Loads a table from a .cube file, keeps the current one on errors
+    */
+    bool load(const QString &fileName);
+    void clear();
+
+    bool isNull() const { return m_size == 0; }
+    // lattice points per axis
+    int size() const { return m_size; }
+
+    /*!
+      Maps \a colors to \a result, which is resized to their count and may be
+      \a colors itself
+    */
+    void apply(const RgbBuffer &colors, RgbBuffer &result) const;
+
+private:
+    int m_size;
+    // input channel to lattice coordinate: (c / 4095 - m_domainMin) * m_domainScale
+    float m_domainMin[3];
+    float m_domainScale[3];
+    // 12 bit output of every lattice point, red index changes fastest
+    QVector<float> m_red;
+    QVector<float> m_green;
+    QVector<float> m_blue;
+};
@@ -0,0 +1,107 @@
+/*
+ * ColorTables.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QtGlobal>
+#include "PrismatikMath.hpp"
+
+namespace PrismatikMath
+{
+    /*!
+      Compile time versions of the functions the color tables are built from.
+      C++11 constexpr functions are a single return statement, so loops are
+      written as recursion. Accurate to a few units in the last place of a double.
+    */
+    namespace Constexpr
+    {
+        constexpr double square(double x) {
+            return x * x;
+        }
+
+        // ln((1 + z) / (1 - z)) / 2 = z + z^3/3 + z^5/5 + ...
+        constexpr double atanhSeries(double z2, double term, int n) {
+            return n > 20 ? 0 : term / (2 * n + 1) + atanhSeries(z2, term * z2, n + 1);
+        }
+
+        constexpr double logReduced(double z) {
+            return 2 * atanhSeries(z * z, z, 0);
+        }
+
+        // \a x must be positive
+        constexpr double log(double x) {
+            return x < 0.7 ? log(x * 2) - 0.69314718055994530942
+                 : x > 1.4 ? log(x / 2) + 0.69314718055994530942
+                 : logReduced((x - 1) / (x + 1));
+        }
+
+        constexpr double expSeries(double x, double term, int n) {
+            return n > 20 ? term : term + expSeries(x, term * x / n, n + 1);
+        }
+
+        constexpr double exp(double x) {
+            return x > 0.5 || x < -0.5 ? square(exp(x / 2)) : expSeries(x, 1, 1);
+        }
+
+        // \a base must be positive
+        constexpr double pow(double base, double exponent) {
+            return exp(exponent * log(base));
+        }
+    }
+
+    template <typename T, int Size>
+    struct ColorTable {
+        T values[Size];
+    };
+
+    // The tables of the Lab conversions are fixed point with FixedPointShift
+    // fraction bits. With 16 lightness rounds differently from doubles often
+    // enough to move LEDs across the luminosity threshold. A fixed point value
+    // splits into an index and a fraction of the table steps with its shift
+    const int FixedPointShift = 24;
+    const int FixedPointScale = 1 << FixedPointShift;
+    const int LabCompressionTableShift = FixedPointShift - 12;
+    const int LabCompressionTableSize = FixedPointScale >> LabCompressionTableShift;
+    // finer, toRgb() of dark colors ends up just above the linear segment of
+    // the curve where it bends the most
+    const int CompandingTableShift = FixedPointShift - 14;
+    const int CompandingTableSize = FixedPointScale >> CompandingTableShift;
+    // 12 bit channels of CompandingTable keep 16 fraction bits
+    const int CompandedShift = 16;
+
+    // Generated at compile time, so they are plain read only data without any
+    // initialization at startup
+
+    // 12 bit sRGB channel to linear light, as in toXyz() over 100
+    extern const ColorTable<quint32, TransferLutSize> LinearizationTable;
+    // Linear light from 0 to 1 in CompandingTableSize steps to 12 bit sRGB
+    // channel, as in toRgb()
+    extern const ColorTable<quint32, CompandingTableSize + 2> CompandingTable;
+    // f(t) of the Lab conversion for t from 0 to 1 in LabCompressionTableSize steps
+    extern const ColorTable<quint32, LabCompressionTableSize + 2> LabCompressionTable;
+    // 12 bit red, green and blue channels to their part of toLuminance(), one
+    // table after another. Parts of white sum to LuminanceScale
+    extern const ColorTable<quint16, 3 * TransferLutSize> LuminanceTable;
+    // fillGammaLut() result for DefaultGamma
+    extern const ColorTable<quint16, TransferLutSize> DefaultGammaTable;
+}
@@ -29,20 +29,31 @@
 #include <QRgb>
 #include <cmath>
 #include "colorspace_types.h"
+#include "RgbBuffer.hpp"
 #include "../../common/defs.h"
 
 namespace PrismatikMath
 {
     void gammaCorrection(double gamma, StructRgb &);
     void brightnessCorrection(unsigned int brightness, StructRgb &);
+
+    // Tables of 12 bit channel values giving the same results as the
+    // corrections above. They are filled when a setting changes, so a frame
+    // only looks values up
+    const int TransferLutSize = 4096;
+    // Gamma of new profiles, its table is prebuilt
+    const double DefaultGamma = 2.0;
+    void fillGammaLut(double gamma, quint16 *lut);
+    void fillBrightnessLut(unsigned int brightness, quint16 *lut);
     void maxCorrection(unsigned int max, StructRgb &);
+    void maxCorrection(unsigned int max, RgbBuffer &);
     int getValueHSV(const QRgb rgb);
     int getChromaHSV(const QRgb rgb);
     int max(const QRgb);
     int min(const QRgb);
     QRgb withValueHSV(const QRgb, int);
     QRgb withChromaHSV(const QRgb, int);
-    StructRgb avgColor(const QList<StructRgb> &);
+    StructRgb avgColor(const RgbBuffer &);
     StructXyz toXyz(const StructRgb &);
     StructXyz toXyz(const StructLab &);
     StructLab toLab(const StructRgb &);
@@ -50,6 +61,17 @@ namespace PrismatikMath
     StructRgb toRgb(const StructXyz &);
     StructRgb toRgb(const StructLab &);
 
+    // Conversions of whole buffers, within one unit of the ones above. Both
+    // are integer math on fixed point tables, so prefer them for frames.
+    // \a lab holds rgb.count() colors, \a rgb is resized to \a count
+    void toLab(const RgbBuffer &rgb, StructLab *lab);
+    void toRgb(const StructLab *lab, int count, RgbBuffer &rgb);
+    // Relative luminance, Y of toXyz() over 100, of every color in integers
+    // with LuminanceScale for 1. Cheaper than toLab() and lightness grows with
+    // it, so it can rule out dark colors first
+    const quint32 LuminanceScale = 1 << 16;
+    void toLuminance(const RgbBuffer &rgb, quint32 *luminance);
+
     // Convert ASCII char '5' to 5
     inline char getDigit(const char d)
     {
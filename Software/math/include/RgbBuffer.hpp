@@ -0,0 +1,69 @@
+/*
+ * RgbBuffer.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QtGlobal>
+#include "colorspace_types.h"
+
+/*!
+  12 bit colors stored as separate planes of red, green and blue. Planes are
+  aligned to and padded up to \a Alignment bytes, so loops over them
+  vectorize. Storage only grows, resizing to a smaller count doesn't
+  reallocate.
+*/
+class RgbBuffer
+{
+public:
+    static const int Alignment = 64;
+
+    RgbBuffer();
+    explicit RgbBuffer(int count);
+    RgbBuffer(const RgbBuffer &other);
+    RgbBuffer & operator=(const RgbBuffer &other);
+    ~RgbBuffer();
+
+    int count() const { return m_count; }
+
+    /*!
+      Keeps colors below \a count, added ones are black
+    */
+    void resize(int count);
+    void fill(const StructRgb &color);
+
+    quint16 * red() { return m_data; }
+    quint16 * green() { return m_data + m_planeSize; }
+    quint16 * blue() { return m_data + 2 * m_planeSize; }
+    const quint16 * red() const { return m_data; }
+    const quint16 * green() const { return m_data + m_planeSize; }
+    const quint16 * blue() const { return m_data + 2 * m_planeSize; }
+
+    StructRgb at(int index) const;
+    void set(int index, const StructRgb &color);
+
+private:
+    int m_count;
+    // entries per plane, a multiple of Alignment / sizeof(quint16)
+    int m_planeSize;
+    quint16 *m_data;
+};
@@ -0,0 +1,96 @@
+/*
+ * TemporalInterpolator.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QtGlobal>
+#include <QVector>
+#include "RgbBuffer.hpp"
+
+/*!
+  Moves 12 bit colors towards the latest target in frames of any length, so a
+  device can be sent more frames than colors are grabbed. Per LED work is
+  fixed-point: positions are 16.16, coefficients are computed once per frame.
+*/
+class TemporalInterpolator
+{
+public:
+    enum Mode {
+        ModeOff,
+        // straight line from the current colors to the target in the smoothing time
+        ModeLinear,
+        // exponential moving average, 63% of the way in the smoothing time
+        ModeExponential,
+        // spring keeping its speed across targets, about 60% of the way in the
+        // smoothing time. From rest it never passes the target; the speed of a
+        // move towards a new target closer than that passes it once and comes
+        // back without oscillating
+        ModeCriticallyDamped
+    };
+
+    TemporalInterpolator();
+
+    void setMode(Mode mode);
+    Mode mode() const { return m_mode; }
+    void setSmoothingTime(int msec);
+    int smoothingTime() const { return m_smoothingTime; }
+
+    /*!
+      Starts moving from the current colors to \a target. Jumps to it when there
+      were no colors before or the count of LEDs changed.
+    */
+    void setTarget(const RgbBuffer &target);
+
+    /*!
+      Forgets the current colors, the next target is jumped to
+    */
+    void reset();
+
+    /*!
+      Moves the colors \a elapsedUsec further and writes them to \a colors
+      \return false once the target is reached and more frames won't change anything
+    */
+    bool advance(qint64 elapsedUsec, RgbBuffer &colors);
+    bool isSettled() const { return m_isSettled; }
+
+private:
+    void jumpToTarget();
+    // returns false if all LEDs settled
+    bool advanceLinear(qint64 elapsedUsec);
+    bool advanceExponential(qint64 elapsedUsec);
+    bool advanceCriticallyDamped(qint64 elapsedUsec);
+
+private:
+    Mode m_mode;
+    int m_smoothingTime;
+    bool m_isSettled;
+    RgbBuffer m_target;
+    // 16.16 fixed-point, planes of red, green and blue one after another
+    QVector<qint32> m_positions;
+    // where the current linear move started
+    QVector<qint32> m_starts;
+    // critically damped speed, 16.16 per half of the smoothing time
+    QVector<qint32> m_velocities;
+    // linear: part of the move done, 16.16
+    qint32 m_progress;
+};
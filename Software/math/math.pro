@@ -11,12 +11,23 @@ CONFIG += staticlib
 
 include(../build-config.prf)
 
+CONFIG(gcc):QMAKE_CXXFLAGS += -std=c++11
+CONFIG(clang):QMAKE_CXXFLAGS += -std=c++11 -stdlib=libc++
+
 INCLUDEPATH += ./include \
                ../ \
 
 SOURCES += \
-    PrismatikMath.cpp
+    PrismatikMath.cpp \
+    RgbBuffer.cpp \
+    ColorLut3d.cpp \
+    ColorTables.cpp \
+    TemporalInterpolator.cpp
 
 HEADERS += \
     include/colorspace_types.h \
-    include/PrismatikMath.hpp
+    include/PrismatikMath.hpp \
+    include/RgbBuffer.hpp \
+    include/ColorLut3d.hpp \
+    include/ColorTables.hpp \
+    include/TemporalInterpolator.hpp
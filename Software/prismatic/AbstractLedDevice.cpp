@@ -25,10 +25,39 @@
  */
 
 #include "AbstractLedDevice.hpp"
+#include <algorithm>
+#include <cmath>
 #include "colorspace_types.h"
 #include "PrismatikMath.hpp"
 #include "SettingsReader.hpp"
 
+namespace {
+const int kChannelLutSize = 256;
+// tables of red, green and blue of one LED
+const int kLedLutsSize = 3 * kChannelLutSize;
+}
+
+AbstractLedDevice::AbstractLedDevice(QObject * parent)
+    : QObject(parent)
+    , m_lutGamma(-1)
+    , m_lutBrightness(-1)
+    , m_isLutBrightnessFused(false)
+    , m_isChannelLutsDirty(true)
+    , m_colorsKernel(NULL)
+    , m_colorsKernelKey(-1)
+    , m_cachedLuminosityThreshold(-1)
+    , m_thresholdLuminance(0)
+    , m_isColorsCacheValid(false)
+    , m_changedLedsCount(0)
+    , m_smoothMode(TemporalInterpolator::ModeOff)
+    , m_hostSmoothSlowdown(0)
+{
+    // a child, so it moves to the device thread with the device
+    m_smoothingTimer = new QTimer(this);
+    m_smoothingTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_smoothingTimer, SIGNAL(timeout()), this, SLOT(writeNextSmoothedFrame()));
+}
+
 void AbstractLedDevice::setGamma(double value) {
     m_gamma = value;
     setColors(m_colorsSaved);
@@ -52,6 +81,7 @@ void AbstractLedDevice::setMinimumLuminosityThresholdEnabled(bool value) {
 void AbstractLedDevice::updateWBAdjustments(const QList<WBAdjustment> &coefs) {
     m_wbAdjustments.clear();
     m_wbAdjustments.append(coefs);
+    m_isChannelLutsDirty = true;
     setColors(m_colorsSaved);
 }
 
@@ -62,6 +92,9 @@ void AbstractLedDevice::updateDeviceSettings()
     setBrightness(SettingsReader::instance()->getDeviceBrightness());
     setLuminosityThreshold(SettingsReader::instance()->getLuminosityThreshold());
     setMinimumLuminosityThresholdEnabled(SettingsReader::instance()->isMinimumLuminosityEnabled());
+    setColorLutFile(SettingsReader::instance()->getDeviceColorLutFile());
+    setSmoothMode(SettingsReader::instance()->getDeviceSmoothMode());
+    setHostSmoothSlowdown(SettingsReader::instance()->getDeviceSmooth());
     updateWBAdjustments(SettingsReader::instance()->getLedCoefs());
 }
 
@@ -69,53 +102,394 @@ void AbstractLedDevice::updateDeviceSettings()
   Modifies colors according to gamma, luminosity threshold, white balance and brightness settings
   All modifications are made over extended 12bit RGB, so \code outColors \endcode will contain 12bit
   RGB instead of 8bit.
+  12bit expansion, white balance, gamma and, when the luminosity threshold is off, brightness are
+  looked up from tables of every LED channel. The rest runs in a kernel specialized for the
+  stages in use, picked again only when they change.
+  Results are cached per LED, only LEDs with a new input color are modified again until settings
+  change. \a isLedColorChanged() tells which results differ from the previous call.
+  A loaded 3D color table replaces white balance, gamma and the luminosity threshold.
 */
-void AbstractLedDevice::applyColorModifications(const QList<QRgb> &inColors, QList<StructRgb> &outColors) {
+void AbstractLedDevice::applyColorModifications(const QList<QRgb> &inColors, RgbBuffer &outColors) {
 
     bool isApplyWBAdjustments = m_wbAdjustments.count() == inColors.count();
+    // lab.l can't be below zero, so the threshold has no effect then
+    ThresholdMode thresholdMode = ThresholdOff;
+    if (m_luminosityThreshold > 0)
+        thresholdMode = m_isMinimumLuminosityEnabled ? ThresholdMinimumLuminosity : ThresholdDeadZone;
+
+    bool isColorLutEnabled = !m_colorLut.isNull();
+    if (isColorLutEnabled) {
+        isApplyWBAdjustments = false;
+        thresholdMode = ThresholdOff;
+    }
+
+    // brightness goes after the luminosity threshold and the 3D table, it can be in the tables
+    // only without them
+    bool isBrightnessFused = !isColorLutEnabled && thresholdMode == ThresholdOff;
+    bool isSettingsChanged = updateColorLuts(isBrightnessFused);
+    bool isApplyBrightness = !isBrightnessFused && m_brightness != 100;
+
+    const int kernelKey = isApplyWBAdjustments | thresholdMode << 1 | isApplyBrightness << 3 | isColorLutEnabled << 4;
+    if (kernelKey != m_colorsKernelKey) {
+        m_colorsKernel = colorsKernel(isColorLutEnabled, isApplyWBAdjustments, thresholdMode, isApplyBrightness);
+        m_colorsKernelKey = kernelKey;
+        isSettingsChanged = true;
+    }
+    if (m_cachedLuminosityThreshold != m_luminosityThreshold) {
+        m_cachedLuminosityThreshold = m_luminosityThreshold;
+        // a unit above covers rounding of the lightness
+        StructLab lab;
+        lab.l = qBound(0, m_luminosityThreshold + 1, 255);
+        m_thresholdLuminance = std::ceil(PrismatikMath::toXyz(lab).y / 100 * PrismatikMath::LuminanceScale);
+        isSettingsChanged = true;
+    }
+
+    const int count = qMin(inColors.count(), outColors.count());
+    if (isSettingsChanged || m_previousColors.count() != count)
+        resetColorsCache();
+    if (!m_isColorsCacheValid) {
+        m_previousColors.resize(count);
+        m_lutColors.resize(count);
+        m_modifiedColors.resize(count);
+        m_changedLeds.resize(count);
+        m_dirtyLeds.resize(count);
+    }
+
+    m_changedLeds.fill(!m_isColorsCacheValid);
+    m_changedLedsCount = m_isColorsCacheValid ? 0 : count;
+
+    (this->*m_colorsKernel)(inColors);
+    m_isColorsCacheValid = true;
+
+    std::copy(m_modifiedColors.red(), m_modifiedColors.red() + count, outColors.red());
+    std::copy(m_modifiedColors.green(), m_modifiedColors.green() + count, outColors.green());
+    std::copy(m_modifiedColors.blue(), m_modifiedColors.blue() + count, outColors.blue());
+}
+
+void AbstractLedDevice::resetColorsCache() {
+    m_isColorsCacheValid = false;
+}
+
+void AbstractLedDevice::setColorLutFile(const QString &fileName) {
+    if (fileName == m_colorLutFile)
+        return;
+
+    m_colorLutFile = fileName;
+    if (fileName.isEmpty() || !m_colorLut.load(fileName))
+        m_colorLut.clear();
+    resetColorsCache();
+    setColors(m_colorsSaved);
+}
+
+void AbstractLedDevice::setSmoothMode(TemporalInterpolator::Mode mode) {
+    m_smoothMode = mode;
+    updateSmoothing();
+}
+
+void AbstractLedDevice::setHostSmoothSlowdown(int value) {
+    m_hostSmoothSlowdown = value;
+    updateSmoothing();
+}
+
+void AbstractLedDevice::updateSmoothing() {
+    m_interpolator.setSmoothingTime(m_hostSmoothSlowdown);
+    m_interpolator.setMode(m_hostSmoothSlowdown > 0 ? m_smoothMode : TemporalInterpolator::ModeOff);
+    if (m_interpolator.mode() == TemporalInterpolator::ModeOff && m_smoothingTimer->isActive()) {
+        // don't leave the LEDs half way
+        m_smoothingTimer->stop();
+        m_interpolator.advance(0, m_smoothedColors);
+        writeSmoothedColors(m_smoothedColors);
+    }
+}
+
+void AbstractLedDevice::stopSmoothing() {
+    m_smoothingTimer->stop();
+    m_interpolator.reset();
+}
+
+void AbstractLedDevice::smoothColors(RgbBuffer &colors) {
+    if (m_interpolator.mode() == TemporalInterpolator::ModeOff)
+        return;
+
+    // a move from settled colors starts with them
+    const qint64 elapsedUsec = m_smoothingTimer->isActive() ? m_smoothingClock.nsecsElapsed() / 1000 : 0;
+    m_smoothingClock.start();
+    m_interpolator.setTarget(colors);
+    if (m_interpolator.advance(elapsedUsec, colors)) {
+        if (!m_smoothingTimer->isActive())
+            m_smoothingTimer->start(smoothingFrameInterval());
+    } else {
+        m_smoothingTimer->stop();
+    }
+}
+
+void AbstractLedDevice::writeNextSmoothedFrame() {
+    const qint64 elapsedUsec = m_smoothingClock.nsecsElapsed() / 1000;
+    m_smoothingClock.start();
+    if (!m_interpolator.advance(elapsedUsec, m_smoothedColors))
+        m_smoothingTimer->stop();
+    writeSmoothedColors(m_smoothedColors);
+}
+
+AbstractLedDevice::ColorsKernel AbstractLedDevice::colorsKernel(bool isColorLutEnabled, bool isPerLedLuts,
+                                                                ThresholdMode thresholdMode, bool isApplyBrightness) {
+    if (isColorLutEnabled) {
+        return isApplyBrightness ? &AbstractLedDevice::modifyColorsWithColorLut<true>
+                                 : &AbstractLedDevice::modifyColorsWithColorLut<false>;
+    }
+
+    // brightness is in the tables without threshold
+    static const ColorsKernel kKernels[2][3][2] = {
+        {
+            { &AbstractLedDevice::modifyColors<false, ThresholdOff, false>,
+              &AbstractLedDevice::modifyColors<false, ThresholdOff, false> },
+            { &AbstractLedDevice::modifyColors<false, ThresholdDeadZone, false>,
+              &AbstractLedDevice::modifyColors<false, ThresholdDeadZone, true> },
+            { &AbstractLedDevice::modifyColors<false, ThresholdMinimumLuminosity, false>,
+              &AbstractLedDevice::modifyColors<false, ThresholdMinimumLuminosity, true> }
+        },
+        {
+            { &AbstractLedDevice::modifyColors<true, ThresholdOff, false>,
+              &AbstractLedDevice::modifyColors<true, ThresholdOff, false> },
+            { &AbstractLedDevice::modifyColors<true, ThresholdDeadZone, false>,
+              &AbstractLedDevice::modifyColors<true, ThresholdDeadZone, true> },
+            { &AbstractLedDevice::modifyColors<true, ThresholdMinimumLuminosity, false>,
+              &AbstractLedDevice::modifyColors<true, ThresholdMinimumLuminosity, true> }
+        }
+    };
+    return kKernels[isPerLedLuts][thresholdMode][isApplyBrightness];
+}
 
-    for(int i = 0; i < inColors.count(); i++) {
+template <bool isPerLedLuts>
+int AbstractLedDevice::updateLutColors(const QList<QRgb> &inColors, const quint16 *lut) {
+    const int count = m_previousColors.count();
+    quint16 *lutRed = m_lutColors.red();
+    quint16 *lutGreen = m_lutColors.green();
+    quint16 *lutBlue = m_lutColors.blue();
 
-        //renormalize to 12bit
-        double k = 4095/255.0;
-        outColors[i].r = qRed(inColors[i])   * k;
-        outColors[i].g = qGreen(inColors[i]) * k;
-        outColors[i].b = qBlue(inColors[i])  * k;
+    int dirtyCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (isPerLedLuts)
+            lut += kLedLutsSize;
+        const QRgb color = inColors[i];
+        if (m_isColorsCacheValid && color == m_previousColors[i])
+            continue;
+        m_previousColors[i] = color;
+        m_dirtyLeds[dirtyCount++] = i;
+        lutRed[i] = lut[qRed(color)];
+        lutGreen[i] = lut[kChannelLutSize + qGreen(color)];
+        lutBlue[i] = lut[2 * kChannelLutSize + qBlue(color)];
+    }
+    return dirtyCount;
+}
 
-        if (isApplyWBAdjustments) {
-            outColors[i].r *= m_wbAdjustments[i].red;
-            outColors[i].g *= m_wbAdjustments[i].green;
-            outColors[i].b *= m_wbAdjustments[i].blue;
+void AbstractLedDevice::gatherDirtyColors(int dirtyCount) {
+    m_dirtyColors.resize(dirtyCount);
+    for (int k = 0; k < dirtyCount; ++k) {
+        const int i = m_dirtyLeds[k];
+        m_dirtyColors.red()[k] = m_lutColors.red()[i];
+        m_dirtyColors.green()[k] = m_lutColors.green()[i];
+        m_dirtyColors.blue()[k] = m_lutColors.blue()[i];
+    }
+}
+
+void AbstractLedDevice::applyBrightness(int dirtyCount) {
+    // keeps the lookup in range whatever the stages before produced
+    PrismatikMath::maxCorrection(PrismatikMath::TransferLutSize - 1, m_dirtyColors);
+    quint16 *planes[] = { m_dirtyColors.red(), m_dirtyColors.green(), m_dirtyColors.blue() };
+    for (int c = 0; c < 3; ++c) {
+        quint16 *plane = planes[c];
+        for (int k = 0; k < dirtyCount; ++k)
+            plane[k] = m_brightnessLut[plane[k]];
+    }
+}
+
+void AbstractLedDevice::commitDirtyColors(int dirtyCount) {
+    for (int k = 0; k < dirtyCount; ++k)
+        setModifiedColor(m_dirtyLeds[k], m_dirtyColors.red()[k], m_dirtyColors.green()[k], m_dirtyColors.blue()[k]);
+}
+
+template <bool isApplyBrightness>
+void AbstractLedDevice::modifyColorsWithColorLut(const QList<QRgb> &inColors) {
+    const int dirtyCount = updateLutColors<false>(inColors, m_expansionLuts.constData());
+    if (dirtyCount == 0)
+        return;
+
+    gatherDirtyColors(dirtyCount);
+    m_colorLut.apply(m_dirtyColors, m_dirtyColors);
+    if (isApplyBrightness)
+        applyBrightness(dirtyCount);
+    commitDirtyColors(dirtyCount);
+}
+
+template <bool isPerLedLuts, AbstractLedDevice::ThresholdMode thresholdMode, bool isApplyBrightness>
+void AbstractLedDevice::modifyColors(const QList<QRgb> &inColors) {
+    const int count = m_previousColors.count();
+    const quint16 *lutRed = m_lutColors.red();
+    const quint16 *lutGreen = m_lutColors.green();
+    const quint16 *lutBlue = m_lutColors.blue();
+    int dirtyCount = updateLutColors<isPerLedLuts>(inColors, m_channelLuts.constData());
+
+    StructLab avgColor;
+    if (thresholdMode == ThresholdMinimumLuminosity) {
+        // raised LEDs fade to the average color, all of them are modified again when it changes
+        // through the tables of the batch conversion, the one of a single color runs pow()
+        m_averageColor.resize(1);
+        m_averageColor.set(0, PrismatikMath::avgColor(m_lutColors));
+        PrismatikMath::toLab(m_averageColor, &avgColor);
+        if (avgColor.l != m_previousAvgColor.l || avgColor.a != m_previousAvgColor.a || avgColor.b != m_previousAvgColor.b) {
+            m_previousAvgColor = avgColor;
+            for (dirtyCount = 0; dirtyCount < count; ++dirtyCount)
+                m_dirtyLeds[dirtyCount] = dirtyCount;
         }
+    }
+
+    if (dirtyCount == 0)
+        return;
 
-        PrismatikMath::gammaCorrection(m_gamma, outColors[i]);
+    if (thresholdMode == ThresholdOff) {
+        for (int k = 0; k < dirtyCount; ++k) {
+            const int i = m_dirtyLeds[k];
+            setModifiedColor(i, lutRed[i], lutGreen[i], lutBlue[i]);
+        }
+        return;
     }
 
-    StructLab avgColor = PrismatikMath::toLab(PrismatikMath::avgColor(outColors));
+    gatherDirtyColors(dirtyCount);
+
+    // only LEDs not clearly brighter than the threshold need their lightness
+    m_dirtyLuminances.resize(dirtyCount);
+    PrismatikMath::toLuminance(m_dirtyColors, m_dirtyLuminances.data());
+    m_darkLeds.resize(dirtyCount);
+    int darkCount = 0;
+    for (int k = 0; k < dirtyCount; ++k) {
+        if (m_dirtyLuminances[k] < m_thresholdLuminance)
+            m_darkLeds[darkCount++] = k;
+    }
 
-    for (int i = 0; i < outColors.count(); ++i) {
-        StructLab lab = PrismatikMath::toLab(outColors[i]);
-        int dl = m_luminosityThreshold - lab.l;
-        if (dl > 0) {
-            if (m_isMinimumLuminosityEnabled) { // apply minimum luminosity or dead-zone
+    m_darkColors.resize(darkCount);
+    for (int d = 0; d < darkCount; ++d) {
+        const int k = m_darkLeds[d];
+        m_darkColors.red()[d] = m_dirtyColors.red()[k];
+        m_darkColors.green()[d] = m_dirtyColors.green()[k];
+        m_darkColors.blue()[d] = m_dirtyColors.blue()[k];
+    }
+    m_thresholdLabs.resize(darkCount);
+    PrismatikMath::toLab(m_darkColors, m_thresholdLabs.data());
+
+    if (thresholdMode == ThresholdDeadZone) {
+        for (int d = 0; d < darkCount; ++d) {
+            if (m_thresholdLabs[d].l < m_luminosityThreshold) {
+                const int k = m_darkLeds[d];
+                m_dirtyColors.red()[k] = 0;
+                m_dirtyColors.green()[k] = 0;
+                m_dirtyColors.blue()[k] = 0;
+            }
+        }
+    } else {
+        // LEDs raised to the threshold are packed to the front and converted back at once
+        m_raisedLeds.resize(darkCount);
+        int raisedCount = 0;
+        for (int d = 0; d < darkCount; ++d) {
+            StructLab lab = m_thresholdLabs[d];
+            int dl = m_luminosityThreshold - lab.l;
+            if (dl > 0) {
                 // Cross-fade a and b channels to avarage value within kFadingRange, fadingFactor = (dL - fadingRange)^2 / (fadingRange^2)
+                // in integers, as it always was, so it is 0 inside the range
                 const int kFadingRange = 5;
-                double fadingCoeff = dl < kFadingRange ? (dl - kFadingRange)*(dl - kFadingRange)/(kFadingRange*kFadingRange): 1;
+                const int fadingCoeff = dl < kFadingRange ? (dl - kFadingRange)*(dl - kFadingRange)/(kFadingRange*kFadingRange): 1;
                 char da = avgColor.a - lab.a;
                 char db = avgColor.b - lab.b;
                 lab.l = m_luminosityThreshold;
-                lab.a += PrismatikMath::round(da * fadingCoeff);
-                lab.b += PrismatikMath::round(db * fadingCoeff);
-                StructRgb rgb = PrismatikMath::toRgb(lab);
-                outColors[i] = rgb;
-            } else {
-                outColors[i].r = 0;
-                outColors[i].g = 0;
-                outColors[i].b = 0;
+                lab.a += da * fadingCoeff;
+                lab.b += db * fadingCoeff;
+                m_thresholdLabs[raisedCount] = lab;
+                m_raisedLeds[raisedCount++] = m_darkLeds[d];
             }
         }
 
-        PrismatikMath::brightnessCorrection(m_brightness, outColors[i]);
+        PrismatikMath::toRgb(m_thresholdLabs.constData(), raisedCount, m_raisedColors);
+        for (int r = 0; r < raisedCount; ++r) {
+            const int k = m_raisedLeds[r];
+            m_dirtyColors.red()[k] = m_raisedColors.red()[r];
+            m_dirtyColors.green()[k] = m_raisedColors.green()[r];
+            m_dirtyColors.blue()[k] = m_raisedColors.blue()[r];
+        }
+    }
+
+    if (isApplyBrightness)
+        applyBrightness(dirtyCount);
+    commitDirtyColors(dirtyCount);
+}
+
+void AbstractLedDevice::setModifiedColor(int index, quint16 red, quint16 green, quint16 blue) {
+    if (m_isColorsCacheValid
+            && m_modifiedColors.red()[index] == red
+            && m_modifiedColors.green()[index] == green
+            && m_modifiedColors.blue()[index] == blue)
+        return;
+    m_modifiedColors.red()[index] = red;
+    m_modifiedColors.green()[index] = green;
+    m_modifiedColors.blue()[index] = blue;
+    if (!m_changedLeds[index]) {
+        m_changedLeds[index] = true;
+        ++m_changedLedsCount;
+    }
+}
+
+bool AbstractLedDevice::updateColorLuts(bool isBrightnessFused) {
+    bool isChanged = false;
+    if (m_expansionLuts.isEmpty()) {
+        m_expansionLuts.resize(kLedLutsSize);
+        const double k = 4095/255.0;
+        for (int value = 0; value < kChannelLutSize; ++value) {
+            const quint16 extended = static_cast<unsigned>(value * k);
+            for (int c = 0; c < 3; ++c)
+                m_expansionLuts[c * kChannelLutSize + value] = extended;
+        }
+    }
+    // devices may assign m_gamma and m_brightness directly, so compare values
+    if (m_gammaLut.isEmpty() || m_lutGamma != m_gamma) {
+        m_gammaLut.resize(PrismatikMath::TransferLutSize);
+        PrismatikMath::fillGammaLut(m_gamma, m_gammaLut.data());
+        m_lutGamma = m_gamma;
+        m_isChannelLutsDirty = true;
+    }
+    if (m_brightnessLut.isEmpty() || m_lutBrightness != m_brightness) {
+        m_brightnessLut.resize(PrismatikMath::TransferLutSize);
+        PrismatikMath::fillBrightnessLut(m_brightness, m_brightnessLut.data());
+        m_lutBrightness = m_brightness;
+        m_isChannelLutsDirty = m_isChannelLutsDirty || isBrightnessFused;
+        isChanged = true;
+    }
+    if (m_isLutBrightnessFused != isBrightnessFused) {
+        m_isLutBrightnessFused = isBrightnessFused;
+        m_isChannelLutsDirty = true;
+    }
+    if (!m_isChannelLutsDirty)
+        return isChanged;
+
+    m_channelLuts.resize((m_wbAdjustments.count() + 1) * kLedLutsSize);
+    quint16 *lut = m_channelLuts.data();
+    for (int c = 0; c < 3; ++c)
+        fillChannelLut(lut + c * kChannelLutSize, 1.0, isBrightnessFused);
+    for (int i = 0; i < m_wbAdjustments.count(); ++i) {
+        lut += kLedLutsSize;
+        fillChannelLut(lut, m_wbAdjustments[i].red, isBrightnessFused);
+        fillChannelLut(lut + kChannelLutSize, m_wbAdjustments[i].green, isBrightnessFused);
+        fillChannelLut(lut + 2 * kChannelLutSize, m_wbAdjustments[i].blue, isBrightnessFused);
     }
+    m_isChannelLutsDirty = false;
+    return true;
+}
 
+void AbstractLedDevice::fillChannelLut(quint16 *lut, double wbCoef, bool isBrightnessFused) const {
+    // same rounding as the former per frame calculations
+    const double k = 4095/255.0;
+    for (int value = 0; value < kChannelLutSize; ++value) {
+        unsigned extended = value * k;
+        extended = qMin<unsigned>(extended * wbCoef, PrismatikMath::TransferLutSize - 1);
+        const quint16 corrected = m_gammaLut[extended];
+        lut[value] = isBrightnessFused ? m_brightnessLut[corrected] : corrected;
+    }
 }
@@ -28,6 +28,9 @@
 
 #include <QtGui>
 #include "colorspace_types.h"
+#include "RgbBuffer.hpp"
+#include "ColorLut3d.hpp"
+#include "TemporalInterpolator.hpp"
 #include "types.h"
 
 /*!
@@ -38,7 +41,7 @@ class AbstractLedDevice : public QObject
 {
     Q_OBJECT
 public:
-    AbstractLedDevice(QObject * parent) : QObject(parent) {}
+    AbstractLedDevice(QObject * parent);
     virtual ~AbstractLedDevice(){}
 
 signals:
@@ -74,6 +77,15 @@ public slots:
     virtual void setLuminosityThreshold(int value);
     virtual void setMinimumLuminosityThresholdEnabled(bool value);
     virtual void updateWBAdjustments(const QList<WBAdjustment> &coefs);
+    /*!
+      Loads a .cube 3D color table replacing white balance, gamma and the luminosity
+      threshold, an empty \a fileName or a broken file turns it off
+    */
+    virtual void setColorLutFile(const QString &fileName);
+    /*!
+      How devices without smoothing in firmware move between colors, see smoothColors()
+    */
+    virtual void setSmoothMode(TemporalInterpolator::Mode mode);
     virtual void requestFirmwareVersion() = 0;
     virtual void updateDeviceSettings();
 
@@ -87,7 +99,77 @@ public slots:
     virtual void setColorDepth(int value) = 0;
 
 protected:
-    virtual void applyColorModifications(const QList<QRgb> & inColors, QList<StructRgb> & outColors);
+    virtual void applyColorModifications(const QList<QRgb> & inColors, RgbBuffer & outColors);
+
+    /*!
+      Makes the next applyColorModifications() modify every LED and report all of them as
+      changed, e.g. after LEDs were switched off behind its back
+    */
+    void resetColorsCache();
+
+    /*!
+      Whether the last applyColorModifications() call gave LED \a index another color than the
+      call before, devices may skip sending unchanged LEDs
+    */
+    bool isLedColorChanged(int index) const { return m_changedLeds[index]; }
+    int changedLedsCount() const { return m_changedLedsCount; }
+
+    /*!
+      Host side smoothing for devices without it in firmware. Starts moving to \a colors and
+      replaces them with the colors to write now. Until they are reached writeSmoothedColors()
+      is called every smoothingFrameInterval() msec. Does nothing while smoothing is off.
+    */
+    void smoothColors(RgbBuffer &colors);
+    /*!
+      \param value smooth slowdown, milliseconds to move between colors, 0 turns smoothing off
+    */
+    void setHostSmoothSlowdown(int value);
+    // stops smoothing, the next colors are written as they are
+    void stopSmoothing();
+    virtual void writeSmoothedColors(RgbBuffer & /*colors*/) {}
+    // the shortest time the device needs for a frame
+    virtual int smoothingFrameInterval() const { return 16; }
+
+private slots:
+    void writeNextSmoothedFrame();
+
+private:
+    void updateSmoothing();
+
+    enum ThresholdMode {
+        ThresholdOff,
+        ThresholdDeadZone,
+        ThresholdMinimumLuminosity
+    };
+
+    typedef void (AbstractLedDevice::*ColorsKernel)(const QList<QRgb> &inColors);
+
+    static ColorsKernel colorsKernel(bool isColorLutEnabled, bool isPerLedLuts, ThresholdMode thresholdMode,
+                                     bool isApplyBrightness);
+
+    /*!
+      applyColorModifications() with the stages fixed at compile time, modifies LEDs with
+      changed input colors into m_modifiedColors
+    */
+    template <bool isPerLedLuts, ThresholdMode thresholdMode, bool isApplyBrightness>
+    void modifyColors(const QList<QRgb> &inColors);
+    template <bool isApplyBrightness>
+    void modifyColorsWithColorLut(const QList<QRgb> &inColors);
+
+    /*!
+      Looks up LEDs with changed input colors into m_lutColors and lists them in m_dirtyLeds
+      \return count of those LEDs
+    */
+    template <bool isPerLedLuts>
+    int updateLutColors(const QList<QRgb> &inColors, const quint16 *lut);
+    void gatherDirtyColors(int dirtyCount);
+    void applyBrightness(int dirtyCount);
+    void commitDirtyColors(int dirtyCount);
+    void setModifiedColor(int index, quint16 red, quint16 green, quint16 blue);
+
+    // returns true if any table changed
+    bool updateColorLuts(bool isBrightnessFused);
+    void fillChannelLut(quint16 *lut, double wbCoef, bool isBrightnessFused) const;
 
 protected:
     QString m_colorSequence;
@@ -99,5 +181,55 @@ protected:
     QList<WBAdjustment> m_wbAdjustments;
 
     QList<QRgb> m_colorsSaved;
-    QList<StructRgb> m_colorsBuffer;
+    RgbBuffer m_colorsBuffer;
+
+private:
+    // Lookup tables of applyColorModifications(), rebuilt when settings change
+    QVector<quint16> m_gammaLut;
+    QVector<quint16> m_brightnessLut;
+    // 8 bit to 12 bit tables per channel: without white balance first, then per LED
+    QVector<quint16> m_channelLuts;
+    // 8 bit to 12 bit tables per channel without any correction, input of m_colorLut
+    QVector<quint16> m_expansionLuts;
+    double m_lutGamma;
+    int m_lutBrightness;
+    bool m_isLutBrightnessFused;
+    bool m_isChannelLutsDirty;
+    ColorsKernel m_colorsKernel;
+    // stages m_colorsKernel was picked for
+    int m_colorsKernelKey;
+    QString m_colorLutFile;
+    ColorLut3d m_colorLut;
+    int m_cachedLuminosityThreshold;
+    // relative luminance LEDs at least as bright as are above the threshold, see toLuminance()
+    quint32 m_thresholdLuminance;
+
+    // per LED cache: input colors, colors after the tables and results of the previous call
+    bool m_isColorsCacheValid;
+    QVector<QRgb> m_previousColors;
+    RgbBuffer m_lutColors;
+    RgbBuffer m_modifiedColors;
+    RgbBuffer m_averageColor;
+    StructLab m_previousAvgColor;
+    QVector<bool> m_changedLeds;
+    int m_changedLedsCount;
+
+    // scratch buffers of LEDs modified again
+    QVector<int> m_dirtyLeds;
+    RgbBuffer m_dirtyColors;
+    QVector<quint32> m_dirtyLuminances;
+    // indexes into m_dirtyColors of LEDs which may be below the threshold
+    QVector<int> m_darkLeds;
+    RgbBuffer m_darkColors;
+    QVector<StructLab> m_thresholdLabs;
+    RgbBuffer m_raisedColors;
+    QVector<int> m_raisedLeds;
+
+    TemporalInterpolator::Mode m_smoothMode;
+    int m_hostSmoothSlowdown;
+    TemporalInterpolator m_interpolator;
+    QTimer *m_smoothingTimer;
+    // time since the last smoothed frame
+    QElapsedTimer m_smoothingClock;
+    RgbBuffer m_smoothedColors;
 };
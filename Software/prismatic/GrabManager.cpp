@@ -38,12 +38,21 @@
 #include "MacOSGrabber.hpp"
 #include "D3D9Grabber.hpp"
 #include "D3D10Grabber.hpp"
+#include "ReplayGrabber.hpp"
 #include "GrabManager.hpp"
 #include "common/DebugOut.hpp"
 #include "ui/GrabWidget.hpp"
 
 using namespace SettingsScope;
 
+namespace {
+// Grabbers live in the grab thread, their slots run in its event loop
+inline void invokeGrabber(GrabberBase *grabber, const char *slot)
+{
+    QMetaObject::invokeMethod(grabber, slot, Qt::QueuedConnection);
+}
+}
+
 #ifdef D3D10_GRAB_SUPPORT
 
 #include "LightpackApplication.hpp"
@@ -61,7 +70,11 @@ GrabManager::GrabManager(const SettingsScope::SettingsReader *settings,
     , m_timerUpdateFPS(this)
     , m_widgetsController(parent)
     , m_fpsMs(0)
+    , m_grabIntervalMs(0)
     , m_isGrabWidgetsVisible(false)
+    , m_isGrabbingStarted(false)
+    , m_grabberContext(MaximumNumberOfLeds::AbsoluteMaximum)
+    , m_grabThread(CURRENT_LOCATION)
     , m_settings(settings) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
 
@@ -98,36 +111,37 @@ GrabManager::~GrabManager() {
     m_grabber = NULL;
 
     for (int i = 0; i < m_grabbers.size(); i++) {
-        if (m_grabbers[i]) {
-            DEBUG_OUT << "deleting " << m_grabbers[i]->name();
-            delete m_grabbers[i];
-            m_grabbers[i] = NULL;
-        }
+        if (m_grabbers[i])
+            invokeGrabber(m_grabbers[i], "stopGrabbing");
     }
-
-    m_grabbers.clear();
-
 #ifdef D3D10_GRAB_SUPPORT
-    delete m_d3d10Grabber;
+    invokeGrabber(m_d3d10Grabber, "stopGrabbing");
     m_d3d10Grabber = NULL;
 #endif
+    m_grabbers.clear();
+
+    // grabbers are children of the thread object and get deleted with it
+    // in the grab thread
+    const bool joined = m_grabThread.join(1000);
+    Q_ASSERT(joined);
+    Q_UNUSED(joined);
 }
 
 void GrabManager::start(bool isGrabEnabled) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << isGrabEnabled;
 
-    clearColorsNew();
-
     if (!m_grabber)
         return;
 
+    m_isGrabbingStarted = isGrabEnabled;
     if (isGrabEnabled) {
+        m_grabberContext.updateGrabbedAreas(m_widgetsController.grabbedAreas());
         m_timerUpdateFPS.start();
-        m_grabber->startGrabbing();
+        invokeGrabber(m_grabber, "startGrabbing");
     } else {
         clearColorsCurrent();
         m_timerUpdateFPS.stop();
-        m_grabber->stopGrabbing();
+        invokeGrabber(m_grabber, "stopGrabbing");
         emit ambilightTimeOfUpdatingColors(0);
     }
 }
@@ -135,25 +149,21 @@ void GrabManager::start(bool isGrabEnabled) {
 void GrabManager::onGrabberTypeChanged(const Grab::GrabberType grabberType) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << grabberType;
 
-    bool isStartNeeded = false;
-    if (m_grabber != NULL) {
-        isStartNeeded = m_grabber->isGrabbingStarted();
-#ifdef D3D10_GRAB_SUPPORT
-        isStartNeeded = isStartNeeded || (m_d3d10Grabber != NULL && m_d3d10Grabber->isGrabbingStarted());
-#endif
-        m_grabber->stopGrabbing();
-    }
+    // grabbers can't be asked synchronously, GrabManager tracks the state itself
+    const bool isStartNeeded = m_grabber != NULL && m_isGrabbingStarted;
+    if (m_grabber != NULL)
+        invokeGrabber(m_grabber, "stopGrabbing");
 
     m_grabber = queryGrabber(grabberType);
 
     if (isStartNeeded) {
 #ifdef D3D10_GRAB_SUPPORT
         if (m_settings->isDx1011GrabberEnabled())
-            m_d3d10Grabber->startGrabbing();
+            invokeGrabber(m_d3d10Grabber, "startGrabbing");
         else
-            m_grabber->startGrabbing();
+            invokeGrabber(m_grabber, "startGrabbing");
 #else
-        m_grabber->startGrabbing();
+        invokeGrabber(m_grabber, "startGrabbing");
 #endif
     }
 }
@@ -164,12 +174,12 @@ void GrabManager::onGrabberStateChangeRequested(bool isStartRequested) {
     if (grabber != m_grabber) {
         if (isStartRequested) {
             if (m_settings->isDx1011GrabberEnabled()) {
-                m_grabber->stopGrabbing();
-                grabber->startGrabbing();
+                invokeGrabber(m_grabber, "stopGrabbing");
+                invokeGrabber(grabber, "startGrabbing");
             }
         } else {
-            m_grabber->startGrabbing();
-            grabber->stopGrabbing();
+            invokeGrabber(m_grabber, "startGrabbing");
+            invokeGrabber(grabber, "stopGrabbing");
         }
     } else {
         qCritical() << Q_FUNC_INFO << " there is no grabber to take control by some reason";
@@ -182,7 +192,7 @@ void GrabManager::onGrabberStateChangeRequested(bool isStartRequested) {
 void GrabManager::onGrabSlowdownChanged(int ms) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << ms;
     if (m_grabber)
-        m_grabber->setGrabInterval(ms);
+        QMetaObject::invokeMethod(m_grabber, "setGrabInterval", Qt::QueuedConnection, Q_ARG(int, ms));
     else
         qWarning() << Q_FUNC_INFO << "trying to change grab slowdown while there is no grabber";
 }
@@ -192,6 +202,72 @@ void GrabManager::onGrabAvgColorsEnabledChanged(bool state) {
     m_avgColorsOnAllLeds = state;
 }
 
+void GrabManager::onGrabReductionModeChanged(const Grab::ReductionMode mode) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << mode;
+    for (int i = 0; i < m_grabbers.size(); ++i) {
+        if (m_grabbers[i])
+            QMetaObject::invokeMethod(m_grabbers[i], "setReductionMode", Qt::QueuedConnection, Q_ARG(Grab::ReductionMode, mode));
+    }
+#ifdef D3D10_GRAB_SUPPORT
+    if (m_d3d10Grabber)
+        QMetaObject::invokeMethod(m_d3d10Grabber, "setReductionMode", Qt::QueuedConnection, Q_ARG(Grab::ReductionMode, mode));
+#endif
+}
+
+void GrabManager::onGrabIdleSlowdownChanged(int ms) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << ms;
+    for (int i = 0; i < m_grabbers.size(); ++i) {
+        if (m_grabbers[i])
+            QMetaObject::invokeMethod(m_grabbers[i], "setIdleGrabInterval", Qt::QueuedConnection, Q_ARG(int, ms));
+    }
+#ifdef D3D10_GRAB_SUPPORT
+    if (m_d3d10Grabber)
+        QMetaObject::invokeMethod(m_d3d10Grabber, "setIdleGrabInterval", Qt::QueuedConnection, Q_ARG(int, ms));
+#endif
+}
+
+void GrabManager::onGrabSampleBudgetChanged(int samplesPerArea) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << samplesPerArea;
+    for (int i = 0; i < m_grabbers.size(); ++i) {
+        if (m_grabbers[i])
+            QMetaObject::invokeMethod(m_grabbers[i], "setSampleBudget", Qt::QueuedConnection, Q_ARG(int, samplesPerArea));
+    }
+#ifdef D3D10_GRAB_SUPPORT
+    if (m_d3d10Grabber)
+        QMetaObject::invokeMethod(m_d3d10Grabber, "setSampleBudget", Qt::QueuedConnection, Q_ARG(int, samplesPerArea));
+#endif
+}
+
+void GrabManager::onGrabReductionThreadsChanged(int threadsCount) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << threadsCount;
+    for (int i = 0; i < m_grabbers.size(); ++i) {
+        if (m_grabbers[i])
+            QMetaObject::invokeMethod(m_grabbers[i], "setReductionThreads", Qt::QueuedConnection, Q_ARG(int, threadsCount));
+    }
+#ifdef D3D10_GRAB_SUPPORT
+    if (m_d3d10Grabber)
+        QMetaObject::invokeMethod(m_d3d10Grabber, "setReductionThreads", Qt::QueuedConnection, Q_ARG(int, threadsCount));
+#endif
+}
+
+void GrabManager::onGrabReplayFileChanged(const QString &fileName) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << fileName;
+#ifdef REPLAY_GRAB_SUPPORT
+    QMetaObject::invokeMethod(m_grabbers[Grab::GrabberTypeReplay], "setReplayFile", Qt::QueuedConnection, Q_ARG(QString, fileName));
+#else
+    Q_UNUSED(fileName);
+#endif
+}
+
+void GrabManager::onGrabReplayFrameRateChanged(int fps) {
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << fps;
+#ifdef REPLAY_GRAB_SUPPORT
+    QMetaObject::invokeMethod(m_grabbers[Grab::GrabberTypeReplay], "setReplayFrameRate", Qt::QueuedConnection, Q_ARG(int, fps));
+#else
+    Q_UNUSED(fps);
+#endif
+}
+
 void GrabManager::onSendDataOnlyIfColorsEnabledChanged(bool state) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << state;
     m_isSendDataOnlyIfColorsChanged = state;
@@ -254,27 +330,35 @@ void GrabManager::handleGrabbedColors() {
         return;
     }    
 
+    // Several queued notifications may come for one frame, the first one takes it
+    Grab::ColorsTripleBuffer &grabbedColors = m_grabberContext.grabbedColors;
+    if (!grabbedColors.fetch())
+        return;
+
     bool isColorsChanged = false;
     int avgR = 0, avgG = 0, avgB = 0;
     int countGrabEnabled = 0;
 
+    // read in place, the list going out with updateLedsColors() is the only copy
+    const QRgb *colors = grabbedColors.readBuffer();
     const int colorsListSize = m_widgetsController.widgetsCount();
-    if (m_colorsNew.size() != colorsListSize) {
-        m_colorsNew.clear();
-        for (int i = 0; i < colorsListSize; i++) {
-            m_colorsNew << 0;
-        }
-    }
+    const int colorsCount = qMin(grabbedColors.readCount(), colorsListSize);
 
+    QRgb avgColor = 0;
     if (m_avgColorsOnAllLeds) {
-        for (int i = 0; i < colorsListSize; i++) {
+        for (int i = 0; i < colorsCount; i++) {
             if (m_widgetsController.widget(i).isAreaEnabled()) {
-                    avgR += qRed(m_colorsNew[i]);
-                    avgG += qGreen(m_colorsNew[i]);
-                    avgB += qBlue(m_colorsNew[i]);
+                    avgR += qRed(colors[i]);
+                    avgG += qGreen(colors[i]);
+                    avgB += qBlue(colors[i]);
                     countGrabEnabled++;
             }
         }
+        // LEDs the frame has no color for count as black
+        for (int i = colorsCount; i < colorsListSize; i++) {
+            if (m_widgetsController.widget(i).isAreaEnabled())
+                countGrabEnabled++;
+        }
 
         if (countGrabEnabled != 0) {
             avgR /= countGrabEnabled;
@@ -283,12 +367,7 @@ void GrabManager::handleGrabbedColors() {
         }
 
         // Set one AVG color to all LEDs
-        const QRgb avgColor = qRgb(avgR, avgG, avgB);
-        for (int ledIndex = 0; ledIndex < colorsListSize; ++ledIndex) {
-            if (m_widgetsController.widget(ledIndex).isAreaEnabled()) {
-                m_colorsNew[ledIndex] = avgColor;
-            }
-        }
+        avgColor = qRgb(avgR, avgG, avgB);
     }
 
 //    // White balance
@@ -309,9 +388,12 @@ void GrabManager::handleGrabbedColors() {
 
     for (int i = 0; i < colorsListSize; i++)
     {
-        if (m_colorsCurrent[i] != m_colorsNew[i])
+        QRgb color = i < colorsCount ? colors[i] : 0;
+        if (m_avgColorsOnAllLeds && m_widgetsController.widget(i).isAreaEnabled())
+            color = avgColor;
+        if (m_colorsCurrent[i] != color)
         {
-            m_colorsCurrent[i] = m_colorsNew[i];
+            m_colorsCurrent[i] = color;
             isColorsChanged = true;
         }
     }
@@ -329,7 +411,8 @@ void GrabManager::handleGrabbedColors() {
 void GrabManager::timeoutUpdateFPS()
 {
     DEBUG_MID_LEVEL << Q_FUNC_INFO;
-    emit ambilightTimeOfUpdatingColors(m_fpsMs);
+    // frames skipped on static content aren't handled, report the pacing then
+    emit ambilightTimeOfUpdatingColors(qMax(m_fpsMs, static_cast<double>(m_grabIntervalMs)));
 }
 
 void GrabManager::updateScreenGeometry()
@@ -371,47 +454,64 @@ void GrabManager::initGrabbers()
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
 
-    // We need an address of the QList to write into.
-    m_grabberContext.grabWidgets = &m_widgetsController.grabbedAreas();
-    m_grabberContext.grabResult = &m_colorsNew;
+    m_grabberContext.updateGrabbedAreas(m_widgetsController.grabbedAreas());
+
+    // All grabbers share one thread, so only one of them grabs at a time.
+    // They are children of grabbersOwner and move to the thread with it.
+    QObject *grabbersOwner = new QObject();
 
     for (int i = 0; i < Grab::GrabbersCount; i++)
         m_grabbers.append(NULL);
 
 #ifdef WINAPI_GRAB_SUPPORT
-    m_grabbers[Grab::GrabberTypeWinAPI] = initGrabber(new WinAPIGrabber(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeWinAPI] = initGrabber(new WinAPIGrabber(grabbersOwner, &m_grabberContext));
 #endif
 
 #ifdef D3D9_GRAB_SUPPORT
-    m_grabbers[Grab::GrabberTypeD3D9] = initGrabber(new D3D9Grabber(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeD3D9] = initGrabber(new D3D9Grabber(grabbersOwner, &m_grabberContext));
 #endif
 
 #ifdef X11_GRAB_SUPPORT
-    m_grabbers[Grab::GrabberTypeX11] = initGrabber(new X11Grabber(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeX11] = initGrabber(new X11Grabber(grabbersOwner, &m_grabberContext));
 #endif
 
 #ifdef MAC_OS_CG_GRAB_SUPPORT
-    m_grabbers[Grab::GrabberTypeMacCoreGraphics] = initGrabber(new MacOSGrabber(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeMacCoreGraphics] = initGrabber(new MacOSGrabber(grabbersOwner, &m_grabberContext));
+#endif
+
+#ifdef REPLAY_GRAB_SUPPORT
+    m_grabbers[Grab::GrabberTypeReplay] = initGrabber(new ReplayGrabber(grabbersOwner, &m_grabberContext));
 #endif
 #ifdef QT_GRAB_SUPPORT
     //TODO: migrate Qt grabbers to the new hierarchy
-    m_grabbers[Grab::GrabberTypeQtEachWidget] = initGrabber(new QtGrabberEachWidget(NULL, &m_grabberContext));
-    m_grabbers[Grab::GrabberTypeQt] = initGrabber(new QtGrabber(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeQtEachWidget] = initGrabber(new QtGrabberEachWidget(grabbersOwner, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeQt] = initGrabber(new QtGrabber(grabbersOwner, &m_grabberContext));
 #endif
 #ifdef WINAPI_EACH_GRAB_SUPPORT
-    m_grabbers[Grab::GrabberTypeWinAPIEachWidget] = initGrabber(new WinAPIGrabberEachWidget(NULL, &m_grabberContext));
+    m_grabbers[Grab::GrabberTypeWinAPIEachWidget] = initGrabber(new WinAPIGrabberEachWidget(grabbersOwner, &m_grabberContext));
 #endif
 #ifdef D3D10_GRAB_SUPPORT
-    m_d3d10Grabber = static_cast<D3D10Grabber *>(initGrabber(new D3D10Grabber(NULL, &m_grabberContext, &GetMainWindowHandle)));
+    // D3D10Grabber::init() runs in the grab thread and can't ask QDesktopWidget itself
+    QDesktopWidget *desktop = QApplication::desktop();
+    ScreenInfo primaryScreen;
+    primaryScreen.handle = reinterpret_cast<void *>(desktop->primaryScreen());
+    primaryScreen.rect = desktop->screenGeometry(desktop->primaryScreen());
+    m_grabberContext.setPrimaryScreen(primaryScreen);
+
+    m_d3d10Grabber = static_cast<D3D10Grabber *>(initGrabber(new D3D10Grabber(grabbersOwner, &m_grabberContext, &GetMainWindowHandle)));
     connect(m_d3d10Grabber, SIGNAL(grabberStateChangeRequested(bool)), SLOT(onGrabberStateChangeRequested(bool)));
     connect(getLightpackApp(), SIGNAL(postInitialization()), m_d3d10Grabber,  SLOT(init()));
 #endif
+
+    m_grabThread.init(grabbersOwner);
 }
 
 GrabberBase *GrabManager::initGrabber(GrabberBase * grabber) {
     QMetaObject::invokeMethod(grabber, "setGrabInterval", Qt::QueuedConnection, Q_ARG(int, m_settings->getGrabSlowdown()));
     bool isConnected = connect(grabber, SIGNAL(frameGrabAttempted(GrabResult)), this, SLOT(onFrameGrabAttempted(GrabResult)), Qt::QueuedConnection);
     Q_ASSERT_X(isConnected, "connecting grabber to grabManager", "failed");
+    isConnected = connect(grabber, SIGNAL(grabIntervalChanged(int)), this, SLOT(onGrabIntervalChanged(int)), Qt::QueuedConnection);
+    Q_ASSERT_X(isConnected, "connecting grabber to grabManager", "failed");
     Q_UNUSED(isConnected);
 
     return grabber;
@@ -428,34 +528,41 @@ GrabberBase *GrabManager::queryGrabber(Grab::GrabberType grabberType) {
         result = m_grabbers[Grab::GrabberTypeQt];
     }
 
-    result->setGrabInterval(m_settings->getGrabSlowdown());
+    QMetaObject::invokeMethod(result, "setGrabInterval", Qt::QueuedConnection, Q_ARG(int, m_settings->getGrabSlowdown()));
 
     return result;
 }
 
 void GrabManager::onFrameGrabAttempted(GrabResult grabResult) {
+    // picked up by the next grab, unchanged areas cost a comparison only
+    m_grabberContext.updateGrabbedAreas(m_widgetsController.grabbedAreas());
+
     if (grabResult == GrabResultOk) {
         handleGrabbedColors();
     }
 }
 
+void GrabManager::onGrabIntervalChanged(int ms) {
+    DEBUG_MID_LEVEL << Q_FUNC_INFO << ms;
+    // inactive grabbers report their settings too
+    const QObject *grabber = sender();
+#ifdef D3D10_GRAB_SUPPORT
+    if (grabber != m_grabber && grabber != m_d3d10Grabber)
+        return;
+#else
+    if (grabber != m_grabber)
+        return;
+#endif
+    m_grabIntervalMs = ms;
+}
+
 void GrabManager::initColorLists(int numberOfLeds) {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << numberOfLeds;
 
     m_colorsCurrent.clear();
-    m_colorsNew.clear();
 
     for (int i = 0; i < numberOfLeds; i++) {
         m_colorsCurrent << 0;
-        m_colorsNew     << 0;
-    }
-}
-
-void GrabManager::clearColorsNew() {
-    DEBUG_MID_LEVEL << Q_FUNC_INFO;
-
-    for (int i = 0; i < m_colorsNew.size(); i++) {
-        m_colorsNew[i] = 0;
     }
 }
 
@@ -470,6 +577,12 @@ void GrabManager::clearColorsCurrent() {
 void GrabManager::initFromProfileSettings() {
     m_isSendDataOnlyIfColorsChanged = m_settings->isSendDataOnlyIfColorsChanges();
     m_avgColorsOnAllLeds = m_settings->isGrabAvgColorsEnabled();
+    onGrabIdleSlowdownChanged(m_settings->getGrabIdleSlowdown());
+    onGrabReductionModeChanged(m_settings->getGrabReductionMode());
+    onGrabSampleBudgetChanged(m_settings->getGrabSampleBudget());
+    onGrabReductionThreadsChanged(m_settings->getGrabReductionThreads());
+    onGrabReplayFrameRateChanged(m_settings->getGrabReplayFrameRate());
+    onGrabReplayFileChanged(m_settings->getGrabReplayFile());
 
     setNumberOfLeds(m_settings->getNumberOfConnectedDeviceLeds());
 }
@@ -30,6 +30,7 @@
 
 #include "GrabberContext.hpp"
 #include "TimeEvaluations.hpp"
+#include "third_party/qtutils/include/ThreadedObject.hpp"
 #include "LedWidgetsController.hpp"
 #include "enums.hpp"
 
@@ -63,7 +64,13 @@ public:
 public slots:
     void onGrabberTypeChanged(const Grab::GrabberType grabberType);
     void onGrabSlowdownChanged(int ms);
+    void onGrabIdleSlowdownChanged(int ms);
     void onGrabAvgColorsEnabledChanged(bool state);
+    void onGrabReductionModeChanged(const Grab::ReductionMode mode);
+    void onGrabSampleBudgetChanged(int samplesPerArea);
+    void onGrabReductionThreadsChanged(int threadsCount);
+    void onGrabReplayFileChanged(const QString &fileName);
+    void onGrabReplayFrameRateChanged(int fps);
     void onSendDataOnlyIfColorsEnabledChanged(bool state);
     void start(bool isGrabEnabled);
     void settingsProfileChanged(const QString &profileName);
@@ -77,6 +84,7 @@ private slots:
     void timeoutUpdateFPS();
     void scaleLedWidgets(int screenIndexResized);
     void onFrameGrabAttempted(GrabResult result);
+    void onGrabIntervalChanged(int ms);
     void updateScreenGeometry();
     void onScreenCountChanged(int);
 
@@ -85,7 +93,6 @@ private:
     void initGrabbers();
     GrabberBase *initGrabber(GrabberBase *grabber);
     void initColorLists(int numberOfLeds);
-    void clearColorsNew();
     void clearColorsCurrent();
     void initLedWidgets(int numberOfLeds);
 
@@ -103,19 +110,21 @@ private:
     QTimer m_timerGrab;
     QTimer m_timerUpdateFPS;
     LedWidgetsController m_widgetsController;
-    QList<QRgb> m_grabResult;
     TimeEvaluations m_timeEval;
 
     QList<QRgb> m_colorsCurrent;
-    QList<QRgb> m_colorsNew;
 
     bool m_isSendDataOnlyIfColorsChanged;
     bool m_avgColorsOnAllLeds;
 
     // Store last grabbing time in milliseconds
     double m_fpsMs;
+    // Period the active grabber is paced with
+    int m_grabIntervalMs;
 
     bool m_isGrabWidgetsVisible;
+    bool m_isGrabbingStarted;
     GrabberContext m_grabberContext;
+    QtUtils::ThreadedObject<QObject> m_grabThread;
     const SettingsScope::SettingsReader * const m_settings;
 };
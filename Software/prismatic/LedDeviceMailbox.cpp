@@ -0,0 +1,143 @@
+/*
+ * LedDeviceMailbox.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LedDeviceMailbox.hpp"
+#include "AbstractLedDevice.hpp"
+#include "common/DebugOut.hpp"
+
+LedDeviceMailbox::DeviceSettings::DeviceSettings()
+    : refreshDelay(0)
+    , colorDepth(0)
+    , smoothSlowdown(0)
+    , gamma(0)
+    , brightness(0)
+    , luminosityThreshold(0)
+    , isMinimumLuminosityEnabled(false)
+{
+}
+
+LedDeviceMailbox::LedDeviceMailbox(AbstractLedDevice *device)
+    : QObject(device)
+    , m_device(device)
+    , m_colors(MaximumNumberOfLeds::AbsoluteMaximum)
+    , m_pendingCommands(0)
+    , m_isProcessScheduled(0)
+    , m_settingsMiddle(1)
+    , m_settingsWriteSlot(0)
+    , m_settingsReadSlot(2)
+{
+    Q_ASSERT(device);
+}
+
+void LedDeviceMailbox::postColors(const QList<QRgb> &colors)
+{
+    const int colorsCount = qMin(colors.size(), m_colors.capacity());
+    QRgb *buffer = m_colors.writeBuffer();
+    for (int i = 0; i < colorsCount; i++)
+        buffer[i] = colors[i];
+    m_colors.publish(colorsCount);
+
+    if (m_isProcessScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+}
+
+void LedDeviceMailbox::postOffLeds()
+{
+    // Drops the frame not written yet, switching off wins over older colors
+    m_colors.publish(0);
+    postCommand(LedDeviceCommands::OffLeds);
+}
+
+void LedDeviceMailbox::postCommand(LedDeviceCommands::Cmd cmd)
+{
+    m_pendingCommands.fetchAndOrOrdered(1 << cmd);
+
+    if (m_isProcessScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+}
+
+bool LedDeviceMailbox::fetchSettings()
+{
+    if (!(m_settingsMiddle.loadAcquire() & freshFlag))
+        return false;
+
+    const int previous = m_settingsMiddle.fetchAndStoreOrdered(m_settingsReadSlot);
+    m_settingsReadSlot = previous & slotMask;
+    return true;
+}
+
+void LedDeviceMailbox::process()
+{
+    using namespace LedDeviceCommands;
+
+    // Anything posted from now on schedules one more call
+    m_isProcessScheduled.storeRelease(0);
+
+    const int commands = m_pendingCommands.fetchAndStoreOrdered(0);
+    // Settings are published before their command bits, the read slot is never older
+    fetchSettings();
+    const DeviceSettings &settings = m_settings[m_settingsReadSlot];
+
+    DEBUG_MID_LEVEL << Q_FUNC_INFO << "commands:" << hex << commands;
+
+    // Whole settings reload goes first so the single values posted with it stay applied
+    if (commands & ((1 << UpdateDeviceSettings) | (1 << UpdateWBAdjustments)))
+        m_device->updateDeviceSettings();
+    if (commands & (1 << SetRefreshDelay))
+        m_device->setRefreshDelay(settings.refreshDelay);
+    if (commands & (1 << SetColorDepth))
+        m_device->setColorDepth(settings.colorDepth);
+    if (commands & (1 << SetSmoothSlowdown))
+        m_device->setSmoothSlowdown(settings.smoothSlowdown);
+    if (commands & (1 << SetGamma))
+        m_device->setGamma(settings.gamma);
+    if (commands & (1 << SetBrightness))
+        m_device->setBrightness(settings.brightness);
+    if (commands & (1 << SetLuminosityThreshold))
+        m_device->setLuminosityThreshold(settings.luminosityThreshold);
+    if (commands & (1 << SetMinimumLuminosityEnabled))
+        m_device->setMinimumLuminosityThresholdEnabled(settings.isMinimumLuminosityEnabled);
+    if (commands & (1 << SetColorSequence))
+        m_device->setColorSequence(settings.colorSequence);
+    if (commands & (1 << RequestFirmwareVersion))
+        m_device->requestFirmwareVersion();
+    if (commands & (1 << OffLeds))
+        m_device->switchOffLeds();
+
+    // An empty frame is what postOffLeds() left, nothing to write then
+    if (!m_colors.fetch() || m_colors.readCount() == 0)
+        return;
+
+    const QRgb *colors = m_colors.readBuffer();
+    const int colorsCount = m_colors.readCount();
+    if (m_colorsList.size() != colorsCount) {
+        m_colorsList.clear();
+        m_colorsList.reserve(colorsCount);
+        for (int i = 0; i < colorsCount; i++)
+            m_colorsList.append(colors[i]);
+    } else {
+        for (int i = 0; i < colorsCount; i++)
+            m_colorsList[i] = colors[i];
+    }
+    m_device->setColors(m_colorsList);
+}
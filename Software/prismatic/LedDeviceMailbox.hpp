@@ -0,0 +1,106 @@
+/*
+ * LedDeviceMailbox.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QList>
+#include <QRgb>
+#include <QString>
+
+#include "ColorsTripleBuffer.hpp"
+#include "enums.hpp"
+
+class AbstractLedDevice;
+
+/*!
+  Hands commands from \a LedDeviceManager to the device thread without locks
+  and without queueing them up. Only the newest colors frame and the latest
+  value of every setting are kept, a command posted again before the device
+  took it replaces the previous one. The device thread is woken up by a single
+  queued call however many commands were posted meanwhile.
+  One posting thread and the device thread.
+*/
+class LedDeviceMailbox : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct DeviceSettings {
+        DeviceSettings();
+
+        int refreshDelay;
+        int colorDepth;
+        int smoothSlowdown;
+        double gamma;
+        int brightness;
+        int luminosityThreshold;
+        bool isMinimumLuminosityEnabled;
+        QString colorSequence;
+    };
+
+    /*!
+      \param device receives the commands, the mailbox becomes its child and
+      follows it to the device thread
+    */
+    explicit LedDeviceMailbox(AbstractLedDevice *device);
+
+    // Posting side
+    void postColors(const QList<QRgb> &colors);
+    void postOffLeds();
+    void postCommand(LedDeviceCommands::Cmd cmd);
+
+    template <typename T>
+    void postSetting(LedDeviceCommands::Cmd cmd, T DeviceSettings::*member, const T &value) {
+        m_postedSettings.*member = value;
+        m_settings[m_settingsWriteSlot] = m_postedSettings;
+        // release: the settings slot is visible to the device thread taking it
+        const int previous = m_settingsMiddle.fetchAndStoreOrdered(m_settingsWriteSlot | freshFlag);
+        m_settingsWriteSlot = previous & slotMask;
+        postCommand(cmd);
+    }
+
+private slots:
+    void process();
+
+private:
+    bool fetchSettings();
+
+    static const int freshFlag = 4;
+    static const int slotMask = 3;
+
+    AbstractLedDevice * const m_device;
+    Grab::ColorsTripleBuffer m_colors;
+    QList<QRgb> m_colorsList;
+
+    // bit (1 << LedDeviceCommands::Cmd) for every command not taken yet
+    QAtomicInt m_pendingCommands;
+    QAtomicInt m_isProcessScheduled;
+
+    DeviceSettings m_postedSettings;
+    DeviceSettings m_settings[3];
+    QAtomicInt m_settingsMiddle;
+    int m_settingsWriteSlot;
+    int m_settingsReadSlot;
+};
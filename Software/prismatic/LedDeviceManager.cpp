@@ -25,9 +25,9 @@
  */
 
 #include <qglobal.h>
-#include <type_traits>
 
 #include "LedDeviceManager.hpp"
+#include "LedDeviceMailbox.hpp"
 #include "devices/LedDeviceLightpack.hpp"
 
 #ifdef Q_OS_WIN
@@ -42,196 +42,19 @@
 
 using namespace SettingsScope;
 
-namespace {
-struct CommandContext {
-    QList<QRgb> savedColors;
-    bool isColorsSaved;
-    int savedRefreshDelay;
-    int savedColorDepth;
-    int savedSmoothSlowdown;
-    double savedGamma;
-    int savedBrightness;
-    int savedLuminosityThreshold;
-    bool savedIsMinimumLuminosityEnabled;
-    QString savedColorSequence;
-};
-
-template <void (LedDeviceManager::*signal)()>
-struct VoidCommandRunner {
-    static void runDeferred(LedDeviceManager& manager, const CommandContext&) {
-        emit (manager.*signal)();
-    }
-
-    static void runImmediate(LedDeviceManager& manager) {
-        emit (manager.*signal)();
-    }
-
-    static void saveContext(CommandContext&) {}
-};
-
-template <void (LedDeviceManager::*signal)()>
-struct VoidCommandRunnerNoEmit {
-    static void runDeferred(LedDeviceManager& manager, const CommandContext&) {
-        (manager.*signal)();
-    }
-
-    static void runImmediate(LedDeviceManager& manager) {
-        (manager.*signal)();
-    }
-
-    static void saveContext(CommandContext&) {}
-};
-
-template <typename T>
-struct ParamBaseType {
-    typedef typename std::remove_const<
-        typename std::remove_reference<T>::type
-    >::type Type;
-};
-
-template <typename TParam,
-          void (LedDeviceManager::*signal)(TParam),
-          typename ParamBaseType<TParam>::Type CommandContext::* contextMember>
-struct BaseCommandRunner {
-    typedef TParam ParamType;
-
-    static void runImmediate(LedDeviceManager& manager, TParam value) {
-        emit (manager.*signal)(value);
-    }
-
-    static void runDeferred(LedDeviceManager& manager, const CommandContext& context) {
-        emit (manager.*signal)(context.*contextMember);
-    }
-
-    static void saveContext(CommandContext& context, TParam value) {
-        context.*contextMember = value;
-    }
-};
-
-// Base class for custom command SetColors.
-typedef BaseCommandRunner<
-    const QList<QRgb>&,
-    &LedDeviceManager::ledDeviceSetColors,
-    &CommandContext::savedColors>
-SetColorsCommandBase;
-
-// Implementation for custom command SetColors.
-struct SetColorsCommandRunner : private SetColorsCommandBase {
-    typedef SetColorsCommandBase::ParamType ParamType;
-
-    static void runImmediate(LedDeviceManager& manager, const QList<QRgb>& value) {
-        SetColorsCommandBase::runImmediate(manager, value);
-    }
-
-    static void runDeferred(LedDeviceManager& manager, const CommandContext& context) {
-        Q_ASSERT(context.isColorsSaved);
-        SetColorsCommandBase::runDeferred(manager, context);
-    }
-
-    static void saveColors(CommandContext& context, const ParamType& colors) {
-        SetColorsCommandBase::saveContext(context, colors);
-    }
-
-    // No real work.
-    static void saveContext(CommandContext&, const ParamType&) {
-    }
-};
-}
-
-class LedDeviceManager::CommandDispatcher {
-public:
-    typedef void (*CommandRunner)(LedDeviceManager&, const CommandContext&);
-
-    CommandDispatcher(LedDeviceManager& owner)
-            : m_isLastCommandCompleted(true)
-            , m_owner(owner) {
-        m_cmdTimeoutTimer.setInterval(100);
-        connect(&m_cmdTimeoutTimer, &QTimer::timeout,
-                &owner, &LedDeviceManager::ledDeviceCommandTimedOut);
-        m_context.isColorsSaved = false;
-    }
-
-    template <typename Command, typename ...ValueTypes>
-    void postCommand(ValueTypes... values) {
-        DEBUG_MID_LEVEL << Q_FUNC_INFO
-                        << "Is last command completed:" << m_isLastCommandCompleted;
-
-        if (m_isLastCommandCompleted) {
-            m_cmdTimeoutTimer.start();
-            m_isLastCommandCompleted = false;
-            Command::runImmediate(m_owner, values...);
-        } else {
-            Command::saveContext(m_context, values...);
-            appendCommand(&Command::runDeferred);
-        }
-    }
-
-    void appendCommand(CommandRunner cmdRunner) {
-        DEBUG_MID_LEVEL << Q_FUNC_INFO << cmdRunner;
-        Q_ASSERT(cmdRunner);
-
-        if (!m_cmdQueue.contains(cmdRunner))
-            m_cmdQueue.append(cmdRunner);
-    }
-
-    void commandCompleted(bool ok) {
-        DEBUG_MID_LEVEL << Q_FUNC_INFO << ok;
-
-        m_cmdTimeoutTimer.stop();
-
-        if (ok) {
-            m_isLastCommandCompleted = !processNextCommand();
-        } else {
-            m_cmdQueue.clear();
-            m_isLastCommandCompleted = true;
-        }
-    }
-
-    void resetState() {
-        commandCompleted(false);
-    }
-
-    bool isColorsSaved() const { return m_context.isColorsSaved; }
-
-    const QList<QRgb>& savedColors() const { return m_context.savedColors; }
-
-    void setSavedColors(const QList<QRgb>& colors) {
-        m_context.savedColors = colors;
-        m_context.isColorsSaved = true;
-    }
-
-private:
-    bool processNextCommand() {
-        DEBUG_MID_LEVEL << Q_FUNC_INFO << m_cmdQueue;
-
-        if (!m_cmdQueue.isEmpty()) {
-            const CommandRunner runner = m_cmdQueue.takeFirst();
-            Q_ASSERT(runner);
-
-            DEBUG_HIGH_LEVEL << Q_FUNC_INFO << "processing cmd = " << runner;
-            m_cmdTimeoutTimer.start();
-            runner(m_owner, m_context);
-            return true;
-        }
-        return false;
-    }
-
-    bool m_isLastCommandCompleted;
-    QList<CommandRunner> m_cmdQueue;
-    QTimer m_cmdTimeoutTimer;
-    CommandContext m_context;
-    LedDeviceManager& m_owner;
-};
-
 LedDeviceManager::LedDeviceManager(const SettingsScope::SettingsReader* settings,
                                    QObject *parent)
     : QObject(parent)
     , m_backlightStatus(Backlight::StatusOn)
+    , m_mailbox(NULL)
     , m_ledDevice(CURRENT_LOCATION)
-    , m_settings(settings) {
+    , m_settings(settings)
+    , m_isColorsSaved(false) {
     Q_ASSERT(settings);
-    for (int i = 0; i < SupportedDevices::DeviceTypesCount; ++i)
+    for (int i = 0; i < SupportedDevices::DeviceTypesCount; ++i) {
         m_ledDevices.append(NULL);
+        m_mailboxes.append(NULL);
+    }
 }
 
 LedDeviceManager::~LedDeviceManager()
@@ -251,8 +74,6 @@ LedDeviceManager::~LedDeviceManager()
 
 void LedDeviceManager::init()
 {
-    m_commandDispatcher.reset(new CommandDispatcher(*this));
-
     initLedDevice();
 }
 
@@ -271,9 +92,9 @@ void LedDeviceManager::switchOnLeds()
     DEBUG_MID_LEVEL << Q_FUNC_INFO;
 
     m_backlightStatus = Backlight::StatusOn;
-    Q_ASSERT(m_commandDispatcher.data());
-    if (m_commandDispatcher->isColorsSaved())
-        emit ledDeviceSetColors(m_commandDispatcher->savedColors());
+    Q_ASSERT(m_mailbox);
+    if (m_isColorsSaved)
+        m_mailbox->postColors(m_savedColors);
 }
 
 void LedDeviceManager::setColors(const QList<QRgb>& colors)
@@ -283,125 +104,86 @@ void LedDeviceManager::setColors(const QList<QRgb>& colors)
     if (m_backlightStatus != Backlight::StatusOn)
         return;
 
-    Q_ASSERT(m_commandDispatcher.data());
+    Q_ASSERT(m_mailbox);
     // Always save the colors array.
-    m_commandDispatcher->setSavedColors(colors);
-    m_commandDispatcher->postCommand<SetColorsCommandRunner>(colors);
+    m_savedColors = colors;
+    m_isColorsSaved = true;
+    m_mailbox->postColors(colors);
 }
 
 void LedDeviceManager::switchOffLeds()
-{
-    typedef VoidCommandRunnerNoEmit<&LedDeviceManager::processOffLeds> SwitchOffLeds;
-    m_commandDispatcher->postCommand<SwitchOffLeds>();
-}
-
-void LedDeviceManager::processOffLeds()
 {
     m_backlightStatus = Backlight::StatusOff;
-
-    emit ledDeviceOffLeds();
+    m_mailbox->postOffLeds();
 }
 
 void LedDeviceManager::setRefreshDelay(int value)
 {
-    typedef BaseCommandRunner<
-        int,
-        &LedDeviceManager::ledDeviceSetRefreshDelay,
-        &CommandContext::savedRefreshDelay> SetRefreshDelay;
-
-    m_commandDispatcher->postCommand<SetRefreshDelay>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetRefreshDelay,
+                           &LedDeviceMailbox::DeviceSettings::refreshDelay, value);
 }
 
 void LedDeviceManager::setColorDepth(int value)
 {
-    typedef BaseCommandRunner<
-        int,
-        &LedDeviceManager::ledDeviceSetColorDepth,
-        &CommandContext::savedColorDepth> SetColorDepth;
-    m_commandDispatcher->postCommand<SetColorDepth>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetColorDepth,
+                           &LedDeviceMailbox::DeviceSettings::colorDepth, value);
 }
 
 void LedDeviceManager::setSmoothSlowdown(int value)
 {
-    typedef BaseCommandRunner<
-        int,
-        &LedDeviceManager::ledDeviceSetSmoothSlowdown,
-        &CommandContext::savedSmoothSlowdown> SetSmoothSlowdown;
-    m_commandDispatcher->postCommand<SetSmoothSlowdown>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetSmoothSlowdown,
+                           &LedDeviceMailbox::DeviceSettings::smoothSlowdown, value);
 }
 
 void LedDeviceManager::setGamma(double value)
 {
-    typedef BaseCommandRunner<
-        double,
-        &LedDeviceManager::ledDeviceSetGamma,
-        &CommandContext::savedGamma> SetGamma;
-    m_commandDispatcher->postCommand<SetGamma>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetGamma,
+                           &LedDeviceMailbox::DeviceSettings::gamma, value);
 }
 
 void LedDeviceManager::setBrightness(int value)
 {
-    typedef BaseCommandRunner<
-        int,
-        &LedDeviceManager::ledDeviceSetBrightness,
-        &CommandContext::savedBrightness> SetBrightness;
-    m_commandDispatcher->postCommand<SetBrightness>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetBrightness,
+                           &LedDeviceMailbox::DeviceSettings::brightness, value);
 }
 
 void LedDeviceManager::setLuminosityThreshold(int value)
 {
-    typedef BaseCommandRunner<
-        int,
-        &LedDeviceManager::ledDeviceSetLuminosityThreshold,
-        &CommandContext::savedLuminosityThreshold> SetLuminosityThreshold;
-    m_commandDispatcher->postCommand<SetLuminosityThreshold>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetLuminosityThreshold,
+                           &LedDeviceMailbox::DeviceSettings::luminosityThreshold, value);
 }
 
 void LedDeviceManager::setMinimumLuminosityEnabled(bool value)
 {
-    typedef BaseCommandRunner<
-        bool,
-        &LedDeviceManager::ledDeviceSetMinimumLuminosityEnabled,
-        &CommandContext::savedIsMinimumLuminosityEnabled>
-    SetMinimumLuminosityEnabled;
-    m_commandDispatcher->postCommand<SetMinimumLuminosityEnabled>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetMinimumLuminosityEnabled,
+                           &LedDeviceMailbox::DeviceSettings::isMinimumLuminosityEnabled, value);
 }
 
 void LedDeviceManager::setColorSequence(QString value)
 {
-    typedef BaseCommandRunner<
-        QString,
-        &LedDeviceManager::ledDeviceSetColorSequence,
-        &CommandContext::savedColorSequence> SetColorSequence;
-    m_commandDispatcher->postCommand<SetColorSequence>(value);
+    m_mailbox->postSetting(LedDeviceCommands::SetColorSequence,
+                           &LedDeviceMailbox::DeviceSettings::colorSequence, value);
 }
 
 void LedDeviceManager::requestFirmwareVersion()
 {
-    typedef VoidCommandRunner<
-        &LedDeviceManager::ledDeviceRequestFirmwareVersion> RequestFirmwareVersion;
-    m_commandDispatcher->postCommand<RequestFirmwareVersion>();
+    m_mailbox->postCommand(LedDeviceCommands::RequestFirmwareVersion);
 }
 
 void LedDeviceManager::updateDeviceSettings()
 {
-    typedef VoidCommandRunner<
-        &LedDeviceManager::ledDeviceUpdateDeviceSettings> UpdateDeviceSettings;
-    m_commandDispatcher->postCommand<UpdateDeviceSettings>();
+    m_mailbox->postCommand(LedDeviceCommands::UpdateDeviceSettings);
 }
 
 void LedDeviceManager::updateWBAdjustments()
 {
-    typedef VoidCommandRunner<
-        &LedDeviceManager::ledDeviceUpdateWBAdjustments> UpdateWBAdjustments;
-    m_commandDispatcher->postCommand<UpdateWBAdjustments>();
+    m_mailbox->postCommand(LedDeviceCommands::UpdateWBAdjustments);
 }
 
 void LedDeviceManager::ledDeviceCommandCompleted(bool ok)
 {
     DEBUG_MID_LEVEL << Q_FUNC_INFO << ok;
 
-    m_commandDispatcher->commandCompleted(ok);
     emit ioDeviceSuccess(ok);
 }
 
@@ -409,19 +191,19 @@ void LedDeviceManager::initLedDevice()
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
 
-    Q_ASSERT(m_commandDispatcher.data());
-    m_commandDispatcher->resetState();
-
     const SupportedDevices::DeviceType connectedDevice = m_settings->getConnectedDevice();
     if (m_ledDevices[connectedDevice] == NULL) {
         m_ledDevices[connectedDevice] = createLedDevice(connectedDevice);
+        // Created before the device moves to its thread to go there with it
+        m_mailboxes[connectedDevice] = new LedDeviceMailbox(m_ledDevices[connectedDevice]);
         connectLedDevice(m_ledDevices[connectedDevice]);
     } else {
         Q_ASSERT(m_ledDevices[connectedDevice] != m_ledDevice.get());
         disconnectCurrentLedDevice();
         connectLedDevice(m_ledDevices[connectedDevice]);
     }
-    emit ledDeviceUpdateDeviceSettings();
+    m_mailbox = m_mailboxes[connectedDevice];
+    m_mailbox->postCommand(LedDeviceCommands::UpdateDeviceSettings);
     emit ledDeviceOpen();
 }
 
@@ -495,21 +277,7 @@ void LedDeviceManager::connectLedDevice(AbstractLedDevice * device) {
                  SIGNAL(setColors_VirtualDeviceCallback(QList<QRgb>)));
 
     QtUtils::makeQueuedConnector(this, device)
-        .connect(SIGNAL(ledDeviceOpen()), SLOT(open()))
-        .connect(SIGNAL(ledDeviceSetColors(QList<QRgb>)), SLOT(setColors(QList<QRgb>)))
-        .connect(SIGNAL(ledDeviceOffLeds()), SLOT(switchOffLeds()))
-        .connect(SIGNAL(ledDeviceSetRefreshDelay(int)), SLOT(setRefreshDelay(int)))
-        .connect(SIGNAL(ledDeviceSetColorDepth(int)), SLOT(setColorDepth(int)))
-        .connect(SIGNAL(ledDeviceSetSmoothSlowdown(int)), SLOT(setSmoothSlowdown(int)))
-        .connect(SIGNAL(ledDeviceSetGamma(double)), SLOT(setGamma(double)))
-        .connect(SIGNAL(ledDeviceSetBrightness(int)), SLOT(setBrightness(int)))
-        .connect(SIGNAL(ledDeviceSetColorSequence(QString)), SLOT(setColorSequence(QString)))
-        .connect(SIGNAL(ledDeviceSetLuminosityThreshold(int)) ,SLOT(setLuminosityThreshold(int)))
-        .connect(SIGNAL(ledDeviceSetMinimumLuminosityEnabled(bool)),
-                 SLOT(setMinimumLuminosityThresholdEnabled(bool)))
-        .connect(SIGNAL(ledDeviceRequestFirmwareVersion()), SLOT(requestFirmwareVersion()))
-        .connect(SIGNAL(ledDeviceUpdateWBAdjustments()), SLOT(updateDeviceSettings()))
-        .connect(SIGNAL(ledDeviceUpdateDeviceSettings()), SLOT(updateDeviceSettings()));
+        .connect(SIGNAL(ledDeviceOpen()), SLOT(open()));
 
     m_ledDevice.init(device);
 }
@@ -531,25 +299,5 @@ void LedDeviceManager::disconnectCurrentLedDevice()
                     SIGNAL(setColors_VirtualDeviceCallback(QList<QRgb>)));
 
     QtUtils::makeConnector(this, device)
-        .disconnect(SIGNAL(ledDeviceOpen()), SLOT(open()))
-        .disconnect(SIGNAL(ledDeviceSetColors(QList<QRgb>)), SLOT(setColors(QList<QRgb>)))
-        .disconnect(SIGNAL(ledDeviceOffLeds()), SLOT(switchOffLeds()))
-        .disconnect(SIGNAL(ledDeviceSetRefreshDelay(int)), SLOT(setRefreshDelay(int)))
-        .disconnect(SIGNAL(ledDeviceSetColorDepth(int)), SLOT(setColorDepth(int)))
-        .disconnect(SIGNAL(ledDeviceSetSmoothSlowdown(int)), SLOT(setSmoothSlowdown(int)))
-        .disconnect(SIGNAL(ledDeviceSetGamma(double)), SLOT(setGamma(double)))
-        .disconnect(SIGNAL(ledDeviceSetBrightness(int)), SLOT(setBrightness(int)))
-        .disconnect(SIGNAL(ledDeviceSetColorSequence(QString)), SLOT(setColorSequence(QString)))
-        .disconnect(SIGNAL(ledDeviceSetLuminosityThreshold(int)), SLOT(setLuminosityThreshold(int)))
-        .disconnect(SIGNAL(ledDeviceSetMinimumLuminosityEnabled(bool)),
-                    SLOT(setMinimumLuminosityThresholdEnabled(bool)))
-        .disconnect(SIGNAL(ledDeviceRequestFirmwareVersion()), SLOT(requestFirmwareVersion()))
-        .disconnect(SIGNAL(ledDeviceUpdateWBAdjustments()), SLOT(updateDeviceSettings()))
-        .disconnect(SIGNAL(ledDeviceUpdateDeviceSettings()), SLOT(updateDeviceSettings()));
-}
-
-void LedDeviceManager::ledDeviceCommandTimedOut()
-{
-    ledDeviceCommandCompleted(false);
-    emit ioDeviceSuccess(false);
+        .disconnect(SIGNAL(ledDeviceOpen()), SLOT(open()));
 }
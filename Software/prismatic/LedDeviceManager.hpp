@@ -30,7 +30,7 @@
 #include "enums.hpp"
 #include "third_party/qtutils/include/ThreadedObject.hpp"
 
-class QTimer;
+class LedDeviceMailbox;
 
 namespace SettingsScope {
 class SettingsReader;
@@ -56,28 +56,16 @@ signals:
     void setColors_VirtualDeviceCallback(const QList<QRgb> & colors);
     void finished();
 
-    // This signals are directly connected to ILedDevice. Don't use outside.
+    // This signal is directly connected to ILedDevice. Don't use outside.
     void ledDeviceOpen();
-    void ledDeviceSetColors(const QList<QRgb> & colors);
-    void ledDeviceOffLeds();
-    void ledDeviceSetRefreshDelay(int value);
-    void ledDeviceSetColorDepth(int value);
-    void ledDeviceSetSmoothSlowdown(int value);
-    void ledDeviceSetGamma(double value);
-    void ledDeviceSetBrightness(int value);
-    void ledDeviceSetLuminosityThreshold(int value);
-    void ledDeviceSetMinimumLuminosityEnabled(bool);
-    void ledDeviceSetColorSequence(QString value);
-    void ledDeviceRequestFirmwareVersion();
-    void ledDeviceUpdateWBAdjustments();
-    void ledDeviceUpdateDeviceSettings();
 
 public slots:
     void init();
 
     void recreateLedDevice(const SupportedDevices::DeviceType deviceType);
 
-    // This slots are protected from the overflow of queries
+    // This slots are protected from the overflow of queries, the device gets only
+    // the latest colors and settings through its LedDeviceMailbox
     void setColors(const QList<QRgb> & colors);
     void switchOffLeds();
     void switchOnLeds();
@@ -95,21 +83,21 @@ public slots:
 
 private slots:
     void ledDeviceCommandCompleted(bool ok);
-    void ledDeviceCommandTimedOut();
 
 private:
     void initLedDevice();
     AbstractLedDevice * createLedDevice(SupportedDevices::DeviceType deviceType);
     void connectLedDevice(AbstractLedDevice * device);
     void disconnectCurrentLedDevice();
-    void processOffLeds();
 
 private:
-    class CommandDispatcher;
-
     Backlight::Status m_backlightStatus;
     QList<AbstractLedDevice *> m_ledDevices;
+    // Parallel to m_ledDevices, owned by the devices
+    QList<LedDeviceMailbox *> m_mailboxes;
+    LedDeviceMailbox *m_mailbox;
     QtUtils::ThreadedObject<AbstractLedDevice> m_ledDevice;
     const SettingsScope::SettingsReader* const m_settings;
-    QScopedPointer<CommandDispatcher> m_commandDispatcher;
+    QList<QRgb> m_savedColors;
+    bool m_isColorsSaved;
 };
@@ -511,6 +511,8 @@ void LightpackApplication::startLedDeviceManager()
         .connect(SIGNAL(deviceSmoothChanged(int)), SLOT(setSmoothSlowdown(int)))
         .connect(SIGNAL(deviceRefreshDelayChanged(int)), SLOT(setRefreshDelay(int)))
         .connect(SIGNAL(deviceGammaChanged(double)), SLOT(setGamma(double)))
+        .connect(SIGNAL(deviceColorLutFileChanged(QString)), SLOT(updateDeviceSettings()))
+        .connect(SIGNAL(deviceSmoothModeChanged(TemporalInterpolator::Mode)), SLOT(updateDeviceSettings()))
         .connect(SIGNAL(deviceBrightnessChanged(int)), SLOT(setBrightness(int)))
         .connect(SIGNAL(luminosityThresholdChanged(int)), SLOT(setLuminosityThreshold(int)))
         .connect(SIGNAL(minimumLuminosityEnabledChanged(bool)),
@@ -588,8 +590,20 @@ void LightpackApplication::initGrabManager()
             grabManager(), SLOT(onGrabberTypeChanged(const Grab::GrabberType &)), Qt::QueuedConnection);
     connect(settings(), SIGNAL(grabSlowdownChanged(int)),
             grabManager(), SLOT(onGrabSlowdownChanged(int)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabIdleSlowdownChanged(int)),
+            grabManager(), SLOT(onGrabIdleSlowdownChanged(int)), Qt::QueuedConnection);
     connect(settings(), SIGNAL(grabAvgColorsEnabledChanged(bool)),
             grabManager(), SLOT(onGrabAvgColorsEnabledChanged(bool)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabReductionModeChanged(const Grab::ReductionMode)),
+            grabManager(), SLOT(onGrabReductionModeChanged(const Grab::ReductionMode)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabSampleBudgetChanged(int)),
+            grabManager(), SLOT(onGrabSampleBudgetChanged(int)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabReductionThreadsChanged(int)),
+            grabManager(), SLOT(onGrabReductionThreadsChanged(int)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabReplayFileChanged(const QString &)),
+            grabManager(), SLOT(onGrabReplayFileChanged(const QString &)), Qt::QueuedConnection);
+    connect(settings(), SIGNAL(grabReplayFrameRateChanged(int)),
+            grabManager(), SLOT(onGrabReplayFrameRateChanged(int)), Qt::QueuedConnection);
 
     connect(settings(), SIGNAL(profileLoaded(const QString &)),
             grabManager(), SLOT(settingsProfileChanged(const QString &)), Qt::QueuedConnection);
@@ -0,0 +1,34 @@
+/*
+ * BoardReportFilter.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "BoardReportFilter.hpp"
+
+#include <cstring>
+
+bool isBoardReportNeeded(const unsigned char *sent, const unsigned char *report, size_t size,
+                         qint64 msecsSinceWrite, int refreshInterval)
+{
+    if (sent == NULL || msecsSinceWrite >= refreshInterval)
+        return true;
+    return memcmp(sent, report, size) != 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * BoardReportFilter.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+/*!
+  Decides whether a Lightpack board has to get a new color report.
+  \param sent data last written to the board, NULL if the board may not show
+  it, e.g. it was never written, the write failed or the LEDs were switched off
+  \param report data of the new report, \a size bytes like \a sent
+  \param msecsSinceWrite time since \a sent was written
+  \param refreshInterval unchanged data is written again once this much time
+  passed, in case the board lost it
+  \return false if the report can be skipped
+*/
+bool isBoardReportNeeded(const unsigned char *sent, const unsigned char *report, size_t size,
+                         qint64 msecsSinceWrite, int refreshInterval);
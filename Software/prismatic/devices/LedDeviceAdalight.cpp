@@ -30,6 +30,7 @@
 #include <QtSerialPort/QSerialPortInfo>
 
 #include "common/DebugOut.hpp"
+#include "SerialFrameWriter.hpp"
 #include "PrismatikMath.hpp"
 #include "SettingsReader.hpp"
 
@@ -42,6 +43,7 @@ LedDeviceAdalight::LedDeviceAdalight(const QString &portName, const int baudRate
     m_portName = portName;
     m_baudRate = baudRate;
     m_AdalightDevice = NULL;
+    m_writer = new SerialFrameWriter(this);
 
     // TODO: think about init m_savedColors in all ILedDevices
 
@@ -56,6 +58,12 @@ LedDeviceAdalight::~LedDeviceAdalight()
 void LedDeviceAdalight::close()
 {
     if (m_AdalightDevice != NULL) {
+        DEBUG_LOW_LEVEL << Q_FUNC_INFO << "Frames written:" << m_writer->framesWritten()
+                        << "replaced:" << m_writer->framesReplaced();
+        // the frame still waiting is often the black one of switchOffLeds()
+        if (m_AdalightDevice->isOpen() && !m_writer->flush(SerialFrameWriter::CloseTimeoutMs))
+            qWarning() << Q_FUNC_INFO << "Last frames weren't written:" << m_AdalightDevice->errorString();
+        m_writer->setPort(NULL);
         m_AdalightDevice->close();
 
         delete m_AdalightDevice;
@@ -71,80 +79,42 @@ void LedDeviceAdalight::setColors(const QList<QRgb> & colors)
     resizeColorsBuffer(colors.count());
 
     applyColorModifications(colors, m_colorsBuffer);
+    smoothColors(m_colorsBuffer);
 
+    bool ok = writeColors(m_colorsBuffer);
 
-    m_writeBuffer.clear();
-    m_writeBuffer.append(m_writeBufferHeader);
-
-    for (int i = 0; i < m_colorsBuffer.count(); i++)
-    {
-        StructRgb color = m_colorsBuffer[i];
-
-        color.r = color.r >> 4;
-        color.g = color.g >> 4;
-        color.b = color.b >> 4;
+    emit commandCompleted(ok);
+}
 
-        if (m_colorSequence == "RBG")
-        {
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.g);
-        }
-        else if (m_colorSequence == "BRG")
-        {
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.g);
-        }
-        else if (m_colorSequence == "BGR")
-        {
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.r);
-        }
-        else if (m_colorSequence == "GRB")
-        {
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.b);
-        }
-        else if (m_colorSequence == "GBR")
-        {
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.r);
-        }
-        else
-        {
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.b);
-        }
-    }
+void LedDeviceAdalight::writeSmoothedColors(RgbBuffer &colors)
+{
+    writeColors(colors);
+}
 
-    bool ok = writeBuffer(m_writeBuffer);
+int LedDeviceAdalight::smoothingFrameInterval() const
+{
+    // a frame has to be on the wire before the next one
+    return qMax(5, SerialFrameWriter::wireTime(m_encoder.frameSize(), m_baudRate));
+}
 
-    emit commandCompleted(ok);
+bool LedDeviceAdalight::writeColors(const RgbBuffer &colors)
+{
+    return writeBuffer(m_encoder.encode(colors, 4));
 }
 
 void LedDeviceAdalight::switchOffLeds()
 {
+    stopSmoothing();
+
     int count = m_colorsSaved.count();
     m_colorsSaved.clear();
 
     for (int i = 0; i < count; i++)
         m_colorsSaved << 0;
 
-    m_writeBuffer.clear();
-    m_writeBuffer.append(m_writeBufferHeader);
-
-    for (int i = 0; i < count; i++) {
-        m_writeBuffer.append((char)0)
-                     .append((char)0)
-                     .append((char)0);
-    }
+    resizeColorsBuffer(count);
 
-    bool ok = writeBuffer(m_writeBuffer);
+    bool ok = writeBuffer(m_encoder.encodeBlack());
     emit commandCompleted(ok);
 }
 
@@ -158,8 +128,9 @@ void LedDeviceAdalight::setColorDepth(int /*value*/)
     emit commandCompleted(true);
 }
 
-void LedDeviceAdalight::setSmoothSlowdown(int /*value*/)
+void LedDeviceAdalight::setSmoothSlowdown(int value)
 {
+    setHostSmoothSlowdown(value);
     emit commandCompleted(true);
 }
 
@@ -168,6 +139,7 @@ void LedDeviceAdalight::setColorSequence(QString value)
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << value;
 
     m_colorSequence = value;
+    m_encoder.setColorSequence(value);
     setColors(m_colorsSaved);
 }
 
@@ -238,6 +210,9 @@ void LedDeviceAdalight::open()
         }
     }
 
+    m_writer->setPort(ok ? m_AdalightDevice : NULL);
+    m_writer->setBaudRate(m_baudRate);
+
     emit openDeviceSuccess(ok);
 }
 
@@ -248,15 +223,8 @@ bool LedDeviceAdalight::writeBuffer(const QByteArray & buff)
     if (m_AdalightDevice == NULL || m_AdalightDevice->isOpen() == false)
         return false;
 
-    int bytesWritten = m_AdalightDevice->write(buff);
-
-    if (bytesWritten != buff.count())
-    {
-        qWarning() << Q_FUNC_INFO << "bytesWritten != buff.count():" << bytesWritten << buff.count() << " " << m_AdalightDevice->errorString();
-        return false;
-    }
-
-    return true;
+    // sent now or after the frame still in flight, stale frames are replaced
+    return m_writer->write(buff);
 }
 
 void LedDeviceAdalight::resizeColorsBuffer(int buffSize)
@@ -264,8 +232,6 @@ void LedDeviceAdalight::resizeColorsBuffer(int buffSize)
     if (m_colorsBuffer.count() == buffSize)
         return;
 
-    m_colorsBuffer.clear();
-
     if (buffSize > MaximumNumberOfLeds::Adalight)
     {
         qCritical() << Q_FUNC_INFO << "buffSize > MaximumNumberOfLeds::Adalight" << buffSize << ">" << MaximumNumberOfLeds::Adalight;
@@ -273,26 +239,26 @@ void LedDeviceAdalight::resizeColorsBuffer(int buffSize)
         buffSize = MaximumNumberOfLeds::Adalight;
     }
 
-    for (int i = 0; i < buffSize; i++)
-    {
-        m_colorsBuffer << StructRgb();
-    }
+    m_colorsBuffer.resize(buffSize);
+    m_encoder.setLedsCount(buffSize);
 
     reinitBufferHeader(buffSize);
 }
 
 void LedDeviceAdalight::reinitBufferHeader(int ledsCount)
 {
-    m_writeBufferHeader.clear();
+    QByteArray header;
 
     // Initialize buffer header
     int ledsCountHi = ((ledsCount - 1) >> 8) & 0xff;
     int ledsCountLo = (ledsCount  - 1) & 0xff;
 
-    m_writeBufferHeader.append((char)'A');
-    m_writeBufferHeader.append((char)'d');
-    m_writeBufferHeader.append((char)'a');
-    m_writeBufferHeader.append((char)ledsCountHi);
-    m_writeBufferHeader.append((char)ledsCountLo);
-    m_writeBufferHeader.append((char)(ledsCountHi ^ ledsCountLo ^ 0x55));
+    header.append((char)'A');
+    header.append((char)'d');
+    header.append((char)'a');
+    header.append((char)ledsCountHi);
+    header.append((char)ledsCountLo);
+    header.append((char)(ledsCountHi ^ ledsCountLo ^ 0x55));
+
+    m_encoder.setHeader(header);
 }
@@ -29,9 +29,9 @@
 #include <QtSerialPort/QSerialPortInfo>
 #include <stdio.h>
 
-#include "PrismatikMath.hpp"
 #include "SettingsReader.hpp"
 #include "common/DebugOut.hpp"
+#include "SerialFrameWriter.hpp"
 
 using namespace SettingsScope;
 
@@ -41,9 +41,10 @@ LedDeviceArdulight::LedDeviceArdulight(const QString &portName, const int baudRa
 
     m_portName = portName;
     m_baudRate = baudRate;
-    m_writeBufferHeader.append((char)255);
+    m_encoder.setHeader(QByteArray(1, (char)255));
 
     m_ArdulightDevice = NULL;
+    m_writer = new SerialFrameWriter(this);
 
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << "initialized";
 }
@@ -56,6 +57,12 @@ LedDeviceArdulight::~LedDeviceArdulight()
 void LedDeviceArdulight::close()
 {
     if (m_ArdulightDevice != NULL) {
+        DEBUG_LOW_LEVEL << Q_FUNC_INFO << "Frames written:" << m_writer->framesWritten()
+                        << "replaced:" << m_writer->framesReplaced();
+        // the frame still waiting is often the black one of switchOffLeds()
+        if (m_ArdulightDevice->isOpen() && !m_writer->flush(SerialFrameWriter::CloseTimeoutMs))
+            qWarning() << Q_FUNC_INFO << "Last frames weren't written:" << m_ArdulightDevice->errorString();
+        m_writer->setPort(NULL);
         m_ArdulightDevice->close();
 
         delete m_ArdulightDevice;
@@ -73,82 +80,43 @@ void LedDeviceArdulight::setColors(const QList<QRgb> & colors)
     resizeColorsBuffer(colors.count());
 
     applyColorModifications(colors, m_colorsBuffer);
+    smoothColors(m_colorsBuffer);
 
-    for(int i=0; i < m_colorsBuffer.count(); i++) {
-        m_colorsBuffer[i].r = m_colorsBuffer[i].r >> 4;
-        m_colorsBuffer[i].g = m_colorsBuffer[i].g >> 4;
-        m_colorsBuffer[i].b = m_colorsBuffer[i].b >> 4;
-        PrismatikMath::maxCorrection(254, m_colorsBuffer[i]);
-    }
-
-    m_writeBuffer.clear();
-    m_writeBuffer.append(m_writeBufferHeader);
+    bool ok = writeColors(m_colorsBuffer);
 
-    for (int i = 0; i < m_colorsBuffer.count(); i++)
-    {
-        StructRgb color = m_colorsBuffer[i];
+    emit commandCompleted(ok);
+}
 
-        if (m_colorSequence == "RBG")
-        {
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.g);
-        }
-        else if (m_colorSequence == "BRG")
-        {
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.g);
-        }
-        else if (m_colorSequence == "BGR")
-        {
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.r);
-        }
-        else if (m_colorSequence == "GRB")
-        {
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.b);
-        }
-        else if (m_colorSequence == "GBR")
-        {
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.b);
-            m_writeBuffer.append(color.r);
-        }
-        else
-        {
-            m_writeBuffer.append(color.r);
-            m_writeBuffer.append(color.g);
-            m_writeBuffer.append(color.b);
-        }
-    }
+void LedDeviceArdulight::writeSmoothedColors(RgbBuffer &colors)
+{
+    writeColors(colors);
+}
 
-    bool ok = writeBuffer(m_writeBuffer);
+int LedDeviceArdulight::smoothingFrameInterval() const
+{
+    // a frame has to be on the wire before the next one
+    return qMax(5, SerialFrameWriter::wireTime(m_encoder.frameSize(), m_baudRate));
+}
 
-    emit commandCompleted(ok);
+bool LedDeviceArdulight::writeColors(const RgbBuffer &colors)
+{
+    // 255 is the frame start, colors stop one below it
+    return writeBuffer(m_encoder.encode(colors, 4, 254));
 }
 
 void LedDeviceArdulight::switchOffLeds()
 {
+    stopSmoothing();
+
     int count = m_colorsSaved.count();
     m_colorsSaved.clear();
 
     for (int i = 0; i < count; i++)
         m_colorsSaved << 0;
 
-    m_writeBuffer.clear();
-    m_writeBuffer.append(m_writeBufferHeader);
-
-    for (int i = 0; i < count; i++) {
-        m_writeBuffer.append((char)0)
-                     .append((char)0)
-                     .append((char)0);
-    }
+    resizeColorsBuffer(count);
 
-    bool ok = writeBuffer(m_writeBuffer);
+    bool ok = writeBuffer(m_encoder.encodeBlack());
 
     emit commandCompleted(ok);
 }
@@ -163,8 +131,9 @@ void LedDeviceArdulight::setColorDepth(int /*value*/)
     emit commandCompleted(true);
 }
 
-void LedDeviceArdulight::setSmoothSlowdown(int /*value*/)
+void LedDeviceArdulight::setSmoothSlowdown(int value)
 {
+    setHostSmoothSlowdown(value);
     emit commandCompleted(true);
 }
 
@@ -173,6 +142,7 @@ void LedDeviceArdulight::setColorSequence(QString value)
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << value;
 
     m_colorSequence = value;
+    m_encoder.setColorSequence(value);
     setColors(m_colorsSaved);
 }
 
@@ -244,6 +214,9 @@ void LedDeviceArdulight::open()
         }
     }
 
+    m_writer->setPort(ok ? m_ArdulightDevice : NULL);
+    m_writer->setBaudRate(m_baudRate);
+
     emit openDeviceSuccess(ok);
 }
 
@@ -254,15 +227,8 @@ bool LedDeviceArdulight::writeBuffer(const QByteArray & buff)
     if (m_ArdulightDevice == NULL || m_ArdulightDevice->isOpen() == false)
         return false;
 
-    int bytesWritten = m_ArdulightDevice->write(buff);
-
-    if (bytesWritten != buff.count())
-    {
-        qWarning() << Q_FUNC_INFO << "bytesWritten != buff.count():" << bytesWritten << buff.count() << " " << m_ArdulightDevice->errorString();
-        return false;
-    }
-
-    return true;
+    // sent now or after the frame still in flight, stale frames are replaced
+    return m_writer->write(buff);
 }
 
 void LedDeviceArdulight::resizeColorsBuffer(int buffSize)
@@ -270,8 +236,6 @@ void LedDeviceArdulight::resizeColorsBuffer(int buffSize)
     if (m_colorsBuffer.count() == buffSize)
         return;
 
-    m_colorsBuffer.clear();
-
     if (buffSize > MaximumNumberOfLeds::Ardulight)
     {
         qCritical() << Q_FUNC_INFO << "buffSize > MaximumNumberOfLeds::Ardulight" << buffSize << ">" << MaximumNumberOfLeds::Ardulight;
@@ -279,9 +243,7 @@ void LedDeviceArdulight::resizeColorsBuffer(int buffSize)
         buffSize = MaximumNumberOfLeds::Ardulight;
     }
 
-    for (int i = 0; i < buffSize; i++)
-    {
-        m_colorsBuffer << StructRgb();
-    }
+    m_colorsBuffer.resize(buffSize);
+    m_encoder.setLedsCount(buffSize);
 }
 
@@ -28,8 +28,11 @@
 
 #include "AbstractLedDevice.hpp"
 #include "colorspace_types.h"
+#include "SerialFrameEncoder.hpp"
 #include <QtSerialPort/QSerialPort>
 
+class SerialFrameWriter;
+
 class LedDeviceArdulight : public AbstractLedDevice
 {
     Q_OBJECT
@@ -45,23 +48,27 @@ public slots:
     void switchOffLeds();
     void setRefreshDelay(int /*value*/);
     void setColorDepth(int /*value*/);
-    void setSmoothSlowdown(int /*value*/);
+    void setSmoothSlowdown(int value);
     void setColorSequence(QString value);
     void requestFirmwareVersion();
     void updateDeviceSettings();
     size_t maxLedsCount(){ return 255;}
     virtual size_t defaultLedsCount() { return 25; }
 
+protected:
+    void writeSmoothedColors(RgbBuffer &colors);
+    int smoothingFrameInterval() const;
+
 private:
+    bool writeColors(const RgbBuffer &colors);
     bool writeBuffer(const QByteArray & buff);
     void resizeColorsBuffer(int buffSize);
 
 private:
     QSerialPort *m_ArdulightDevice;
+    SerialFrameWriter *m_writer;
 
-    QByteArray m_writeBufferHeader;
-    QByteArray m_writeBuffer;
-
+    SerialFrameEncoder m_encoder;
     QString m_portName;
     int m_baudRate;
 };
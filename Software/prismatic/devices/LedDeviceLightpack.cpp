@@ -28,18 +28,63 @@
 
 #include <algorithm>
 #include <QApplication>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QtDebug>
 
 #include "common/DebugOut.hpp"
 #include "SettingsReader.hpp"
+#include "BoardReportFilter.hpp"
 
 using namespace SettingsScope;
 
 const int LedDeviceLightpack::kPingDeviceInterval = 1000;
 const int LedDeviceLightpack::kLedsPerDevice = 10;
+// unchanged colors are sent again this often in case a board lost them
+const int LedDeviceLightpack::kForcedRefreshInterval = 1000;
+// frames between two debug reports of the sent and skipped color reports
+const int LedDeviceLightpack::kColorReportsLogInterval = 1000;
+
+namespace {
+
+// hid_write() with one retry, safe to call for different boards at once
+bool writeReport(hid_device *device, const unsigned char *buffer)
+{
+    const size_t kReportSize = 65;
+    if (hid_write(device, buffer, kReportSize) >= 0)
+        return true;
+    return hid_write(device, buffer, kReportSize) >= 0;
+}
+
+// Writes its own copy of a report, nothing of the device changes under it
+class BoardWriter : public QRunnable {
+public:
+    BoardWriter(hid_device *device, const unsigned char *buffer, bool *isOk, QSemaphore *finished)
+        : m_device(device)
+        , m_isOk(isOk)
+        , m_finished(finished)
+    {
+        memcpy(m_buffer, buffer, sizeof(m_buffer));
+    }
+
+    virtual void run() {
+        *m_isOk = writeReport(m_device, m_buffer);
+        m_finished->release();
+    }
+
+private:
+    hid_device *m_device;
+    unsigned char m_buffer[65];
+    bool *m_isOk;
+    QSemaphore *m_finished;
+};
+
+}
 
 LedDeviceLightpack::LedDeviceLightpack(QObject *parent) :
-    AbstractLedDevice(parent)
+    AbstractLedDevice(parent),
+    m_devicesGeneration(0),
+    m_colorFramesCount(0)
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << "thread id: " << this->thread()->currentThreadId();
@@ -51,6 +96,9 @@ LedDeviceLightpack::LedDeviceLightpack(QObject *parent) :
 
     m_timerPingDevice = new QTimer(this);
 
+    // keep board writers alive between frames instead of respawning them
+    m_boardWriters.setExpiryTimeout(-1);
+
     connect(m_timerPingDevice, SIGNAL(timeout()), this, SLOT(timerPingDeviceTimeout()));
     connect(this, SIGNAL(ioDeviceSuccess(bool)), this, SLOT(restartPingDevice(bool)));
     connect(this, SIGNAL(openDeviceSuccess(bool)), this, SLOT(restartPingDevice(bool)));
@@ -86,39 +134,56 @@ void LedDeviceLightpack::setColors(const QList<QRgb> & colors)
 
     // First write_buffer[0] == 0x00 - ReportID, i have problems with using it
     // Second byte of usb buffer is command (write_buffer[1] == CMD_UPDATE_LEDS, see below)
-    int buffIndex = WRITE_BUFFER_INDEX_DATA_START;
+    const int boardsCount = qMin((m_colorsBuffer.count() + kLedsPerDevice - 1) / kLedsPerDevice,
+                                 m_boardReports.size());
+    for (int board = 0; board < boardsCount; ++board) {
+        unsigned char *buffer = m_boardReports[board].buffer;
+        memset(buffer, 0, sizeof(m_boardReports[board].buffer));
+        buffer[WRITE_BUFFER_INDEX_REPORT_ID] = 0x00;
+        buffer[WRITE_BUFFER_INDEX_COMMAND] = CMD_UPDATE_LEDS;
+    }
 
-    bool ok = true;
     const int kLedRemap[] = {4, 3, 0, 1, 2, 5, 6, 7, 8, 9};
     const size_t kSizeOfLedColor = 6;
 
-    memset(m_writeBuffer, 0, sizeof(m_writeBuffer));
-    for (int i = 0; i < m_colorsBuffer.count(); i++)
-    {
-        StructRgb color = m_colorsBuffer[i];
+    const quint16 *red = m_colorsBuffer.red();
+    const quint16 *green = m_colorsBuffer.green();
+    const quint16 *blue = m_colorsBuffer.blue();
 
-        buffIndex = WRITE_BUFFER_INDEX_DATA_START + kLedRemap[i % 10] * kSizeOfLedColor;
+    for (int i = 0; i < qMin(m_colorsBuffer.count(), boardsCount * kLedsPerDevice); i++)
+    {
+        unsigned char *buffer = m_boardReports[i / kLedsPerDevice].buffer;
+        int buffIndex = WRITE_BUFFER_INDEX_DATA_START + kLedRemap[i % 10] * kSizeOfLedColor;
 
         // Send main 8 bits for compability with existing devices
-        m_writeBuffer[buffIndex++] = (color.r & 0x0FF0) >> 4;
-        m_writeBuffer[buffIndex++] = (color.g & 0x0FF0) >> 4;
-        m_writeBuffer[buffIndex++] = (color.b & 0x0FF0) >> 4;
+        buffer[buffIndex++] = (red[i] & 0x0FF0) >> 4;
+        buffer[buffIndex++] = (green[i] & 0x0FF0) >> 4;
+        buffer[buffIndex++] = (blue[i] & 0x0FF0) >> 4;
 
         // Send over 4 bits for devices revision >= 6
         // All existing devices ignore it
-        m_writeBuffer[buffIndex++] = (color.r & 0x000F);
-        m_writeBuffer[buffIndex++] = (color.g & 0x000F);
-        m_writeBuffer[buffIndex++] = (color.b & 0x000F);
+        buffer[buffIndex++] = (red[i] & 0x000F);
+        buffer[buffIndex++] = (green[i] & 0x000F);
+        buffer[buffIndex++] = (blue[i] & 0x000F);
+    }
 
-        if ((i+1) % kLedsPerDevice == 0 || i == m_colorsBuffer.size() - 1) {
-            if (!writeBufferToDeviceWithCheck(CMD_UPDATE_LEDS, m_devices[(i+kLedsPerDevice)/kLedsPerDevice - 1])) {
-                ok = false;
-            }
-            memset(m_writeBuffer, 0, sizeof(m_writeBuffer));
-            buffIndex = WRITE_BUFFER_INDEX_DATA_START;
-        }
+    QVector<int> pendingBoards;
+    for (int board = 0; board < boardsCount; ++board) {
+        BoardReport &report = m_boardReports[board];
+        const unsigned char *sent = report.isValid ? report.sent : NULL;
+        const qint64 msecsSinceWrite = report.isValid ? report.lastWrite.elapsed() : 0;
+        if (isBoardReportNeeded(sent, report.buffer + WRITE_BUFFER_INDEX_DATA_START, sizeof(report.sent),
+                                msecsSinceWrite, kForcedRefreshInterval))
+            pendingBoards.append(board);
+        else
+            ++report.skippedCount;
     }
 
+    bool ok = writePendingBoards(pendingBoards);
+
+    if (++m_colorFramesCount % kColorReportsLogInterval == 0)
+        logColorReports();
+
 //    locker.unlock();
 
 
@@ -148,6 +213,7 @@ void LedDeviceLightpack::switchOffLeds()
     m_timerPingDevice->stop();
 
     memset(m_writeBuffer, 0, sizeof(m_writeBuffer));
+    invalidateBoardReports();
 
     bool ok = true;
     for(int i = 0; i < m_devices.size(); i++) {
@@ -271,6 +337,10 @@ void LedDeviceLightpack::open()
 
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << "Lightpack opened";
 
+    // boards may come back in another order, nothing is known about what they show
+    m_boardReports = QVector<BoardReport>(m_devices.size());
+    ++m_devicesGeneration;
+
     updateDeviceSettings();
 
     emit openDeviceSuccess(true);
@@ -421,13 +491,67 @@ bool LedDeviceLightpack::writeBufferToDeviceWithCheck(int command, hid_device *p
     }
 }
 
+bool LedDeviceLightpack::writePendingBoards(const QVector<int> &pendingBoards)
+{
+    const int pendingCount = pendingBoards.size();
+    if (pendingCount == 0)
+        return true;
+
+    // this thread writes the first board while the pool writes the rest
+    QVector<bool> isWriteOk(pendingCount);
+    QSemaphore finishedWriters;
+    m_boardWriters.setMaxThreadCount(qMax(1, pendingCount - 1));
+    for (int k = 1; k < pendingCount; ++k) {
+        const int board = pendingBoards[k];
+        m_boardWriters.start(new BoardWriter(m_devices[board], m_boardReports[board].buffer, &isWriteOk[k],
+                                             &finishedWriters));
+    }
+    isWriteOk[0] = writeReport(m_devices[pendingBoards[0]], m_boardReports[pendingBoards[0]].buffer);
+    finishedWriters.acquire(pendingCount - 1);
+
+    bool ok = true;
+    bool isAnyWritten = false;
+    for (int k = 0; k < pendingCount; ++k) {
+        const int board = pendingBoards[k];
+        if (!isWriteOk[k]) {
+            // reopens the boards if needed, as for any other command
+            const int generation = m_devicesGeneration;
+            memcpy(m_writeBuffer, m_boardReports[board].buffer, sizeof(m_writeBuffer));
+            isWriteOk[k] = writeBufferToDeviceWithCheck(CMD_UPDATE_LEDS, m_devices[board]);
+            if (m_devicesGeneration != generation) {
+                // the boards were closed or opened again, all of them get the next colors
+                return false;
+            }
+        } else {
+            isAnyWritten = true;
+        }
+
+        BoardReport &report = m_boardReports[board];
+        report.isValid = isWriteOk[k];
+        if (isWriteOk[k]) {
+            memcpy(report.sent, report.buffer + WRITE_BUFFER_INDEX_DATA_START, sizeof(report.sent));
+            report.lastWrite.start();
+            ++report.sentCount;
+        } else {
+            ok = false;
+        }
+    }
+    if (isAnyWritten)
+        emit ioDeviceSuccess(true);
+    return ok;
+}
+
+void LedDeviceLightpack::invalidateBoardReports()
+{
+    for (int i = 0; i < m_boardReports.size(); ++i)
+        m_boardReports[i].isValid = false;
+}
+
 void LedDeviceLightpack::resizeColorsBuffer(int buffSize)
 {
     if (m_colorsBuffer.count() == buffSize || buffSize < 0)
         return;
 
-    m_colorsBuffer.clear();
-
     size_t checkedBufferSize = buffSize;
     if (checkedBufferSize > maxLedsCount())
     {
@@ -436,7 +560,7 @@ void LedDeviceLightpack::resizeColorsBuffer(int buffSize)
         checkedBufferSize = maxLedsCount();
     }
 
-    std::fill_n(std::back_inserter(m_colorsBuffer), checkedBufferSize, StructRgb());
+    m_colorsBuffer.resize(checkedBufferSize);
 }
 
 void LedDeviceLightpack::closeDevices()
@@ -450,6 +574,19 @@ void LedDeviceLightpack::closeDevices()
         hid_close(m_devices[i]);
     }
     m_devices.clear();
+
+    logColorReports();
+    m_boardReports.clear();
+    m_colorFramesCount = 0;
+    ++m_devicesGeneration;
+}
+
+void LedDeviceLightpack::logColorReports() const
+{
+    for (int i = 0; i < m_boardReports.size(); ++i) {
+        DEBUG_LOW_LEVEL << Q_FUNC_INFO << "board" << i << "color reports sent:" << colorReportsSent(i)
+                        << "skipped:" << colorReportsSkipped(i);
+    }
 }
 
 void LedDeviceLightpack::restartPingDevice(bool isSuccess)
@@ -26,6 +26,7 @@
 
 
 #include <QtGui>
+#include <QThreadPool>
 
 #include "AbstractLedDevice.hpp"
 #include "TimeEvaluations.hpp"
@@ -65,6 +66,13 @@ public slots:
     virtual size_t defaultLedsCount() { return maxLedsCount(); }
     size_t lightpacksFound() { return m_devices.size(); }
 
+    /*!
+      Color reports written to and skipped for board \a index since the boards were opened.
+      A report is skipped if the board already shows the same colors.
+    */
+    quint64 colorReportsSent(int index) const { return index < m_boardReports.size() ? m_boardReports[index].sentCount : 0; }
+    quint64 colorReportsSkipped(int index) const { return index < m_boardReports.size() ? m_boardReports[index].skippedCount : 0; }
+
 private: 
     bool readDataFromDevice();
     bool writeBufferToDevice(int command, hid_device *phid_device);
@@ -73,6 +81,14 @@ private:
     bool writeBufferToDeviceWithCheck(int command, hid_device *phid_device);
     void resizeColorsBuffer(int buffSize);
     void closeDevices();
+    /*!
+      Writes the reports of \a pendingBoards to all of them at once, boards are written
+      one by one again through writeBufferToDeviceWithCheck() only if that fails
+      \return true if every board got its report
+    */
+    bool writePendingBoards(const QVector<int> &pendingBoards);
+    void invalidateBoardReports();
+    void logColorReports() const;
 
 private slots:
     void restartPingDevice(bool isSuccess);
@@ -89,6 +105,27 @@ private:
 
     QTimer *m_timerPingDevice;
 
+    // CMD_UPDATE_LEDS report of each of m_devices and the data last written to it
+    struct BoardReport {
+        BoardReport() : isValid(false), sentCount(0), skippedCount(0) {}
+        unsigned char buffer[65];
+        bool isValid;
+        QElapsedTimer lastWrite;
+        unsigned char sent[65 - WRITE_BUFFER_INDEX_DATA_START];
+        quint64 sentCount;
+        quint64 skippedCount;
+    };
+    // reset by open() and closeDevices()
+    QVector<BoardReport> m_boardReports;
+    // changes whenever m_devices are opened or closed, a write in progress sees it
+    int m_devicesGeneration;
+    // setColors() calls since the boards were opened
+    int m_colorFramesCount;
+    // one thread per board besides the device thread, kept alive between frames
+    QThreadPool m_boardWriters;
+
     static const int kPingDeviceInterval;
     static const int kLedsPerDevice;
+    static const int kForcedRefreshInterval;
+    static const int kColorReportsLogInterval;
 };
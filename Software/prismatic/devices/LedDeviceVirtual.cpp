@@ -45,24 +45,40 @@ void LedDeviceVirtual::setColors(const QList<QRgb> & colors)
     {
         m_colorsSaved = colors;
 
-        QList<QRgb> callbackColors;
-
         resizeColorsBuffer(colors.count());
 
         applyColorModifications(colors, m_colorsBuffer);
+        smoothColors(m_colorsBuffer);
 
-        for (int i = 0; i < m_colorsBuffer.count(); i++)
-        {
-            callbackColors.append(qRgb(m_colorsBuffer[i].r>>4, m_colorsBuffer[i].g>>4, m_colorsBuffer[i].b>>4));
-        }
-
-        emit colorsUpdated(callbackColors);
+        emitColors(m_colorsBuffer);
     }
     emit commandCompleted(true);
 }
 
+void LedDeviceVirtual::writeSmoothedColors(RgbBuffer &colors)
+{
+    emitColors(colors);
+}
+
+void LedDeviceVirtual::emitColors(const RgbBuffer &colors)
+{
+    QList<QRgb> callbackColors;
+
+    const quint16 *red = colors.red();
+    const quint16 *green = colors.green();
+    const quint16 *blue = colors.blue();
+    for (int i = 0; i < colors.count(); i++)
+    {
+        callbackColors.append(qRgb(red[i]>>4, green[i]>>4, blue[i]>>4));
+    }
+
+    emit colorsUpdated(callbackColors);
+}
+
 void LedDeviceVirtual::switchOffLeds()
 {
+    stopSmoothing();
+
     int count = m_colorsSaved.count();
     m_colorsSaved.clear();
 
@@ -83,8 +99,9 @@ void LedDeviceVirtual::setColorDepth(int /*value*/)
     emit commandCompleted(true);
 }
 
-void LedDeviceVirtual::setSmoothSlowdown(int /*value*/)
+void LedDeviceVirtual::setSmoothSlowdown(int value)
 {
+    setHostSmoothSlowdown(value);
     emit commandCompleted(true);
 }
 
@@ -127,8 +144,6 @@ void LedDeviceVirtual::resizeColorsBuffer(int buffSize)
     if (m_colorsBuffer.count() == buffSize)
         return;
 
-    m_colorsBuffer.clear();
-
     if (buffSize > MaximumNumberOfLeds::Virtual)
     {
         qCritical() << Q_FUNC_INFO << "buffSize > MaximumNumberOfLeds::Virtual" << buffSize << ">" << MaximumNumberOfLeds::Virtual;
@@ -136,9 +151,6 @@ void LedDeviceVirtual::resizeColorsBuffer(int buffSize)
         buffSize = MaximumNumberOfLeds::Virtual;
     }
 
-    for (int i = 0; i < buffSize; i++)
-    {
-        m_colorsBuffer << StructRgb();
-    }
+    m_colorsBuffer.resize(buffSize);
 }
 
@@ -44,7 +44,7 @@ public slots:
     void switchOffLeds();
     void setRefreshDelay(int /*value*/);
     void setColorDepth(int /*value*/);
-    void setSmoothSlowdown(int /*value*/);
+    void setSmoothSlowdown(int value);
     void setColorSequence(QString /*value*/);
     void setGamma(double value);
     void setBrightness(int value);
@@ -52,8 +52,11 @@ public slots:
     size_t maxLedsCount() { return 255;}
     size_t defaultLedsCount() { return 10;}
 
+protected:
+    void writeSmoothedColors(RgbBuffer &colors);
 
 private:
+    void emitColors(const RgbBuffer &colors);
     void resizeColorsBuffer(int buffSize);
 
 };
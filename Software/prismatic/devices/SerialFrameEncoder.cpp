@@ -0,0 +1,117 @@
+/*
+ * SerialFrameEncoder.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SerialFrameEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+SerialFrameEncoder::SerialFrameEncoder()
+    : m_ledsCount(0)
+{
+    m_channelOrder[0] = 0;
+    m_channelOrder[1] = 1;
+    m_channelOrder[2] = 2;
+}
+
+void SerialFrameEncoder::setHeader(const QByteArray &header)
+{
+    if (header == m_header)
+        return;
+
+    m_header = header;
+    relayout();
+}
+
+void SerialFrameEncoder::setLedsCount(int ledsCount)
+{
+    ledsCount = std::max(0, ledsCount);
+    if (ledsCount == m_ledsCount)
+        return;
+
+    m_ledsCount = ledsCount;
+    relayout();
+}
+
+void SerialFrameEncoder::setColorSequence(const QString &sequence)
+{
+    int order[3] = { 0, 1, 2 };
+    int usedChannels = 0;
+
+    if (sequence.size() == 3) {
+        for (int i = 0; i < 3; ++i) {
+            switch (sequence[i].toUpper().toLatin1()) {
+            case 'R': order[i] = 0; break;
+            case 'G': order[i] = 1; break;
+            case 'B': order[i] = 2; break;
+            default:  order[i] = -1; break;
+            }
+            if (order[i] >= 0)
+                usedChannels |= 1 << order[i];
+        }
+    }
+
+    const bool isPermutation = (usedChannels == 7);
+    for (int i = 0; i < 3; ++i)
+        m_channelOrder[i] = isPermutation ? order[i] : i;
+}
+
+const QByteArray & SerialFrameEncoder::encode(const RgbBuffer &colors, int shift, quint8 maxValue)
+{
+    const quint16 *planes[] = { colors.red(), colors.green(), colors.blue() };
+    const quint16 *first = planes[m_channelOrder[0]];
+    const quint16 *second = planes[m_channelOrder[1]];
+    const quint16 *third = planes[m_channelOrder[2]];
+
+    // no allocation here unless a caller still holds a copy of the previous frame
+    uchar *out = reinterpret_cast<uchar *>(m_frame.data()) + m_header.size();
+    const int count = std::min(colors.count(), m_ledsCount);
+
+    // plain loads, shifts and stores the compiler turns into vector shuffles
+    for (int i = 0; i < count; ++i) {
+        unsigned a = first[i], b = second[i], c = third[i];
+        a >>= shift;
+        b >>= shift;
+        c >>= shift;
+        out[3 * i]     = a < maxValue ? a : maxValue;
+        out[3 * i + 1] = b < maxValue ? b : maxValue;
+        out[3 * i + 2] = c < maxValue ? c : maxValue;
+    }
+    if (count < m_ledsCount)
+        memset(out + 3 * count, 0, 3 * (m_ledsCount - count));
+
+    return m_frame;
+}
+
+const QByteArray & SerialFrameEncoder::encodeBlack()
+{
+    memset(m_frame.data() + m_header.size(), 0, 3 * m_ledsCount);
+    return m_frame;
+}
+
+void SerialFrameEncoder::relayout()
+{
+    m_frame.resize(m_header.size() + 3 * m_ledsCount);
+    if (!m_header.isEmpty())
+        memcpy(m_frame.data(), m_header.constData(), m_header.size());
+}
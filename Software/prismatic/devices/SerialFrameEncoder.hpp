@@ -0,0 +1,71 @@
+/*
+ * SerialFrameEncoder.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include "RgbBuffer.hpp"
+
+/*!
+  Builds the frames Adalight like serial devices expect: a header followed by
+  one byte per channel of every LED in the device color sequence. The frame
+  is allocated when the header or LEDs count change only, encoding writes
+  into it in place.
+*/
+class SerialFrameEncoder
+{
+public:
+    SerialFrameEncoder();
+
+    void setHeader(const QByteArray &header);
+    const QByteArray & header() const { return m_header; }
+
+    void setLedsCount(int ledsCount);
+    int ledsCount() const { return m_ledsCount; }
+
+    /*!
+      \param sequence channels order like "GRB", anything else than a
+      permutation of 'R', 'G' and 'B' falls back to "RGB"
+    */
+    void setColorSequence(const QString &sequence);
+
+    int frameSize() const { return m_frame.size(); }
+
+    /*!
+      Encodes \a colors shifted right by \a shift bits and clamped to
+      \a maxValue, LEDs above ledsCount() are ignored, missing ones are black
+      \return the frame, valid until the next call
+    */
+    const QByteArray & encode(const RgbBuffer &colors, int shift, quint8 maxValue = 0xff);
+    const QByteArray & encodeBlack();
+
+private:
+    void relayout();
+
+    QByteArray m_header;
+    QByteArray m_frame;
+    int m_ledsCount;
+    // plane index, 0 red, 1 green, 2 blue, sent at every position of an LED
+    int m_channelOrder[3];
+};
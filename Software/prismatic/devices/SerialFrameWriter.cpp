@@ -0,0 +1,200 @@
+/*
+ * SerialFrameWriter.cpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SerialFrameWriter.hpp"
+
+#include <cstring>
+#include <QThread>
+#include <QTimer>
+#include <QtSerialPort/QSerialPort>
+
+#include "common/DebugOut.hpp"
+
+namespace {
+const int StatisticsIntervalMs = 1000;
+}
+
+SerialFrameWriter::SerialFrameWriter(QObject *parent)
+    : QObject(parent)
+    , m_port(NULL)
+    , m_baudRate(0)
+    , m_wireTimer(new QTimer(this))
+    , m_hasPending(false)
+    , m_statisticsFrames(0)
+    , m_framesPerSecond(0)
+    , m_framesWritten(0)
+    , m_framesReplaced(0)
+{
+    m_wireTimer->setSingleShot(true);
+    m_wireTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_wireTimer, SIGNAL(timeout()), this, SLOT(writePending()));
+}
+
+void SerialFrameWriter::setPort(QSerialPort *port)
+{
+    if (m_port)
+        disconnect(m_port, SIGNAL(bytesWritten(qint64)), this, SLOT(writePending()));
+
+    m_port = port;
+    m_hasPending = false;
+    m_wireTimer->stop();
+    m_statisticsClock.invalidate();
+    m_framesPerSecond = 0;
+
+    if (m_port)
+        connect(m_port, SIGNAL(bytesWritten(qint64)), this, SLOT(writePending()));
+}
+
+void SerialFrameWriter::setBaudRate(int baudRate)
+{
+    m_baudRate = qMax(0, baudRate);
+}
+
+bool SerialFrameWriter::write(const QByteArray &frame)
+{
+    if (m_port == NULL || m_port->isOpen() == false)
+        return false;
+
+    if (!isBusy())
+        return writeNow(frame.constData(), frame.size());
+
+    if (m_hasPending)
+        ++m_framesReplaced;
+
+    // copied into the slot, the caller may reuse the frame right away
+    m_pending.resize(frame.size());
+    memcpy(m_pending.data(), frame.constData(), frame.size());
+    m_hasPending = true;
+    return true;
+}
+
+bool SerialFrameWriter::flush(int timeoutMs)
+{
+    if (m_port == NULL || m_port->isOpen() == false) {
+        m_hasPending = false;
+        return false;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    if (m_hasPending) {
+        // the frame in flight first leaves the port, then the wire
+        if (m_port->bytesToWrite() > 0 && !m_port->waitForBytesWritten(qMax(1, timeoutMs)))
+            return false;
+        if (m_wireTimer->isActive()) {
+            const qint64 timeLeft = timeoutMs - clock.elapsed();
+            const int wireTimeLeft = m_wireTimer->remainingTime();
+            if (wireTimeLeft > timeLeft)
+                return false;
+            QThread::msleep(wireTimeLeft);
+            m_wireTimer->stop();
+        }
+
+        // without pacing bytesWritten() may have sent it already
+        if (m_hasPending) {
+            m_hasPending = false;
+            if (!writeNow(m_pending.constData(), m_pending.size()))
+                return false;
+        }
+    }
+
+    while (m_port->bytesToWrite() > 0) {
+        const qint64 timeLeft = timeoutMs - clock.elapsed();
+        if (timeLeft <= 0 || !m_port->waitForBytesWritten(timeLeft))
+            return false;
+    }
+    return true;
+}
+
+int SerialFrameWriter::queueDepth() const
+{
+    return (isBusy() ? 1 : 0) + (m_hasPending ? 1 : 0);
+}
+
+int SerialFrameWriter::wireTime(int bytes, int baudRate)
+{
+    if (baudRate <= 0)
+        return 0;
+
+    return (bytes * 10 * 1000 + baudRate - 1) / baudRate;
+}
+
+void SerialFrameWriter::writePending()
+{
+    if (!m_hasPending || isBusy())
+        return;
+
+    if (m_port == NULL || m_port->isOpen() == false) {
+        m_hasPending = false;
+        return;
+    }
+
+    m_hasPending = false;
+    if (!writeNow(m_pending.constData(), m_pending.size()))
+        qWarning() << Q_FUNC_INFO << "Write of the waiting frame failed:" << m_port->errorString();
+}
+
+bool SerialFrameWriter::isBusy() const
+{
+    return m_wireTimer->isActive() || (m_port && m_port->bytesToWrite() > 0);
+}
+
+bool SerialFrameWriter::writeNow(const char *data, int size)
+{
+    const qint64 bytesWritten = m_port->write(data, size);
+    if (bytesWritten != size) {
+        qWarning() << Q_FUNC_INFO << "bytesWritten != size:" << bytesWritten << size << m_port->errorString();
+        return false;
+    }
+
+    const int wireTimeMs = wireTime(size, m_baudRate);
+    if (wireTimeMs > 0)
+        m_wireTimer->start(wireTimeMs);
+
+    ++m_framesWritten;
+    updateStatistics();
+    return true;
+}
+
+void SerialFrameWriter::updateStatistics()
+{
+    if (!m_statisticsClock.isValid()) {
+        m_statisticsClock.start();
+        m_statisticsFrames = 0;
+    }
+
+    ++m_statisticsFrames;
+    const qint64 elapsedMs = m_statisticsClock.elapsed();
+    if (elapsedMs < StatisticsIntervalMs)
+        return;
+
+    m_framesPerSecond = m_statisticsFrames * 1000.0 / elapsedMs;
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << "fps:" << m_framesPerSecond
+                    << "queue depth:" << queueDepth()
+                    << "frames written:" << m_framesWritten
+                    << "replaced:" << m_framesReplaced;
+
+    m_statisticsClock.restart();
+    m_statisticsFrames = 0;
+}
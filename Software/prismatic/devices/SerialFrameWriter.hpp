@@ -0,0 +1,103 @@
+/*
+ * SerialFrameWriter.hpp
+ *
+ *     Project: Prismatik
+ *
+ *  Lightpack is an open-source, USB content-driving ambient lighting
+ *  hardware.
+ *
+ *  Prismatik is a free, open-source software: you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as published
+ *  by the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Prismatik and Lightpack files is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+
+class QSerialPort;
+class QTimer;
+
+/*!
+  Writes frames to a serial port keeping at most one of them in flight.
+  A frame is in flight until the port has handed all of its bytes to the
+  system and the time it needs on the wire at the baud rate has passed.
+  Frames written meanwhile wait in a single slot, a newer one replaces the
+  one waiting there, so a slow port gets the freshest frame instead of a
+  growing backlog. Needs the event loop of the thread the port lives in.
+*/
+class SerialFrameWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SerialFrameWriter(QObject *parent = 0);
+
+    /*!
+      \param port open port to write to, NULL detaches from the current one
+      and drops the waiting frame
+    */
+    void setPort(QSerialPort *port);
+    /*!
+      \param baudRate paces frames by their time on the wire, 0 relies on
+      the port draining its buffer only
+    */
+    void setBaudRate(int baudRate);
+
+    /*!
+      Writes \a frame now or keeps it until the frame in flight is done
+      \return false if there is no open port or it refused the data
+    */
+    bool write(const QByteArray &frame);
+
+    /*!
+      Writes the waiting frame as soon as the one in flight is done and waits
+      until the port has handed all of it to the system, e.g. before closing
+      the port. Blocks without processing events.
+      \return false if there is no open port, a write failed or \a timeoutMs passed
+    */
+    bool flush(int timeoutMs);
+    // what devices give their last frames when they are closed
+    static const int CloseTimeoutMs = 500;
+
+    // frames not done yet, the one in flight and the waiting one
+    int queueDepth() const;
+    double framesPerSecond() const { return m_framesPerSecond; }
+    quint64 framesWritten() const { return m_framesWritten; }
+    quint64 framesReplaced() const { return m_framesReplaced; }
+
+    // msec \a bytes need on the wire at \a baudRate, 10 bits per byte with start and stop bits
+    static int wireTime(int bytes, int baudRate);
+
+private slots:
+    void writePending();
+
+private:
+    bool isBusy() const;
+    bool writeNow(const char *data, int size);
+    void updateStatistics();
+
+    QSerialPort *m_port;
+    int m_baudRate;
+    QTimer *m_wireTimer;
+
+    QByteArray m_pending;
+    bool m_hasPending;
+
+    QElapsedTimer m_statisticsClock;
+    int m_statisticsFrames;
+    double m_framesPerSecond;
+    quint64 m_framesWritten;
+    quint64 m_framesReplaced;
+};
@@ -68,11 +68,21 @@ enum GrabberType {
     GrabberTypeWinAPIEachWidget,
     GrabberTypeD3D9,
     GrabberTypeMacCoreGraphics,
+    GrabberTypeReplay,
 
     GrabbersCount,
 
     GrabberTypeDX10_11 //since d3d10 grabber works simultaneously with regular grabber we don't count it as others
 };
+
+// How GrabberBase turns grabbed pixels into per-area colors
+enum ReductionMode {
+    ReductionModePerArea,       // average every area on its own
+    ReductionModeIntegralImage, // summed-area tables over clusters of areas, O(1) per area
+    ReductionModeSparseSampling, // fixed budget of samples per area
+
+    ReductionModeDefault = ReductionModePerArea
+};
 }
 
 namespace SupportedDevices
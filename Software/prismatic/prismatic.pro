@@ -132,7 +132,7 @@ win32 {
 
 unix:!macx{
     # For X11 grabber
-    LIBS +=-lXext -lX11
+    LIBS +=-lXext -lX11 -lX11-xcb -lxcb -lxcb-shm -lXdamage -lXfixes
 }
 
 macx{
@@ -185,6 +185,7 @@ SOURCES += \
     ApiServerSetColorTask.cpp \
     MoodLampManager.cpp \
     LedDeviceManager.cpp \
+    LedDeviceMailbox.cpp \
     GrabManager.cpp \
     AbstractLedDevice.cpp \
     PluginsManager.cpp \
@@ -198,6 +199,9 @@ SOURCES += \
     devices/LedDeviceAdalight.cpp \
     devices/LedDeviceArdulight.cpp \
     devices/LedDeviceVirtual.cpp \
+    devices/BoardReportFilter.cpp \
+    devices/SerialFrameEncoder.cpp \
+    devices/SerialFrameWriter.cpp \
     wizard/ZoneWidget.cpp \
     wizard/ZonePlacementPage.cpp \
     wizard/Wizard.cpp \
@@ -242,6 +246,7 @@ HEADERS += \
     ../../CommonHeaders/USB_ID.h \
     MoodLampManager.hpp \
     LedDeviceManager.hpp \
+    LedDeviceMailbox.hpp \
     ../common/D3D10GrabberDefs.hpp \
     AbstractLedDevice.hpp \
     PluginsManager.hpp \
@@ -256,6 +261,9 @@ HEADERS += \
     devices/LedDeviceAdalight.hpp \
     devices/LedDeviceArdulight.hpp \
     devices/LedDeviceVirtual.hpp \
+    devices/BoardReportFilter.hpp \
+    devices/SerialFrameEncoder.hpp \
+    devices/SerialFrameWriter.hpp \
     wizard/ZoneWidget.hpp \
     wizard/ZonePlacementPage.hpp \
     wizard/Wizard.hpp \
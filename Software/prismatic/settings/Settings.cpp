@@ -136,9 +136,15 @@ static const QString Grabber = "Grab/Grabber";
 static const QString IsAvgColorsEnabled = "Grab/IsAvgColorsEnabled";
 static const QString IsSendDataOnlyIfColorsChanges = "Grab/IsSendDataOnlyIfColorsChanges";
 static const QString Slowdown = "Grab/Slowdown";
+static const QString IdleSlowdown = "Grab/IdleSlowdown";
 static const QString LuminosityThreshold = "Grab/LuminosityThreshold";
 static const QString IsMinimumLuminosityEnabled = "Grab/IsMinimumLuminosityEnabled";
 static const QString IsDx1011GrabberEnabled = "Grab/IsDX1011GrabberEnabled";
+static const QString ReductionMode = "Grab/ReductionMode";
+static const QString SampleBudget = "Grab/SampleBudget";
+static const QString ReductionThreads = "Grab/ReductionThreads";
+static const QString ReplayFile = "Grab/ReplayFile";
+static const QString ReplayFrameRate = "Grab/ReplayFrameRate";
 }
 // [MoodLamp]
 namespace MoodLamp
@@ -155,6 +161,8 @@ static const QString Smooth = "Device/Smooth";
 static const QString Brightness = "Device/Brightness";
 static const QString ColorDepth = "Device/ColorDepth";
 static const QString Gamma = "Device/Gamma";
+static const QString ColorLutFile = "Device/ColorLutFile";
+static const QString SmoothMode = "Device/SmoothMode";
 }
 // [LED_i]
 namespace Led
@@ -188,6 +196,22 @@ static const QString WinAPIEachWidget = "WinAPIEachWidget";
 static const QString X11 = "X11";
 static const QString D3D9 = "D3D9";
 static const QString MacCoreGraphics = "MacCoreGraphics";
+static const QString Replay = "Replay";
+}
+
+namespace ReductionMode
+{
+static const QString PerArea = "PerArea";
+static const QString IntegralImage = "IntegralImage";
+static const QString SparseSampling = "SparseSampling";
+}
+
+namespace SmoothMode
+{
+static const QString Off = "Off";
+static const QString Linear = "Linear";
+static const QString Exponential = "Exponential";
+static const QString CriticallyDamped = "CriticallyDamped";
 }
 
 } /*Value*/
@@ -259,6 +283,34 @@ inline int getValidGrabSlowdown(int value)
                        Profile::Grab::SlowdownMax);
 }
 
+inline int getValidGrabIdleSlowdown(int value)
+{
+    return clamp_value(value,
+                       Profile::Grab::IdleSlowdownMin,
+                       Profile::Grab::IdleSlowdownMax);
+}
+
+inline int getValidGrabSampleBudget(int value)
+{
+    return clamp_value(value,
+                       Profile::Grab::SampleBudgetMin,
+                       Profile::Grab::SampleBudgetMax);
+}
+
+inline int getValidGrabReductionThreads(int value)
+{
+    return clamp_value(value,
+                       Profile::Grab::ReductionThreadsMin,
+                       Profile::Grab::ReductionThreadsMax);
+}
+
+inline int getValidGrabReplayFrameRate(int value)
+{
+    return clamp_value(value,
+                       Profile::Grab::ReplayFrameRateMin,
+                       Profile::Grab::ReplayFrameRateMax);
+}
+
 inline int getValidMoodLampSpeed(int value)
 {
     return clamp_value(value,
@@ -349,8 +401,14 @@ public:
         setValue(Profile::Key::Grab::IsAvgColorsEnabled, Profile::Grab::IsAvgColorsEnabledDefault, resetDefault);
         setValue(Profile::Key::Grab::IsSendDataOnlyIfColorsChanges, Profile::Grab::IsSendDataOnlyIfColorsChangesDefault, resetDefault);
         setValue(Profile::Key::Grab::Slowdown,      Profile::Grab::SlowdownDefault, resetDefault);
+        setValue(Profile::Key::Grab::IdleSlowdown,  Profile::Grab::IdleSlowdownDefault, resetDefault);
         setValue(Profile::Key::Grab::LuminosityThreshold, Profile::Grab::MinimumLevelOfSensitivityDefault, resetDefault);
         setValue(Profile::Key::Grab::IsMinimumLuminosityEnabled, Profile::Grab::IsMinimumLuminosityEnabledDefault, resetDefault);
+        setValue(Profile::Key::Grab::ReductionMode, Profile::Grab::ReductionModeDefault, resetDefault);
+        setValue(Profile::Key::Grab::SampleBudget, Profile::Grab::SampleBudgetDefault, resetDefault);
+        setValue(Profile::Key::Grab::ReductionThreads, Profile::Grab::ReductionThreadsDefault, resetDefault);
+        setValue(Profile::Key::Grab::ReplayFile, Profile::Grab::ReplayFileDefault, resetDefault);
+        setValue(Profile::Key::Grab::ReplayFrameRate, Profile::Grab::ReplayFrameRateDefault, resetDefault);
         // [MoodLamp]
         setValue(Profile::Key::MoodLamp::IsLiquidMode,  Profile::MoodLamp::IsLiquidMode, resetDefault);
         setValue(Profile::Key::MoodLamp::Color,         Profile::MoodLamp::ColorDefault, resetDefault);
@@ -361,6 +419,8 @@ public:
         setValue(Profile::Key::Device::Smooth,      Profile::Device::SmoothDefault, resetDefault);
         setValue(Profile::Key::Device::Gamma,       Profile::Device::GammaDefault, resetDefault);
         setValue(Profile::Key::Device::ColorDepth,  Profile::Device::ColorDepthDefault, resetDefault);
+        setValue(Profile::Key::Device::ColorLutFile, Profile::Device::ColorLutFileDefault, resetDefault);
+        setValue(Profile::Key::Device::SmoothMode,  Profile::Device::SmoothModeDefault, resetDefault);
 
         for (int i = 0; i < MaximumNumberOfLeds::AbsoluteMaximum; i++)
         {
@@ -414,6 +474,11 @@ bool validateGrabberType(const QString& grabberTypeName, Grab::GrabberType& resu
     if (grabberTypeName == Profile::Value::GrabberType::MacCoreGraphics)
         grabberType = Grab::GrabberTypeMacCoreGraphics;
 #endif
+
+#ifdef REPLAY_GRAB_SUPPORT
+    if (grabberTypeName == Profile::Value::GrabberType::Replay)
+        grabberType = Grab::GrabberTypeReplay;
+#endif
     if (grabberType == Grab::GrabbersCount)
         resultType = Profile::Grab::GrabberDefault;
     else
@@ -723,6 +788,11 @@ int SettingsReader::getGrabSlowdown() const
     return getValidGrabSlowdown(m_profiles.value(Profile::Key::Grab::Slowdown).toInt());
 }
 
+int SettingsReader::getGrabIdleSlowdown() const
+{
+    return getValidGrabIdleSlowdown(m_profiles.value(Profile::Key::Grab::IdleSlowdown).toInt());
+}
+
 bool SettingsReader::isBacklightEnabled() const
 {
     return m_profiles.value(Profile::Key::IsBacklightEnabled).toBool();
@@ -773,6 +843,30 @@ double SettingsReader::getDeviceGamma() const
     return getValidDeviceGamma(m_profiles.value(Profile::Key::Device::Gamma).toDouble());
 }
 
+QString SettingsReader::getDeviceColorLutFile() const
+{
+    return m_profiles.value(Profile::Key::Device::ColorLutFile).toString();
+}
+
+TemporalInterpolator::Mode SettingsReader::getDeviceSmoothMode() const
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+
+    const QString strMode = m_profiles.value(Profile::Key::Device::SmoothMode).toString();
+    if (strMode == Profile::Value::SmoothMode::Off) {
+        return TemporalInterpolator::ModeOff;
+    } else if (strMode == Profile::Value::SmoothMode::Linear) {
+        return TemporalInterpolator::ModeLinear;
+    } else if (strMode == Profile::Value::SmoothMode::Exponential) {
+        return TemporalInterpolator::ModeExponential;
+    } else if (strMode == Profile::Value::SmoothMode::CriticallyDamped) {
+        return TemporalInterpolator::ModeCriticallyDamped;
+    } else {
+        qWarning() << Q_FUNC_INFO << "Read SmoothMode failed.";
+        return TemporalInterpolator::ModeOff;
+    }
+}
+
 Grab::GrabberType SettingsReader::getGrabberType() const
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
@@ -783,6 +877,43 @@ Grab::GrabberType SettingsReader::getGrabberType() const
     return grabberType;
 }
 
+Grab::ReductionMode SettingsReader::getGrabReductionMode() const
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+
+    const QString strMode = m_profiles.value(Profile::Key::Grab::ReductionMode).toString();
+    if (strMode == Profile::Value::ReductionMode::PerArea) {
+        return Grab::ReductionModePerArea;
+    } else if (strMode == Profile::Value::ReductionMode::IntegralImage) {
+        return Grab::ReductionModeIntegralImage;
+    } else if (strMode == Profile::Value::ReductionMode::SparseSampling) {
+        return Grab::ReductionModeSparseSampling;
+    } else {
+        qWarning() << Q_FUNC_INFO << "Read ReductionMode failed.";
+        return Grab::ReductionModeDefault;
+    }
+}
+
+int SettingsReader::getGrabSampleBudget() const
+{
+    return getValidGrabSampleBudget(m_profiles.value(Profile::Key::Grab::SampleBudget).toInt());
+}
+
+int SettingsReader::getGrabReductionThreads() const
+{
+    return getValidGrabReductionThreads(m_profiles.value(Profile::Key::Grab::ReductionThreads).toInt());
+}
+
+QString SettingsReader::getGrabReplayFile() const
+{
+    return m_profiles.value(Profile::Key::Grab::ReplayFile).toString();
+}
+
+int SettingsReader::getGrabReplayFrameRate() const
+{
+    return getValidGrabReplayFrameRate(m_profiles.value(Profile::Key::Grab::ReplayFrameRate).toInt());
+}
+
 #ifdef D3D10_GRAB_SUPPORT
 bool SettingsReader::isDx1011GrabberEnabled() const
 {
@@ -927,6 +1058,8 @@ Settings::Settings(const QString& applicationDirPath)
     m_currentProfile.init(applicationDir.absoluteFilePath(profileName + ".ini"), profileName);
 
     qRegisterMetaType<Grab::GrabberType>("Grab::GrabberType");
+    qRegisterMetaType<Grab::ReductionMode>("Grab::ReductionMode");
+    qRegisterMetaType<TemporalInterpolator::Mode>("TemporalInterpolator::Mode");
     qRegisterMetaType<QColor>("QColor");
     qRegisterMetaType<SupportedDevices::DeviceType>("SupportedDevices::DeviceType");
     qRegisterMetaType<Lightpack::Mode>("Lightpack::Mode");
@@ -1453,6 +1586,13 @@ void Settings::setGrabSlowdown(int value)
     this->grabSlowdownChanged(value);
 }
 
+void Settings::setGrabIdleSlowdown(int value)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+    m_currentProfile.setValue(Profile::Key::Grab::IdleSlowdown, getValidGrabIdleSlowdown(value));
+    this->grabIdleSlowdownChanged(getValidGrabIdleSlowdown(value));
+}
+
 void Settings::setIsBacklightEnabled(bool isEnabled)
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO;
@@ -1523,6 +1663,43 @@ void Settings::setDeviceGamma(double gamma)
     this->deviceGammaChanged(gamma);
 }
 
+void Settings::setDeviceColorLutFile(const QString &fileName)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << fileName;
+    m_currentProfile.setValue(Profile::Key::Device::ColorLutFile, fileName);
+    this->deviceColorLutFileChanged(fileName);
+}
+
+void Settings::setDeviceSmoothMode(TemporalInterpolator::Mode mode)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << mode;
+
+    if (mode == TemporalInterpolator::ModeOff)
+    {
+        m_currentProfile.setValue(Profile::Key::Device::SmoothMode, Profile::Value::SmoothMode::Off);
+        this->deviceSmoothModeChanged(mode);
+    }
+    else if (mode == TemporalInterpolator::ModeLinear)
+    {
+        m_currentProfile.setValue(Profile::Key::Device::SmoothMode, Profile::Value::SmoothMode::Linear);
+        this->deviceSmoothModeChanged(mode);
+    }
+    else if (mode == TemporalInterpolator::ModeExponential)
+    {
+        m_currentProfile.setValue(Profile::Key::Device::SmoothMode, Profile::Value::SmoothMode::Exponential);
+        this->deviceSmoothModeChanged(mode);
+    }
+    else if (mode == TemporalInterpolator::ModeCriticallyDamped)
+    {
+        m_currentProfile.setValue(Profile::Key::Device::SmoothMode, Profile::Value::SmoothMode::CriticallyDamped);
+        this->deviceSmoothModeChanged(mode);
+    }
+    else
+    {
+        qCritical() << Q_FUNC_INFO << "Invalid value =" << mode;
+    }
+}
+
 void Settings::setGrabberType(Grab::GrabberType grabberType)
 {
     DEBUG_LOW_LEVEL << Q_FUNC_INFO << grabberType;
@@ -1565,6 +1742,12 @@ void Settings::setGrabberType(Grab::GrabberType grabberType)
         break;
 #endif
 
+#ifdef REPLAY_GRAB_SUPPORT
+    case Grab::GrabberTypeReplay:
+        strGrabber = Profile::Value::GrabberType::Replay;
+        break;
+#endif
+
     default:
         qWarning() << Q_FUNC_INFO << "Switch on grabberType =" << grabberType << "failed. Reset to default value.";
         strGrabber = Profile::Grab::GrabberDefaultString;
@@ -1573,6 +1756,59 @@ void Settings::setGrabberType(Grab::GrabberType grabberType)
     this->grabberTypeChanged(grabberType);
 }
 
+void Settings::setGrabReductionMode(Grab::ReductionMode mode)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO << mode;
+
+    if (mode == Grab::ReductionModePerArea)
+    {
+        m_currentProfile.setValue(Profile::Key::Grab::ReductionMode, Profile::Value::ReductionMode::PerArea);
+        this->grabReductionModeChanged(mode);
+    }
+    else if (mode == Grab::ReductionModeIntegralImage)
+    {
+        m_currentProfile.setValue(Profile::Key::Grab::ReductionMode, Profile::Value::ReductionMode::IntegralImage);
+        this->grabReductionModeChanged(mode);
+    }
+    else if (mode == Grab::ReductionModeSparseSampling)
+    {
+        m_currentProfile.setValue(Profile::Key::Grab::ReductionMode, Profile::Value::ReductionMode::SparseSampling);
+        this->grabReductionModeChanged(mode);
+    }
+    else
+    {
+        qCritical() << Q_FUNC_INFO << "Invalid value =" << mode;
+    }
+}
+
+void Settings::setGrabSampleBudget(int value)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+    m_currentProfile.setValue(Profile::Key::Grab::SampleBudget, getValidGrabSampleBudget(value));
+    this->grabSampleBudgetChanged(getValidGrabSampleBudget(value));
+}
+
+void Settings::setGrabReductionThreads(int value)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+    m_currentProfile.setValue(Profile::Key::Grab::ReductionThreads, getValidGrabReductionThreads(value));
+    this->grabReductionThreadsChanged(getValidGrabReductionThreads(value));
+}
+
+void Settings::setGrabReplayFile(const QString &fileName)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+    m_currentProfile.setValue(Profile::Key::Grab::ReplayFile, fileName);
+    this->grabReplayFileChanged(fileName);
+}
+
+void Settings::setGrabReplayFrameRate(int value)
+{
+    DEBUG_LOW_LEVEL << Q_FUNC_INFO;
+    m_currentProfile.setValue(Profile::Key::Grab::ReplayFrameRate, getValidGrabReplayFrameRate(value));
+    this->grabReplayFrameRateChanged(getValidGrabReplayFrameRate(value));
+}
+
 #ifdef D3D10_GRAB_SUPPORT
 void Settings::setDx1011GrabberEnabled(bool isEnabled)
 {
@@ -132,6 +132,7 @@ public:
 
     // Profile
     void setGrabSlowdown(int value);
+    void setGrabIdleSlowdown(int value);
     void setIsBacklightEnabled(bool isEnabled);
     void setGrabAvgColorsEnabled(bool isEnabled);
     void setSendDataOnlyIfColorsChanges(bool isEnabled);
@@ -144,8 +145,15 @@ public:
     void setDeviceSmooth(int value);
     void setDeviceColorDepth(int value);
     void setDeviceGamma(double gamma);
+    void setDeviceColorLutFile(const QString &fileName);
+    void setDeviceSmoothMode(TemporalInterpolator::Mode mode);
 
     void setGrabberType(Grab::GrabberType grabMode);
+    void setGrabReductionMode(Grab::ReductionMode mode);
+    void setGrabSampleBudget(int value);
+    void setGrabReductionThreads(int value);
+    void setGrabReplayFile(const QString &fileName);
+    void setGrabReplayFrameRate(int value);
 
 #ifdef D3D10_GRAB_SUPPORT
     void setDx1011GrabberEnabled(bool isEnabled);
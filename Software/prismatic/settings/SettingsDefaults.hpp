@@ -140,9 +140,28 @@ static const QString GrabberDefaultString = GRABMODE_DEFAULT_STR;
 static const bool IsAvgColorsEnabledDefault = false;
 static const bool IsSendDataOnlyIfColorsChangesDefault = true;
 static const bool IsMinimumLuminosityEnabledDefault = true;
+static const QString ReductionModeDefault = "PerArea";
+static const int SampleBudgetMin = 16;
+static const int SampleBudgetDefault = 256;
+static const int SampleBudgetMax = 16384;
+// 0 means one thread per CPU core
+static const int ReductionThreadsMin = 0;
+static const int ReductionThreadsDefault = 0;
+static const int ReductionThreadsMax = 64;
+// raw frames for the Replay grabber, see ReplayGrabber.hpp
+static const QString ReplayFileDefault = "";
+// 0 means as fast as possible
+static const int ReplayFrameRateMin = 0;
+static const int ReplayFrameRateDefault = 0;
+static const int ReplayFrameRateMax = 1000;
 static const int SlowdownMin = 1;
 static const int SlowdownDefault = 50;
 static const int SlowdownMax = 1000;
+// static content is grabbed this slow, not above Slowdown turns it off, so
+// the default keeps it off whatever Slowdown is
+static const int IdleSlowdownMin = SlowdownMin;
+static const int IdleSlowdownDefault = IdleSlowdownMin;
+static const int IdleSlowdownMax = SlowdownMax;
 static const int MinimumLevelOfSensitivityMin = 0;
 static const int MinimumLevelOfSensitivityDefault = 3;
 static const int MinimumLevelOfSensitivityMax = 100;
@@ -178,6 +197,13 @@ static const int ColorDepthMax = 255;
 static const double GammaMin = 0.01;
 static const double GammaDefault = 2.0;
 static const double GammaMax = 10.0;
+
+// .cube file replacing white balance, gamma and luminosity threshold, off when empty
+static const QString ColorLutFileDefault = "";
+
+// how Adalight, Ardulight and Virtual devices move between colors, Smooth is the time.
+// Off, as Smooth of older profiles was meant for Lightpack firmware only
+static const QString SmoothModeDefault = "Off";
 }
 // [LED_i]
 namespace Led
@@ -32,6 +32,7 @@
 
 #include "enums.hpp"
 #include "types.h"
+#include "TemporalInterpolator.hpp"
 #include "BaseVersion.hpp"
 
 namespace SettingsScope {
@@ -78,6 +79,7 @@ public:
 
     // Profile
     int getGrabSlowdown() const;
+    int getGrabIdleSlowdown() const;
     bool isBacklightEnabled() const;
     bool isGrabAvgColorsEnabled() const;
     bool isSendDataOnlyIfColorsChanges() const;
@@ -90,8 +92,15 @@ public:
     int getDeviceSmooth() const;
     int getDeviceColorDepth() const;
     double getDeviceGamma() const;
+    QString getDeviceColorLutFile() const;
+    TemporalInterpolator::Mode getDeviceSmoothMode() const;
 
     Grab::GrabberType getGrabberType() const;
+    Grab::ReductionMode getGrabReductionMode() const;
+    int getGrabSampleBudget() const;
+    int getGrabReductionThreads() const;
+    QString getGrabReplayFile() const;
+    int getGrabReplayFrameRate() const;
 
 #ifdef D3D10_GRAB_SUPPORT
     bool isDx1011GrabberEnabled() const;
@@ -32,6 +32,7 @@
 #include <QString>
 
 #include "enums.hpp"
+#include "TemporalInterpolator.hpp"
 
 namespace SettingsScope {
 
@@ -68,6 +69,7 @@ signals:
     void ardulightNumberOfLedsChanged(int numberOfLeds);
     void virtualNumberOfLedsChanged(int numberOfLeds);
     void grabSlowdownChanged(int value);
+    void grabIdleSlowdownChanged(int value);
     void backlightEnabledChanged(bool isEnabled);
     void grabAvgColorsEnabledChanged(bool isEnabled);
     void sendDataOnlyIfColorsChangesChanged(bool isEnabled);
@@ -78,8 +80,15 @@ signals:
     void deviceSmoothChanged(int value);
     void deviceColorDepthChanged(int value);
     void deviceGammaChanged(double gamma);
+    void deviceColorLutFileChanged(const QString &fileName);
+    void deviceSmoothModeChanged(const TemporalInterpolator::Mode mode);
     void deviceColorSequenceChanged(QString value);
     void grabberTypeChanged(const Grab::GrabberType grabMode);
+    void grabReductionModeChanged(const Grab::ReductionMode mode);
+    void grabSampleBudgetChanged(int value);
+    void grabReductionThreadsChanged(int value);
+    void grabReplayFileChanged(const QString &fileName);
+    void grabReplayFrameRateChanged(int value);
     void dx1011GrabberEnabledChanged(const bool isEnabled);
     void lightpackModeChanged(const Lightpack::Mode mode);
     void moodLampLiquidModeChanged(bool isLiquidMode);
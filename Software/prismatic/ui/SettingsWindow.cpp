@@ -245,6 +245,9 @@ void SettingsWindow::connectSignalsSlots()
 #ifdef MAC_OS_CG_GRAB_SUPPORT
     connect(ui->radioButton_GrabMacCoreGraphics, SIGNAL(toggled(bool)), this, SLOT(onGrabberChanged()));
 #endif
+#ifdef REPLAY_GRAB_SUPPORT
+    connect(ui->radioButton_GrabReplay, SIGNAL(toggled(bool)), this, SLOT(onGrabberChanged()));
+#endif
 #ifdef D3D10_GRAB_SUPPORT
     connect(ui->checkBox_EnableDx1011Capture, SIGNAL(toggled(bool)), this, SLOT(onDx1011CaptureEnabledChanged(bool)));
 #endif
@@ -773,6 +776,9 @@ void SettingsWindow::initGrabbersRadioButtonsVisibility()
 #else
     ui->radioButton_GrabMacCoreGraphics->setChecked(true);
 #endif
+#ifndef REPLAY_GRAB_SUPPORT
+    ui->radioButton_GrabReplay->setVisible(false);
+#endif
 #ifndef QT_GRAB_SUPPORT
     ui->radioButton_GrabQt->setVisible(false);
     ui->radioButton_GrabQt_EachWidget->setVisible(false);
@@ -1615,6 +1621,11 @@ void SettingsWindow::updateUiFromSettings()
     case Grab::GrabberTypeMacCoreGraphics:
         ui->radioButton_GrabMacCoreGraphics->setChecked(true);
         break;
+#endif
+#ifdef REPLAY_GRAB_SUPPORT
+    case Grab::GrabberTypeReplay:
+        ui->radioButton_GrabReplay->setChecked(true);
+        break;
 #endif
     case Grab::GrabberTypeQtEachWidget:
         ui->radioButton_GrabQt_EachWidget->setChecked(true);
@@ -1659,6 +1670,11 @@ Grab::GrabberType SettingsWindow::getSelectedGrabberType()
         return Grab::GrabberTypeMacCoreGraphics;
     }
 #endif
+#ifdef REPLAY_GRAB_SUPPORT
+    if (ui->radioButton_GrabReplay->isChecked()) {
+        return Grab::GrabberTypeReplay;
+    }
+#endif
 
     if (ui->radioButton_GrabQt_EachWidget->isChecked()) {
         return Grab::GrabberTypeQtEachWidget;
@@ -20,12 +20,14 @@
  *
  */
 
+#include <vector>
 #include <QColor>
 #include <QRgb>
 #include <QRect>
 
 #include "enums.hpp"
 #include "calculations.hpp"
+#include "SummedAreaTable.hpp"
 #include "gtest/gtest.h"
 
 TEST(GrabCalculationTest, AvgColor) {
@@ -39,3 +41,161 @@ TEST(GrabCalculationTest, AvgColor) {
     EXPECT_EQ(qRgb(0xfa, 0xfa, 0xfa), color)
         << "Failure. calculateAvgColor returned wrong errorcode " << result;
 }
+
+TEST(GrabCalculationTest, KernelsMatchScalar) {
+    using namespace Grab::Calculations;
+
+    const int kScreenWidth = 67;
+    const int kScreenHeight = 23;
+    const unsigned int kPitch = kScreenWidth * 4;
+    std::vector<unsigned char> buffer(kPitch * kScreenHeight);
+    srand(42);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = rand() & 0xff;
+
+    const QRect rects[] = {
+        QRect(0, 0, 4, 1),
+        QRect(1, 2, 8, 3),
+        QRect(3, 0, 12, 23),
+        QRect(5, 7, 36, 9),
+        QRect(0, 0, 64, 23),
+        QRect(2, 1, 60, 20)
+    };
+    const BufferFormat formats[] = {
+        BufferFormatUnknown,
+        BufferFormatArgb,
+        BufferFormatBgra,
+        BufferFormatRgba,
+        BufferFormatAbgr,
+        BufferFormatRgbg
+    };
+
+    EXPECT_TRUE(isKernelSupported(KernelScalar));
+    EXPECT_TRUE(isKernelSupported(bestSupportedKernel()));
+
+    for (int kernel = KernelScalar + 1; kernel < KernelsCount; ++kernel) {
+        if (!isKernelSupported(static_cast<AccumulationKernel>(kernel)))
+            continue;
+
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+            for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); ++r) {
+                QRgb expected = 0, actual = 0;
+                const QRgb expectedReturn = calculateAvgColor(
+                    &expected, buffer.data(), formats[f], kPitch, rects[r], KernelScalar);
+                const QRgb actualReturn = calculateAvgColor(
+                    &actual, buffer.data(), formats[f], kPitch, rects[r],
+                    static_cast<AccumulationKernel>(kernel));
+                EXPECT_EQ(expectedReturn, actualReturn)
+                    << "kernel " << kernel << ", format " << formats[f] << ", rect " << r;
+                EXPECT_EQ(expected, actual)
+                    << "kernel " << kernel << ", format " << formats[f] << ", rect " << r;
+            }
+        }
+    }
+}
+
+TEST(GrabCalculationTest, SummedAreaTableMatchesAvgColor) {
+    using Grab::Calculations::calculateAvgColor;
+
+    const int kScreenWidth = 64;
+    const int kScreenHeight = 32;
+    const unsigned int kPitch = kScreenWidth * 4;
+    std::vector<unsigned char> buffer(kPitch * kScreenHeight);
+    srand(7);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = rand() & 0xff;
+
+    const QRect bounds(2, 1, 60, 30);
+    const QRect rects[] = {
+        QRect(2, 1, 4, 1),
+        QRect(10, 5, 16, 10),
+        QRect(2, 1, 60, 30),
+        QRect(58, 28, 4, 3)
+    };
+
+    Grab::SummedAreaTable table;
+    EXPECT_FALSE(table.build(buffer.data(), BufferFormatRgbg, kPitch, bounds));
+    EXPECT_FALSE(table.isValid());
+
+    const BufferFormat formats[] = {
+        BufferFormatArgb, BufferFormatBgra, BufferFormatRgba, BufferFormatAbgr
+    };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        ASSERT_TRUE(table.build(buffer.data(), formats[f], kPitch, bounds));
+        for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); ++r) {
+            QRgb expected = 0, actual = 0;
+            calculateAvgColor(&expected, buffer.data(), formats[f], kPitch, rects[r]);
+            table.calculateAvgColor(&actual, rects[r]);
+            EXPECT_EQ(expected, actual) << "format " << formats[f] << ", rect " << r;
+        }
+    }
+}
+
+TEST(GrabCalculationTest, SamplePatternRespectsBudget) {
+    using Grab::Calculations::SamplePattern;
+    using Grab::Calculations::calculateAvgColor;
+
+    const int kScreenWidth = 64;
+    const int kScreenHeight = 32;
+    const unsigned int kPitch = kScreenWidth * 4;
+    std::vector<unsigned char> buffer(kPitch * kScreenHeight);
+    srand(11);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = rand() & 0xff;
+
+    // area fits into the budget: every pixel is sampled
+    const QRect smallRect(4, 2, 8, 4);
+    SamplePattern pattern;
+    EXPECT_TRUE(pattern.update(kPitch, smallRect, 64));
+    EXPECT_FALSE(pattern.update(kPitch, smallRect, 64));
+    EXPECT_EQ(32, pattern.offsets().size());
+
+    QRgb expected = 0, actual = 0;
+    calculateAvgColor(&expected, buffer.data(), BufferFormatArgb, kPitch, smallRect);
+    calculateAvgColor(&actual, buffer.data(), BufferFormatArgb, pattern);
+    EXPECT_EQ(expected, actual);
+
+    // area exceeds the budget: samples stay inside the area
+    const QRect largeRect(3, 1, 60, 30);
+    EXPECT_TRUE(pattern.update(kPitch, largeRect, 64));
+    EXPECT_GT(pattern.offsets().size(), 0);
+    EXPECT_LE(pattern.offsets().size(), 64);
+    for (int i = 0; i < pattern.offsets().size(); ++i) {
+        const unsigned int offset = pattern.offsets()[i];
+        const QPoint pixel((offset % kPitch) / 4, offset / kPitch);
+        EXPECT_TRUE(largeRect.contains(pixel)) << "sample " << i;
+    }
+
+    EXPECT_EQ(static_cast<QRgb>(-1), calculateAvgColor(&actual, buffer.data(), BufferFormatUnknown, pattern));
+}
+
+TEST(GrabCalculationTest, BandSumsMatchAvgColor) {
+    using namespace Grab::Calculations;
+
+    const int kScreenWidth = 64;
+    const int kScreenHeight = 32;
+    const unsigned int kPitch = kScreenWidth * 4;
+    std::vector<unsigned char> buffer(kPitch * kScreenHeight);
+    srand(13);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = rand() & 0xff;
+
+    const QRect rect(4, 3, 40, 27);
+    QRgb expected = 0, actual = 0;
+    calculateAvgColor(&expected, buffer.data(), BufferFormatBgra, kPitch, rect);
+
+    // uneven bands, the way GrabberBase splits large areas between threads
+    ColorSums sums;
+    int top = 0;
+    const int bandHeights[] = {1, 7, 10, 9};
+    for (size_t band = 0; band < sizeof(bandHeights) / sizeof(bandHeights[0]); ++band) {
+        const QRect bandRect(rect.x(), rect.y() + top, rect.width(), bandHeights[band]);
+        EXPECT_TRUE(accumulateColor(&sums, buffer.data(), BufferFormatBgra, kPitch, bandRect));
+        top += bandHeights[band];
+    }
+    EXPECT_EQ(rect.width() * rect.height(), sums.count);
+    averageColor(&actual, sums);
+    EXPECT_EQ(expected, actual);
+
+    EXPECT_FALSE(accumulateColor(&sums, buffer.data(), BufferFormatUnknown, kPitch, rect));
+}
@@ -1,5 +1,19 @@
+#include <vector>
+#include <QTemporaryFile>
+#include <QThread>
 #include "GrabberContext.hpp"
+#include "GrabbedArea.hpp"
+#include "ReductionPool.hpp"
+#include "CaptureRegions.hpp"
+#include "ColorsTripleBuffer.hpp"
+#include "FramePacer.hpp"
+#include "ReplayGrabber.hpp"
 #include "gtest/gtest.h"
+#ifdef X11_GRAB_SUPPORT
+// after gtest, Xlib macros clash with its names
+#include <X11/Xlib.h>
+#include "X11Grabber.hpp"
+#endif
 
 TEST(GrabTests, GrabContextTest) {
     GrabberContext context;
@@ -16,3 +30,324 @@ TEST(GrabTests, GrabContextTest) {
     context.freeReleasedBufs();
     EXPECT_EQ(context.buffersCount(), 0);
 }
+
+namespace {
+class CountingTask : public Grab::ParallelTask {
+public:
+    explicit CountingTask(int jobsCount) : runs(jobsCount, 0) {}
+    virtual void run(int jobIndex) { ++runs[jobIndex]; }
+    std::vector<int> runs;
+};
+}
+
+TEST(GrabTests, ReductionPoolRunsEveryJobOnce) {
+    Grab::ReductionPool pool;
+    const int threadsCounts[] = {1, 2, 4, 0};
+    for (size_t t = 0; t < sizeof(threadsCounts) / sizeof(threadsCounts[0]); ++t) {
+        pool.setThreadsCount(threadsCounts[t]);
+        EXPECT_GE(pool.threadsCount(), 1);
+
+        for (int frame = 0; frame < 10; ++frame) {
+            CountingTask task(1000);
+            pool.run(1000, &task);
+            for (int i = 0; i < 1000; ++i)
+                ASSERT_EQ(1, task.runs[i]) << "threads " << threadsCounts[t] << ", job " << i;
+        }
+    }
+}
+
+TEST(GrabTests, CaptureRegionsKeepEdgeStrips) {
+    // 1920x1080 screen with 10 areas along the top and bottom edges and 5
+    // along the left and right ones, corners overlap
+    QList<QRect> areas;
+    for (int i = 0; i < 10; ++i) {
+        areas.append(QRect(i * 192, 0, 192, 108));
+        areas.append(QRect(i * 192, 972, 192, 108));
+    }
+    for (int i = 0; i < 5; ++i) {
+        areas.append(QRect(0, i * 216, 192, 216));
+        areas.append(QRect(1728, i * 216, 192, 216));
+    }
+
+    const QList<QRect> regions = Grab::captureRegions(areas, 8);
+    EXPECT_LE(regions.size(), 8);
+
+    qint64 capturedPixels = 0;
+    for (int r = 0; r < regions.size(); ++r)
+        capturedPixels += static_cast<qint64>(regions[r].width()) * regions[r].height();
+    EXPECT_LT(capturedPixels, 1920 * 1080 / 2);
+
+    for (int i = 0; i < areas.size(); ++i) {
+        bool isCovered = false;
+        for (int r = 0; r < regions.size(); ++r)
+            isCovered = isCovered || regions[r].contains(areas[i]);
+        EXPECT_TRUE(isCovered) << "area " << i;
+    }
+
+    EXPECT_EQ(1, Grab::captureRegions(areas, 1).size());
+    EXPECT_TRUE(Grab::captureRegions(QList<QRect>(), 8).isEmpty());
+}
+
+TEST(GrabTests, ColorsTripleBufferKeepsLatestFrame) {
+    Grab::ColorsTripleBuffer buffer(4);
+    EXPECT_FALSE(buffer.fetch());
+
+    for (int frame = 1; frame <= 3; ++frame) {
+        QRgb *colors = buffer.writeBuffer();
+        for (int i = 0; i < frame; ++i)
+            colors[i] = qRgb(frame, i, 0);
+        buffer.publish(frame);
+    }
+
+    ASSERT_TRUE(buffer.fetch());
+    ASSERT_EQ(3, buffer.readCount());
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(qRgb(3, i, 0), buffer.readBuffer()[i]);
+    EXPECT_FALSE(buffer.fetch());
+    EXPECT_EQ(3, buffer.readCount());
+}
+
+namespace {
+class FramesWriter : public QThread {
+public:
+    FramesWriter(Grab::ColorsTripleBuffer *buffer, int framesCount)
+        : m_buffer(buffer), m_framesCount(framesCount) {}
+protected:
+    virtual void run() {
+        for (int frame = 1; frame <= m_framesCount; ++frame) {
+            QRgb *colors = m_buffer->writeBuffer();
+            for (int i = 0; i < m_buffer->capacity(); ++i)
+                colors[i] = frame;
+            m_buffer->publish(m_buffer->capacity());
+        }
+    }
+private:
+    Grab::ColorsTripleBuffer *m_buffer;
+    int m_framesCount;
+};
+}
+
+TEST(GrabTests, ColorsTripleBufferHandsOverWholeFrames) {
+    const int framesCount = 100000;
+    Grab::ColorsTripleBuffer buffer(64);
+    FramesWriter writer(&buffer, framesCount);
+    writer.start();
+
+    QRgb lastFrame = 0;
+    bool isWriterFinished = false;
+    while (!isWriterFinished) {
+        isWriterFinished = writer.isFinished();
+        if (!buffer.fetch())
+            continue;
+        const QRgb *colors = buffer.readBuffer();
+        ASSERT_EQ(64, buffer.readCount());
+        ASSERT_GT(colors[0], lastFrame);
+        for (int i = 1; i < 64; ++i)
+            ASSERT_EQ(colors[0], colors[i]) << "torn frame " << colors[0];
+        lastFrame = colors[0];
+    }
+    writer.wait();
+    EXPECT_EQ(static_cast<QRgb>(framesCount), lastFrame);
+}
+
+TEST(GrabTests, FramePacerSlowsDownOnStaticContent) {
+    Grab::FramePacer pacer;
+    pacer.setBounds(20, 200);
+    EXPECT_EQ(20, pacer.update(2.0, 255));
+
+    // short pauses keep the rate
+    for (int i = 0; i < Grab::FramePacer::StaticFramesToSlowDown; ++i)
+        EXPECT_EQ(20, pacer.update(2.0, 0));
+
+    int interval = pacer.interval();
+    for (int i = 0; i < 100; ++i) {
+        const int next = pacer.update(2.0, i % 2);
+        EXPECT_GE(next, interval);
+        interval = next;
+    }
+    EXPECT_EQ(200, interval);
+
+    // motion ramps up at once
+    EXPECT_EQ(20, pacer.update(2.0, Grab::FramePacer::MotionThreshold));
+}
+
+TEST(GrabTests, FramePacerKeepsRoomForFrameCost) {
+    Grab::FramePacer pacer;
+    pacer.setBounds(5, 100);
+    int interval = 0;
+    for (int i = 0; i < 100; ++i)
+        interval = pacer.update(40.0, 255);
+    EXPECT_EQ(50, interval);
+
+    // costs over the idle bound are capped by it
+    for (int i = 0; i < 100; ++i)
+        interval = pacer.update(400.0, 255);
+    EXPECT_EQ(100, interval);
+
+    // no idle bound above the grab interval keeps it fixed
+    pacer.setBounds(30, 0);
+    EXPECT_EQ(30, pacer.update(0.0, 0));
+    EXPECT_EQ(30, pacer.interval());
+}
+
+namespace {
+class TestArea : public GrabbedArea {
+public:
+    explicit TestArea(const QRect &rect) : m_rect(rect) {}
+    virtual bool isEnabled() const { return true; }
+    virtual QRect geometry() const { return m_rect; }
+private:
+    QRect m_rect;
+};
+}
+
+#ifdef REPLAY_GRAB_SUPPORT
+namespace {
+class TestReplayGrabber : public ReplayGrabber {
+public:
+    explicit TestReplayGrabber(GrabberContext *context) : ReplayGrabber(NULL, context) {}
+    GrabResult lastGrabResult() const { return _lastGrabResult; }
+};
+
+// frames of solid colors, rows padded to 48 bytes
+void writeReplay(QIODevice *file, const QList<QRgb> &frameColors)
+{
+    const int width = 8, height = 4, pitch = 48;
+    Grab::ReplayFileHeader header;
+    header.init(width, height, pitch, BufferFormatArgb, frameColors.size());
+    file->write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (int f = 0; f < frameColors.size(); ++f) {
+        QByteArray frame(pitch * height, '\xff');
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                char *pixel = frame.data() + y * pitch + x * 4;
+                pixel[0] = qBlue(frameColors[f]);
+                pixel[1] = qGreen(frameColors[f]);
+                pixel[2] = qRed(frameColors[f]);
+                pixel[3] = 0;
+            }
+        }
+        file->write(frame);
+    }
+}
+}
+
+TEST(GrabTests, ReplayGrabberServesFramesInOrder) {
+    QTemporaryFile file;
+    ASSERT_TRUE(file.open());
+    QList<QRgb> frameColors;
+    frameColors << qRgb(255, 0, 0) << qRgb(0, 0, 255) << qRgb(0, 128, 0);
+    writeReplay(&file, frameColors);
+    file.flush();
+
+    TestArea area(QRect(0, 0, 8, 4));
+    GrabberBase::GrabbedAreas areas;
+    areas.append(&area);
+    GrabberContext context(16);
+    context.updateGrabbedAreas(areas);
+
+    TestReplayGrabber grabber(&context);
+    ASSERT_TRUE(grabber.setReplayFile(file.fileName()));
+    EXPECT_EQ(3, grabber.framesCount());
+
+    // as fast as possible serves every frame once and loops over the file
+    for (int i = 0; i < 7; ++i) {
+        grabber.grab();
+        ASSERT_EQ(GrabResultOk, grabber.lastGrabResult());
+        EXPECT_EQ(i % 3, grabber.currentFrame());
+        ASSERT_TRUE(context.grabbedColors.fetch());
+        ASSERT_EQ(1, context.grabbedColors.readCount());
+        EXPECT_EQ(frameColors[i % 3], context.grabbedColors.readBuffer()[0]) << "grab " << i;
+    }
+}
+
+TEST(GrabTests, ReplayGrabberRejectsTruncatedFile) {
+    QTemporaryFile file;
+    ASSERT_TRUE(file.open());
+    QList<QRgb> frameColors;
+    frameColors << qRgb(255, 0, 0) << qRgb(0, 0, 255);
+    writeReplay(&file, frameColors);
+    file.flush();
+    file.resize(file.size() - 1);
+
+    GrabberContext context(16);
+    ReplayGrabber grabber(NULL, &context);
+    EXPECT_FALSE(grabber.setReplayFile(file.fileName()));
+    EXPECT_EQ(0, grabber.framesCount());
+    EXPECT_FALSE(grabber.setReplayFile(file.fileName() + ".missing"));
+}
+
+TEST(GrabTests, ReplayHeaderRejectsUnsupportedLayouts) {
+    Grab::ReplayFileHeader header;
+    header.init(8, 4, 48, BufferFormatArgb, 2);
+    const qint64 fileSize = sizeof(header) + 2 * 48 * 4;
+    EXPECT_TRUE(header.isValid(fileSize));
+
+    // no reduction path handles it
+    header.init(8, 4, 48, BufferFormatRgbg, 2);
+    EXPECT_FALSE(header.isValid(fileSize));
+
+    // pitch * height overflows 32 bits
+    header.init(8, 0x10000, 0x10000, BufferFormatArgb, 1);
+    EXPECT_FALSE(header.isValid(fileSize));
+    header.height = 0x80000000u;
+    EXPECT_FALSE(header.isValid(fileSize));
+}
+#endif // REPLAY_GRAB_SUPPORT
+
+#ifdef X11_GRAB_SUPPORT
+namespace {
+class TestX11Grabber : public X11Grabber {
+public:
+    explicit TestX11Grabber(GrabberContext *context) : X11Grabber(NULL, context) {}
+    GrabResult lastGrabResult() const { return _lastGrabResult; }
+};
+}
+
+// Needs an X server with DAMAGE extension and 24 bit root window, so it is
+// run on request only, e.g.
+// xvfb-run -s "-screen 0 640x480x24" ./LightpackTests --gtest_also_run_disabled_tests
+TEST(GrabTests, DISABLED_X11GrabberSkipsUndamagedFrames) {
+    Display *display = XOpenDisplay(NULL);
+    ASSERT_TRUE(display != NULL) << "no X display";
+
+    TestArea area(QRect(0, 0, 64, 32));
+    GrabberBase::GrabbedAreas areas;
+    areas.append(&area);
+    GrabberContext context(16);
+    context.updateGrabbedAreas(areas);
+    Grab::ColorsTripleBuffer &colors = context.grabbedColors;
+
+    TestX11Grabber grabber(&context);
+    grabber.grab();
+    EXPECT_EQ(GrabResultOk, grabber.lastGrabResult());
+    ASSERT_TRUE(colors.fetch());
+    ASSERT_EQ(1, colors.readCount());
+
+    // drain damage of the server startup and the frame prefetched in the
+    // meantime, a static screen has to settle within a few ticks
+    XSync(display, False);
+    for (int i = 0; i < 5 && grabber.lastGrabResult() == GrabResultOk; ++i)
+        grabber.grab();
+    EXPECT_EQ(GrabResultFrameNotReady, grabber.lastGrabResult());
+
+    const Window root = DefaultRootWindow(display);
+    GC gc = XCreateGC(display, root, 0, NULL);
+    XSetSubwindowMode(display, gc, IncludeInferiors);
+    XSetForeground(display, gc, 0x00ff0000);
+    XFillRectangle(display, root, gc, 0, 0, 64, 32);
+    XSync(display, False);
+
+    grabber.grab();
+    EXPECT_EQ(GrabResultOk, grabber.lastGrabResult());
+    ASSERT_TRUE(colors.fetch());
+    ASSERT_EQ(1, colors.readCount());
+    EXPECT_EQ(255, qRed(colors.readBuffer()[0]));
+    EXPECT_EQ(0, qGreen(colors.readBuffer()[0]));
+    EXPECT_EQ(0, qBlue(colors.readBuffer()[0]));
+
+    XFreeGC(display, gc);
+    XCloseDisplay(display);
+}
+#endif // X11_GRAB_SUPPORT
@@ -0,0 +1,357 @@
+#include <cmath>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTemporaryFile>
+#include "AbstractLedDevice.hpp"
+#include "LedDeviceMailbox.hpp"
+#include "devices/BoardReportFilter.hpp"
+#include "PrismatikMath.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+// Device keeping the 12 bit colors applyColorModifications() gives it
+class FakeLedDevice : public AbstractLedDevice {
+public:
+    FakeLedDevice() : AbstractLedDevice(NULL) {
+        m_gamma = 2.0;
+        m_brightness = 100;
+        m_luminosityThreshold = 0;
+        m_isMinimumLuminosityEnabled = false;
+    }
+
+    const QString name() const { return "fake"; }
+    void open() { emit openDeviceSuccess(true); }
+    void close() {}
+    void setColors(const QList<QRgb> &colors) {
+        if (colors.size() > 0) {
+            m_colorsSaved = colors;
+            m_colorsBuffer.resize(colors.count());
+            applyColorModifications(colors, m_colorsBuffer);
+        }
+        emit commandCompleted(true);
+    }
+    void switchOffLeds() {}
+    void setRefreshDelay(int) {}
+    void setSmoothSlowdown(int) {}
+    void setColorSequence(QString) {}
+    void requestFirmwareVersion() {}
+    size_t maxLedsCount() { return 1000; }
+    size_t defaultLedsCount() { return 10; }
+    void setColorDepth(int) {}
+
+    const RgbBuffer & colors() const { return m_colorsBuffer; }
+};
+
+struct DeviceSettings {
+    double gamma;
+    int brightness;
+    int luminosityThreshold;
+    bool isMinimumLuminosityEnabled;
+    QList<WBAdjustment> wbAdjustments;
+    QString colorLutFile;
+};
+
+void applySettings(FakeLedDevice *device, const DeviceSettings &settings) {
+    device->setGamma(settings.gamma);
+    device->setBrightness(settings.brightness);
+    device->setLuminosityThreshold(settings.luminosityThreshold);
+    device->setMinimumLuminosityThresholdEnabled(settings.isMinimumLuminosityEnabled);
+    device->updateWBAdjustments(settings.wbAdjustments);
+    device->setColorLutFile(settings.colorLutFile);
+}
+
+// frames where a few LEDs change from one to the next, some repeat as they are
+QList<QList<QRgb> > makeFrames(int ledsCount, int framesCount) {
+    QList<QList<QRgb> > frames;
+    QList<QRgb> frame;
+    unsigned seed = 12345;
+    for (int i = 0; i < ledsCount; ++i) {
+        seed = seed * 1103515245 + 12345;
+        frame << (seed >> 8 & 0xffffff);
+    }
+    for (int f = 0; f < framesCount; ++f) {
+        if (f % 4 != 3) {
+            for (int changes = 0; changes < 1 + f % 5; ++changes) {
+                seed = seed * 1103515245 + 12345;
+                const int led = (seed >> 16) % ledsCount;
+                seed = seed * 1103515245 + 12345;
+                // dark colors too, so the luminosity threshold has work to do
+                frame[led] = (seed >> 8) & (f % 2 ? 0xffffff : 0x1f1f1f);
+            }
+        }
+        frames << frame;
+    }
+    return frames;
+}
+
+void expectSameColors(const RgbBuffer &expected, const RgbBuffer &actual, int frame) {
+    ASSERT_EQ(expected.count(), actual.count()) << "frame " << frame;
+    for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_EQ(expected.red()[i], actual.red()[i]) << "frame " << frame << " led " << i;
+        EXPECT_EQ(expected.green()[i], actual.green()[i]) << "frame " << frame << " led " << i;
+        EXPECT_EQ(expected.blue()[i], actual.blue()[i]) << "frame " << frame << " led " << i;
+    }
+}
+}
+
+TEST(LedDeviceTests, CachedColorsMatchFreshDevice) {
+    const int kLedsCount = 37;
+    const int kFramesCount = 80;
+
+    // swaps red and blue, so it is clear the table is in use
+    QTemporaryFile cubeFile;
+    ASSERT_TRUE(cubeFile.open());
+    cubeFile.write("LUT_3D_SIZE 2\n");
+    for (int i = 0; i < 8; ++i)
+        cubeFile.write(QByteArray::number(i >> 2 & 1) + " " + QByteArray::number(i >> 1 & 1) + " "
+                       + QByteArray::number(i & 1) + "\n");
+    cubeFile.flush();
+
+    QList<WBAdjustment> wbAdjustments;
+    for (int i = 0; i < kLedsCount; ++i) {
+        WBAdjustment wb = { 1.0 - i % 3 * 0.1, 1.0, 0.8 + i % 2 * 0.2 };
+        wbAdjustments << wb;
+    }
+
+    DeviceSettings settings = { 2.0, 100, 0, false, QList<WBAdjustment>(), QString() };
+    FakeLedDevice cached;
+    applySettings(&cached, settings);
+
+    const QList<QList<QRgb> > frames = makeFrames(kLedsCount, kFramesCount);
+    for (int f = 0; f < frames.count(); ++f) {
+        // every few frames one setting changes, through its own slot only
+        switch (f) {
+        case 8:  settings.gamma = 2.2; cached.setGamma(settings.gamma); break;
+        case 16: settings.brightness = 60; cached.setBrightness(settings.brightness); break;
+        case 24: settings.wbAdjustments = wbAdjustments; cached.updateWBAdjustments(settings.wbAdjustments); break;
+        case 32: settings.luminosityThreshold = 20; cached.setLuminosityThreshold(settings.luminosityThreshold); break;
+        case 40: settings.isMinimumLuminosityEnabled = true;
+                 cached.setMinimumLuminosityThresholdEnabled(settings.isMinimumLuminosityEnabled); break;
+        case 48: settings.gamma = 1.8; cached.setGamma(settings.gamma); break;
+        case 56: settings.colorLutFile = cubeFile.fileName(); cached.setColorLutFile(settings.colorLutFile); break;
+        case 64: settings.brightness = 100; cached.setBrightness(settings.brightness); break;
+        case 72: settings.colorLutFile.clear(); cached.setColorLutFile(settings.colorLutFile); break;
+        }
+
+        cached.setColors(frames[f]);
+
+        FakeLedDevice fresh;
+        applySettings(&fresh, settings);
+        fresh.setColors(frames[f]);
+
+        expectSameColors(fresh.colors(), cached.colors(), f);
+        if (HasFailure())
+            return;
+    }
+}
+
+namespace {
+// applyColorModifications() as it was before the tables, in doubles for every LED
+QVector<StructRgb> referenceModifications(const QList<QRgb> &inColors, double gamma, int brightness,
+                                          int luminosityThreshold, bool isMinimumLuminosityEnabled) {
+    namespace PM = PrismatikMath;
+    QVector<StructRgb> outColors(inColors.count());
+    RgbBuffer colors(inColors.count());
+    for (int i = 0; i < inColors.count(); i++) {
+        const double k = 4095/255.0;
+        outColors[i].r = qRed(inColors[i]) * k;
+        outColors[i].g = qGreen(inColors[i]) * k;
+        outColors[i].b = qBlue(inColors[i]) * k;
+        PM::gammaCorrection(gamma, outColors[i]);
+        colors.set(i, outColors[i]);
+    }
+
+    const StructLab avgColor = PM::toLab(PM::avgColor(colors));
+    for (int i = 0; i < outColors.count(); ++i) {
+        StructLab lab = PM::toLab(outColors[i]);
+        const int dl = luminosityThreshold - lab.l;
+        if (dl > 0) {
+            if (isMinimumLuminosityEnabled) {
+                const int kFadingRange = 5;
+                const double fadingCoeff = dl < kFadingRange ? (dl - kFadingRange)*(dl - kFadingRange)/(kFadingRange*kFadingRange): 1;
+                const char da = avgColor.a - lab.a;
+                const char db = avgColor.b - lab.b;
+                lab.l = luminosityThreshold;
+                lab.a += PM::round(da * fadingCoeff);
+                lab.b += PM::round(db * fadingCoeff);
+                outColors[i] = PM::toRgb(lab);
+            } else {
+                outColors[i].r = outColors[i].g = outColors[i].b = 0;
+            }
+        }
+        PM::brightnessCorrection(brightness, outColors[i]);
+    }
+    return outColors;
+}
+
+// lightness of toLab() before it is rounded, any conversion within a unit of
+// the doubles may round it the other way when it is this close to a half
+bool isLightnessOnEdge(const StructRgb &color) {
+    const double y = PrismatikMath::toXyz(color).y / 100;
+    const double l = y > 0.008856 ? 116 * std::cbrt(y) - 16 : 116 * (7.787 * y + 16.0 / 116) - 16;
+    return std::fabs(l - std::floor(l) - 0.5) < 1e-3;
+}
+}
+
+TEST(LedDeviceTests, LuminosityThresholdMatchesDoubles) {
+    namespace PM = PrismatikMath;
+
+    const int kLedsCount = 60;
+    const int kFramesCount = 20;
+    const int thresholds[] = { 5, 20, 50, 90 };
+    const double gammas[] = { 1.0, 2.0, 2.4 };
+    const int brightnesses[] = { 100, 70 };
+
+    int ledsCount = 0;
+    int exactCount = 0;
+    unsigned seed = 1;
+    for (int isMinimumLuminosity = 0; isMinimumLuminosity < 2; ++isMinimumLuminosity)
+    for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); ++t)
+    for (size_t g = 0; g < sizeof(gammas) / sizeof(gammas[0]); ++g)
+    for (size_t b = 0; b < sizeof(brightnesses) / sizeof(brightnesses[0]); ++b) {
+        FakeLedDevice device;
+        device.setGamma(gammas[g]);
+        device.setBrightness(brightnesses[b]);
+        device.setLuminosityThreshold(thresholds[t]);
+        device.setMinimumLuminosityThresholdEnabled(isMinimumLuminosity);
+
+        for (int f = 0; f < kFramesCount; ++f) {
+            // half of the LEDs dark, most of them end up below the threshold
+            QList<QRgb> frame;
+            for (int i = 0; i < kLedsCount; ++i) {
+                seed = seed * 1103515245 + 12345;
+                const QRgb mask = seed >> 28 & 1 ? 0xffffff : 0x3f3f3f;
+                seed = seed * 1103515245 + 12345;
+                frame << (seed >> 4 & mask);
+            }
+
+            device.setColors(frame);
+            const QVector<StructRgb> expected = referenceModifications(frame, gammas[g], brightnesses[b],
+                                                                       thresholds[t], isMinimumLuminosity);
+            for (int i = 0; i < kLedsCount; ++i) {
+                const StructRgb actual = device.colors().at(i);
+                ++ledsCount;
+                if (actual.r == expected[i].r && actual.g == expected[i].g && actual.b == expected[i].b) {
+                    ++exactCount;
+                    continue;
+                }
+                // lightness on the edge may move an LED across the threshold or the fading range
+                StructRgb corrected;
+                corrected.r = qRed(frame[i]) * (4095/255.0);
+                corrected.g = qGreen(frame[i]) * (4095/255.0);
+                corrected.b = qBlue(frame[i]) * (4095/255.0);
+                PM::gammaCorrection(gammas[g], corrected);
+                if (isLightnessOnEdge(corrected))
+                    continue;
+                // the tables are within a unit of Lab, which saturated colors may turn into
+                // more than that in a clipped channel
+                const StructLab expectedLab = PM::toLab(expected[i]);
+                const StructLab actualLab = PM::toLab(actual);
+                ASSERT_NEAR(expectedLab.l, actualLab.l, 1) << "color " << std::hex << frame[i];
+                ASSERT_NEAR(expectedLab.a, actualLab.a, 1) << "color " << std::hex << frame[i];
+                ASSERT_NEAR(expectedLab.b, actualLab.b, 1) << "color " << std::hex << frame[i];
+            }
+        }
+    }
+    EXPECT_GT(exactCount, ledsCount * 99 / 100);
+}
+
+namespace {
+// Device logging the commands it gets, in their order
+class RecordingLedDevice : public FakeLedDevice {
+public:
+    void setColors(const QList<QRgb> &colors) {
+        calls << QString("setColors %1 of %2").arg(colors.isEmpty() ? 0 : colors.first(), 0, 16).arg(colors.count());
+    }
+    void switchOffLeds() { calls << "switchOffLeds"; }
+    void setGamma(double value) { calls << QString("setGamma %1").arg(value); }
+    void setBrightness(int value) { calls << QString("setBrightness %1").arg(value); }
+
+    QStringList calls;
+};
+
+QList<QRgb> makeColors(QRgb color, int count = 3) {
+    QList<QRgb> colors;
+    for (int i = 0; i < count; ++i)
+        colors << color;
+    return colors;
+}
+
+// the device thread is this one, commands are taken when its events are processed
+QStringList processMailbox(RecordingLedDevice *device) {
+    QCoreApplication::processEvents();
+    const QStringList calls = device->calls;
+    device->calls.clear();
+    return calls;
+}
+}
+
+TEST(LedDeviceTests, BoardReportSkippedOnlyWhileBoardShowsIt) {
+    const int refreshInterval = 1000;
+    unsigned char sent[63];
+    unsigned char report[63];
+    for (size_t i = 0; i < sizeof(sent); ++i)
+        sent[i] = report[i] = static_cast<unsigned char>(i * 7);
+
+    EXPECT_FALSE(isBoardReportNeeded(sent, report, sizeof(report), 0, refreshInterval));
+    EXPECT_FALSE(isBoardReportNeeded(sent, report, sizeof(report), refreshInterval - 1, refreshInterval));
+    EXPECT_TRUE(isBoardReportNeeded(sent, report, sizeof(report), refreshInterval, refreshInterval))
+        << "unchanged colors are refreshed";
+    EXPECT_TRUE(isBoardReportNeeded(NULL, report, sizeof(report), 0, refreshInterval))
+        << "board doesn't show the last colors";
+
+    // the last byte is the blue low bits of the last LED
+    report[sizeof(report) - 1] ^= 1;
+    EXPECT_TRUE(isBoardReportNeeded(sent, report, sizeof(report), 0, refreshInterval));
+    EXPECT_FALSE(isBoardReportNeeded(sent, report, sizeof(report) - 1, 0, refreshInterval));
+}
+
+TEST(LedDeviceTests, MailboxKeepsNewestFrame) {
+    RecordingLedDevice device;
+    LedDeviceMailbox mailbox(&device);
+
+    mailbox.postColors(makeColors(0x111111));
+    mailbox.postColors(makeColors(0x222222, 5));
+    mailbox.postColors(makeColors(0x333333));
+    EXPECT_EQ(QStringList() << "setColors 333333 of 3", processMailbox(&device));
+
+    EXPECT_EQ(QStringList(), processMailbox(&device)) << "a frame is written once";
+}
+
+TEST(LedDeviceTests, MailboxKeepsLatestSetting) {
+    RecordingLedDevice device;
+    LedDeviceMailbox mailbox(&device);
+
+    mailbox.postSetting(LedDeviceCommands::SetGamma, &LedDeviceMailbox::DeviceSettings::gamma, 1.5);
+    mailbox.postSetting(LedDeviceCommands::SetBrightness, &LedDeviceMailbox::DeviceSettings::brightness, 40);
+    mailbox.postSetting(LedDeviceCommands::SetGamma, &LedDeviceMailbox::DeviceSettings::gamma, 2.5);
+    EXPECT_EQ(QStringList() << "setGamma 2.5" << "setBrightness 40", processMailbox(&device));
+
+    // settings posted after a process keep the values posted before
+    mailbox.postSetting(LedDeviceCommands::SetBrightness, &LedDeviceMailbox::DeviceSettings::brightness, 70);
+    mailbox.postCommand(LedDeviceCommands::SetGamma);
+    EXPECT_EQ(QStringList() << "setGamma 2.5" << "setBrightness 70", processMailbox(&device));
+}
+
+TEST(LedDeviceTests, MailboxSwitchesOffOverOlderFramesOnly) {
+    RecordingLedDevice device;
+    LedDeviceMailbox mailbox(&device);
+
+    mailbox.postColors(makeColors(0x111111));
+    mailbox.postOffLeds();
+    EXPECT_EQ(QStringList() << "switchOffLeds", processMailbox(&device));
+
+    mailbox.postColors(makeColors(0x111111));
+    mailbox.postOffLeds();
+    mailbox.postColors(makeColors(0x222222));
+    EXPECT_EQ(QStringList() << "switchOffLeds" << "setColors 222222 of 3", processMailbox(&device));
+}
+
+TEST(LedDeviceTests, MailboxAppliesSettingsBeforeFrame) {
+    RecordingLedDevice device;
+    LedDeviceMailbox mailbox(&device);
+
+    mailbox.postColors(makeColors(0x111111));
+    mailbox.postSetting(LedDeviceCommands::SetBrightness, &LedDeviceMailbox::DeviceSettings::brightness, 50);
+    EXPECT_EQ(QStringList() << "setBrightness 50" << "setColors 111111 of 3", processMailbox(&device));
+}
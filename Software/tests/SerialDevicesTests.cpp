@@ -0,0 +1,176 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QtSerialPort/QSerialPort>
+#include "devices/SerialFrameEncoder.hpp"
+#include "devices/SerialFrameWriter.hpp"
+#include "gtest/gtest.h"
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+namespace {
+StructRgb rgb(unsigned r, unsigned g, unsigned b) {
+    StructRgb color;
+    color.r = r;
+    color.g = g;
+    color.b = b;
+    return color;
+}
+
+RgbBuffer makeColors() {
+    RgbBuffer colors(2);
+    colors.set(0, rgb(0x100, 0x200, 0x300));
+    colors.set(1, rgb(0xfff, 0x0, 0x7f0));
+    return colors;
+}
+}
+
+TEST(SerialDevicesTests, EncoderKeepsHeaderAndSequence) {
+    SerialFrameEncoder encoder;
+    encoder.setHeader(QByteArray("Ada"));
+    encoder.setLedsCount(2);
+    encoder.setColorSequence("GBR");
+    ASSERT_EQ(encoder.frameSize(), 3 + 2 * 3);
+
+    const QByteArray frame = encoder.encode(makeColors(), 4);
+    const uchar expected[] = { 'A', 'd', 'a', 0x20, 0x30, 0x10, 0x00, 0x7f, 0xff };
+    EXPECT_EQ(frame, QByteArray(reinterpret_cast<const char *>(expected), sizeof(expected)));
+}
+
+TEST(SerialDevicesTests, EncoderClampsAndFallsBackToRgb) {
+    SerialFrameEncoder encoder;
+    encoder.setHeader(QByteArray(1, (char)255));
+    encoder.setLedsCount(3);
+    encoder.setColorSequence("RRB");
+
+    const QByteArray frame = encoder.encode(makeColors(), 4, 254);
+    const uchar expected[] = { 0xff, 0x10, 0x20, 0x30, 0xfe, 0x00, 0x7f, 0, 0, 0 };
+    EXPECT_EQ(frame, QByteArray(reinterpret_cast<const char *>(expected), sizeof(expected)));
+
+    const QByteArray black = encoder.encodeBlack();
+    EXPECT_EQ(black, QByteArray(1, (char)255) + QByteArray(9, 0));
+}
+
+TEST(SerialDevicesTests, WireTimeRoundsUp) {
+    EXPECT_EQ(SerialFrameWriter::wireTime(6 + 3 * 25, 115200), 8);
+    EXPECT_EQ(SerialFrameWriter::wireTime(100, 1000000), 1);
+    EXPECT_EQ(SerialFrameWriter::wireTime(100, 0), 0);
+}
+
+#ifdef Q_OS_UNIX
+namespace {
+// Master side of a pseudo-terminal pair, the writer gets the slave one as its port
+class PseudoTerminal {
+public:
+    PseudoTerminal() : m_master(posix_openpt(O_RDWR | O_NOCTTY)) {
+        if (m_master >= 0 && grantpt(m_master) == 0 && unlockpt(m_master) == 0) {
+            m_slaveName = QString::fromLocal8Bit(ptsname(m_master));
+            fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+        }
+    }
+    ~PseudoTerminal() {
+        if (m_master >= 0)
+            close(m_master);
+    }
+
+    const QString & slaveName() const { return m_slaveName; }
+
+    QByteArray readAll() {
+        QByteArray result;
+        char buffer[256];
+        ssize_t bytesRead;
+        while ((bytesRead = read(m_master, buffer, sizeof(buffer))) > 0)
+            result.append(buffer, bytesRead);
+        return result;
+    }
+
+private:
+    int m_master;
+    QString m_slaveName;
+};
+
+QByteArray makeFrame(char value, int size) {
+    return QByteArray(size, value);
+}
+}
+
+TEST(SerialDevicesTests, WriterKeepsOneFrameInFlight) {
+    PseudoTerminal terminal;
+    ASSERT_FALSE(terminal.slaveName().isEmpty());
+
+    QSerialPort port;
+    port.setPortName(terminal.slaveName());
+    ASSERT_TRUE(port.open(QIODevice::WriteOnly));
+    port.setBaudRate(QSerialPort::Baud115200);
+
+    SerialFrameWriter writer;
+    EXPECT_FALSE(writer.write(makeFrame(1, 10)));
+
+    writer.setPort(&port);
+    writer.setBaudRate(115200);
+
+    const int frameSize = 300;
+    const int framesCount = 10;
+    for (int i = 0; i < framesCount; ++i)
+        EXPECT_TRUE(writer.write(makeFrame('a' + i, frameSize)));
+
+    // the first frame is in flight, only the last one of the others waits
+    EXPECT_EQ(writer.queueDepth(), 2);
+    EXPECT_EQ(writer.framesWritten(), 1u);
+    EXPECT_EQ(writer.framesReplaced(), static_cast<quint64>(framesCount - 2));
+
+    QByteArray received;
+    QElapsedTimer timeout;
+    timeout.start();
+    while ((writer.queueDepth() > 0 || received.size() < 2 * frameSize) && timeout.elapsed() < 5000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        received.append(terminal.readAll());
+    }
+
+    EXPECT_EQ(writer.queueDepth(), 0);
+    EXPECT_EQ(writer.framesWritten(), 2u);
+    EXPECT_EQ(received, makeFrame('a', frameSize) + makeFrame('a' + framesCount - 1, frameSize));
+
+    writer.setPort(NULL);
+    EXPECT_FALSE(writer.write(makeFrame(1, 10)));
+}
+
+TEST(SerialDevicesTests, WriterFlushesWaitingFrameBeforeClose) {
+    PseudoTerminal terminal;
+    ASSERT_FALSE(terminal.slaveName().isEmpty());
+
+    QSerialPort port;
+    port.setPortName(terminal.slaveName());
+    ASSERT_TRUE(port.open(QIODevice::WriteOnly));
+    port.setBaudRate(QSerialPort::Baud115200);
+
+    SerialFrameWriter writer;
+    writer.setPort(&port);
+    writer.setBaudRate(115200);
+
+    // the second frame waits, like the black one of switching off before close()
+    const int frameSize = 300;
+    EXPECT_TRUE(writer.write(makeFrame('x', frameSize)));
+    EXPECT_TRUE(writer.write(makeFrame('y', frameSize)));
+    ASSERT_EQ(writer.queueDepth(), 2);
+
+    // no events processed, the frames go out from flush() alone
+    EXPECT_TRUE(writer.flush(5000));
+    EXPECT_EQ(writer.framesWritten(), 2u);
+    EXPECT_EQ(port.bytesToWrite(), 0);
+
+    QByteArray received;
+    QElapsedTimer timeout;
+    timeout.start();
+    while (received.size() < 2 * frameSize && timeout.elapsed() < 5000)
+        received.append(terminal.readAll());
+    EXPECT_EQ(received, makeFrame('x', frameSize) + makeFrame('y', frameSize));
+
+    writer.setPort(NULL);
+    port.close();
+    EXPECT_FALSE(writer.flush(5000));
+}
+#endif
@@ -105,3 +105,26 @@ TEST_F(SettingsTest, resetDefault) {
     // Check that now settings filled with default values.
     EXPECT_EQ(Profile::MoodLamp::IsLiquidMode, Settings::instance()->isMoodLampLiquidMode());
 }
+
+TEST_F(SettingsTest, hostSmoothingIsOffByDefault) {
+    EXPECT_TRUE(Settings::Initialize("./", Settings::Overrides()));
+    // Device/Smooth has a default for Lightpack firmware, host smoothing must not pick it up
+    EXPECT_EQ(TemporalInterpolator::ModeOff, Settings::instance()->getDeviceSmoothMode());
+
+    Settings::instance()->setDeviceSmoothMode(TemporalInterpolator::ModeCriticallyDamped);
+    EXPECT_EQ(TemporalInterpolator::ModeCriticallyDamped, Settings::instance()->getDeviceSmoothMode());
+    Settings::instance()->setDeviceSmoothMode(TemporalInterpolator::ModeOff);
+    EXPECT_EQ(TemporalInterpolator::ModeOff, Settings::instance()->getDeviceSmoothMode());
+}
+
+TEST_F(SettingsTest, adaptivePacingIsOffByDefault) {
+    EXPECT_TRUE(Settings::Initialize("./", Settings::Overrides()));
+    // the idle interval turns pacing on only above the grab interval
+    EXPECT_LE(Settings::instance()->getGrabIdleSlowdown(), Settings::instance()->getGrabSlowdown());
+
+    Settings::instance()->setGrabSlowdown(Profile::Grab::SlowdownMin);
+    EXPECT_LE(Settings::instance()->getGrabIdleSlowdown(), Settings::instance()->getGrabSlowdown());
+
+    Settings::instance()->setGrabIdleSlowdown(200);
+    EXPECT_EQ(200, Settings::instance()->getGrabIdleSlowdown());
+}
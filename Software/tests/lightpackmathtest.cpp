@@ -1,4 +1,10 @@
+#include <cmath>
+#include <QTemporaryFile>
+#include <QVector>
+#include "ColorLut3d.hpp"
+#include "ColorTables.hpp"
 #include "PrismatikMath.hpp"
+#include "TemporalInterpolator.hpp"
 #include "gtest/gtest.h"
 
 TEST(LightpackMathTest, HSV) {
@@ -16,3 +22,409 @@ TEST(LightpackMathTest, HSV) {
     EXPECT_EQ(testRgb, PM::withChromaHSV(testRgb, PM::getChromaHSV(testRgb)))
         << "getChromaHSV() is incorrect";
 }
+
+TEST(LightpackMathTest, TransferLutsMatchCorrections) {
+    namespace PM = PrismatikMath;
+
+    quint16 gammaLut[PM::TransferLutSize];
+    quint16 brightnessLut[PM::TransferLutSize];
+    const double gammas[] = {0.01, 0.5, 1.0, 2.0, 2.2, 10.0};
+    const unsigned int brightnesses[] = {0, 1, 33, 50, 99, 100};
+
+    for (size_t t = 0; t < sizeof(gammas) / sizeof(gammas[0]); ++t) {
+        PM::fillGammaLut(gammas[t], gammaLut);
+        PM::fillBrightnessLut(brightnesses[t], brightnessLut);
+        for (unsigned int v = 0; v < static_cast<unsigned int>(PM::TransferLutSize); ++v) {
+            StructRgb rgb;
+            rgb.r = rgb.g = rgb.b = v;
+            PM::gammaCorrection(gammas[t], rgb);
+            ASSERT_EQ(rgb.r, gammaLut[v]) << "gamma " << gammas[t] << ", value " << v;
+
+            rgb.r = rgb.g = rgb.b = v;
+            PM::brightnessCorrection(brightnesses[t], rgb);
+            ASSERT_EQ(rgb.r, brightnessLut[v]) << "brightness " << brightnesses[t] << ", value " << v;
+        }
+    }
+}
+
+TEST(LightpackMathTest, BrightnessLutMatchesDoubles) {
+    namespace PM = PrismatikMath;
+
+    quint16 brightnessLut[PM::TransferLutSize];
+    for (unsigned int brightness = 0; brightness <= 100; ++brightness) {
+        PM::fillBrightnessLut(brightness, brightnessLut);
+        for (unsigned int v = 0; v < static_cast<unsigned int>(PM::TransferLutSize); ++v) {
+            // brightnessCorrection() before any tables, doubles may fall just short of a whole number
+            const unsigned int withDoubles = (brightness / 100.0) * v;
+            ASSERT_EQ(withDoubles, brightnessLut[v]) << "brightness " << brightness << ", value " << v;
+        }
+    }
+}
+
+TEST(LightpackMathTest, ColorTablesMatchRuntimeMath) {
+    namespace PM = PrismatikMath;
+
+    for (double x = 0.001; x < 2; x *= 1.01) {
+        ASSERT_NEAR(std::pow(x, 2.4), PM::Constexpr::pow(x, 2.4), 1e-13 * std::pow(x, 2.4)) << x;
+        ASSERT_NEAR(std::pow(x, 1 / 2.4), PM::Constexpr::pow(x, 1 / 2.4), 1e-13 * std::pow(x, 1 / 2.4)) << x;
+    }
+
+    // rounded to the nearest fixed point value, give or take the error of the series
+    const double kRounding = 0.5 + 1e-6;
+    for (int i = 0; i < PM::TransferLutSize; ++i) {
+        double c = i / 4095.0;
+        c = c > 0.04045 ? std::pow((c + 0.055) / 1.055, 2.4) : c / 12.92;
+        ASSERT_NEAR(c * PM::FixedPointScale, PM::LinearizationTable.values[i], kRounding) << i;
+    }
+    for (int i = 0; i < PM::CompandingTableSize + 2; ++i) {
+        const double c = static_cast<double>(i) / PM::CompandingTableSize;
+        const double s = c > 0.0031308 ? 1.055 * std::pow(c, 1 / 2.4) - 0.055 : 12.92 * c;
+        ASSERT_NEAR(s * 4095 * (1 << PM::CompandedShift), PM::CompandingTable.values[i], kRounding) << i;
+    }
+    for (int i = 0; i < PM::LabCompressionTableSize + 2; ++i) {
+        const double t = static_cast<double>(i) / PM::LabCompressionTableSize;
+        const double f = t > 0.008856 ? std::cbrt(t) : 7.787 * t + 16.0 / 116;
+        ASSERT_NEAR(f * PM::FixedPointScale, PM::LabCompressionTable.values[i], kRounding) << i;
+    }
+}
+
+TEST(LightpackMathTest, BatchLabMatchesScalar) {
+    namespace PM = PrismatikMath;
+
+    const int kSteps = 66;
+    RgbBuffer rgbs(kSteps * kSteps * kSteps + 1);
+    for (int i = 0; i < rgbs.count() - 1; ++i) {
+        rgbs.red()[i] = i / (kSteps * kSteps) * 63;
+        rgbs.green()[i] = i / kSteps % kSteps * 62;
+        rgbs.blue()[i] = i % kSteps * 61;
+    }
+    StructRgb white;
+    white.r = white.g = white.b = 4095;
+    rgbs.set(rgbs.count() - 1, white);
+
+    QVector<StructLab> labs(rgbs.count());
+    PM::toLab(rgbs, labs.data());
+    for (int i = 0; i < rgbs.count(); ++i) {
+        const StructRgb rgb = rgbs.at(i);
+        const StructLab expected = PM::toLab(rgb);
+        ASSERT_NEAR(expected.l, labs[i].l, 1) << rgb.r << " " << rgb.g << " " << rgb.b;
+        ASSERT_NEAR(expected.a, labs[i].a, 1) << rgb.r << " " << rgb.g << " " << rgb.b;
+        ASSERT_NEAR(expected.b, labs[i].b, 1) << rgb.r << " " << rgb.g << " " << rgb.b;
+    }
+}
+
+TEST(LightpackMathTest, BatchRgbMatchesScalar) {
+    namespace PM = PrismatikMath;
+
+    QVector<StructLab> labs;
+    for (int l = 0; l <= 100; ++l)
+        for (int a = -128; a <= 127; a += 3)
+            for (int b = -128; b <= 127; b += 5) {
+                StructLab lab;
+                lab.l = l;
+                lab.a = a;
+                lab.b = b;
+                labs.append(lab);
+            }
+
+    RgbBuffer rgbs;
+    PM::toRgb(labs.constData(), labs.size(), rgbs);
+    ASSERT_EQ(labs.size(), rgbs.count());
+    for (int i = 0; i < labs.size(); ++i) {
+        const StructRgb expected = PM::toRgb(labs[i]);
+        const int l = labs[i].l, a = labs[i].a, b = labs[i].b;
+        ASSERT_NEAR(expected.r, rgbs.red()[i], 1) << l << " " << a << " " << b;
+        ASSERT_NEAR(expected.g, rgbs.green()[i], 1) << l << " " << a << " " << b;
+        ASSERT_NEAR(expected.b, rgbs.blue()[i], 1) << l << " " << a << " " << b;
+    }
+}
+
+TEST(LightpackMathTest, RgbBufferKeepsPlanesAligned) {
+    RgbBuffer colors(3);
+    StructRgb color;
+    color.r = 1;
+    color.g = 2;
+    color.b = 3;
+    colors.set(2, color);
+
+    colors.resize(1000);
+    ASSERT_EQ(1000, colors.count());
+    EXPECT_EQ(0u, reinterpret_cast<quintptr>(colors.red()) % RgbBuffer::Alignment);
+    EXPECT_EQ(0u, reinterpret_cast<quintptr>(colors.green()) % RgbBuffer::Alignment);
+    EXPECT_EQ(0u, reinterpret_cast<quintptr>(colors.blue()) % RgbBuffer::Alignment);
+    EXPECT_EQ(3u, colors.at(2).b);
+    EXPECT_EQ(0u, colors.at(999).r);
+
+    colors.resize(2);
+    colors.resize(3);
+    EXPECT_EQ(0u, colors.at(2).g) << "colors added by resize() must be black";
+
+    colors.fill(color);
+    EXPECT_EQ(2u, PrismatikMath::avgColor(colors).g);
+}
+
+TEST(LightpackMathTest, BatchLuminanceMatchesXyz) {
+    namespace PM = PrismatikMath;
+
+    RgbBuffer rgbs(4096);
+    for (int i = 0; i < rgbs.count(); ++i) {
+        rgbs.red()[i] = i;
+        rgbs.green()[i] = (i * 7) % 4096;
+        rgbs.blue()[i] = 4095 - i;
+    }
+
+    QVector<quint32> luminances(rgbs.count());
+    PM::toLuminance(rgbs, luminances.data());
+    for (int i = 0; i < rgbs.count(); ++i)
+        ASSERT_NEAR(PM::toXyz(rgbs.at(i)).y / 100 * PM::LuminanceScale, luminances[i], 2) << i;
+
+    RgbBuffer white(1);
+    white.red()[0] = white.green()[0] = white.blue()[0] = 4095;
+    PM::toLuminance(white, luminances.data());
+    EXPECT_EQ(PM::LuminanceScale, luminances[0]);
+}
+
+namespace {
+// .cube file of a lattice mapping every color with \a matrix
+void writeCube(QTemporaryFile *file, int size, const float matrix[3][3], const char *header = "") {
+    ASSERT_TRUE(file->open());
+    file->write(QByteArray("# generated by the tests\nTITLE \"matrix\"\n"));
+    file->write(QByteArray(header));
+    file->write("LUT_3D_SIZE " + QByteArray::number(size) + "\n");
+    for (int b = 0; b < size; ++b)
+        for (int g = 0; g < size; ++g)
+            for (int r = 0; r < size; ++r) {
+                const float in[3] = { r / (size - 1.0f), g / (size - 1.0f), b / (size - 1.0f) };
+                std::string line;
+                for (int c = 0; c < 3; ++c)
+                    line += std::to_string(matrix[c][0] * in[0] + matrix[c][1] * in[1] + matrix[c][2] * in[2]) + (c < 2 ? " " : "\n");
+                file->write(QByteArray(line.c_str()));
+            }
+    file->flush();
+}
+}
+
+TEST(LightpackMathTest, ColorLut3dInterpolatesLinearMaps) {
+    // tetrahedral interpolation reproduces linear maps exactly
+    const float matrix[3][3] = {
+        { 0.8f, 0.2f, 0.0f },
+        { 0.0f, 1.0f, 0.0f },
+        { 0.5f, 0.0f, 0.5f }
+    };
+    QTemporaryFile cubeFile;
+    writeCube(&cubeFile, 17, matrix);
+
+    ColorLut3d lut;
+    ASSERT_TRUE(lut.load(cubeFile.fileName()));
+    ASSERT_EQ(17, lut.size());
+
+    const int kSteps = 23;
+    RgbBuffer colors(kSteps * kSteps * kSteps);
+    for (int i = 0; i < colors.count(); ++i) {
+        colors.red()[i] = i / (kSteps * kSteps) * 4095 / (kSteps - 1);
+        colors.green()[i] = i / kSteps % kSteps * 4095 / (kSteps - 1);
+        colors.blue()[i] = i % kSteps * 4095 / (kSteps - 1);
+    }
+    RgbBuffer result;
+    lut.apply(colors, result);
+    ASSERT_EQ(colors.count(), result.count());
+    for (int i = 0; i < colors.count(); ++i) {
+        const StructRgb in = colors.at(i);
+        ASSERT_NEAR(0.8 * in.r + 0.2 * in.g, result.red()[i], 1) << i;
+        ASSERT_NEAR(in.g, result.green()[i], 1) << i;
+        ASSERT_NEAR(0.5 * in.r + 0.5 * in.b, result.blue()[i], 1) << i;
+    }
+}
+
+TEST(LightpackMathTest, ColorLut3dRejectsBrokenFiles) {
+    const float identity[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    QTemporaryFile cubeFile;
+    writeCube(&cubeFile, 5, identity);
+    ColorLut3d lut;
+    ASSERT_TRUE(lut.load(cubeFile.fileName()));
+
+    QTemporaryFile oneDimensional;
+    writeCube(&oneDimensional, 3, identity, "LUT_1D_SIZE 3\n");
+    EXPECT_FALSE(lut.load(oneDimensional.fileName()));
+
+    QTemporaryFile truncated;
+    ASSERT_TRUE(truncated.open());
+    truncated.write(QByteArray("LUT_3D_SIZE 2\n0 0 0\n1 0 0\n"));
+    truncated.flush();
+    EXPECT_FALSE(lut.load(truncated.fileName()));
+
+    EXPECT_FALSE(lut.load("no such file.cube"));
+    EXPECT_EQ(5, lut.size()) << "a failed load must keep the current table";
+}
+
+TEST(LightpackMathTest, ColorLut3dStaysInsideCells) {
+    // interpolated colors mix the corners of their lattice cell with weights of
+    // the right tetrahedron only, which never leaves the range of the corners
+    const int kSize = 3;
+    float reds[kSize * kSize * kSize];
+    QTemporaryFile cubeFile;
+    ASSERT_TRUE(cubeFile.open());
+    cubeFile.write("LUT_3D_SIZE " + QByteArray::number(kSize) + "\n");
+    for (int i = 0; i < kSize * kSize * kSize; ++i) {
+        const int tenths = (i * 37) % 11;
+        reds[i] = tenths / 10.0f;
+        cubeFile.write(QByteArray::number(tenths) + "e-1 0 0\n");
+    }
+    cubeFile.flush();
+
+    ColorLut3d lut;
+    ASSERT_TRUE(lut.load(cubeFile.fileName()));
+
+    const int kSteps = 41;
+    RgbBuffer colors(kSteps * kSteps * kSteps);
+    for (int i = 0; i < colors.count(); ++i) {
+        colors.red()[i] = i / (kSteps * kSteps) * 4095 / (kSteps - 1);
+        colors.green()[i] = i / kSteps % kSteps * 4095 / (kSteps - 1);
+        colors.blue()[i] = i % kSteps * 4095 / (kSteps - 1);
+    }
+    RgbBuffer result;
+    lut.apply(colors, result);
+    for (int i = 0; i < colors.count(); ++i) {
+        int cell[3];
+        for (int c = 0; c < 3; ++c) {
+            const quint16 value = c == 0 ? colors.red()[i] : (c == 1 ? colors.green()[i] : colors.blue()[i]);
+            cell[c] = qMin(value * (kSize - 1) / 4095, kSize - 2);
+        }
+        float min = 1, max = 0;
+        for (int corner = 0; corner < 8; ++corner) {
+            const int index = (cell[0] + (corner & 1)) + (cell[1] + (corner >> 1 & 1)) * kSize
+                    + (cell[2] + (corner >> 2 & 1)) * kSize * kSize;
+            min = qMin(min, reds[index]);
+            max = qMax(max, reds[index]);
+        }
+        ASSERT_GE(result.red()[i], min * 4095 - 1) << i;
+        ASSERT_LE(result.red()[i], max * 4095 + 1) << i;
+    }
+}
+
+TEST(LightpackMathTest, ColorLut3dBlocksMatchSingleColors) {
+    // a cross-channel table with ties between the fractions, blocks of colors
+    // go through the vectorized path, single ones through the scalar one
+    const float matrix[3][3] = {
+        { 0.7f, 0.4f, -0.1f },
+        { 0.1f, 0.8f, 0.2f },
+        { -0.2f, 0.3f, 0.9f }
+    };
+    QTemporaryFile cubeFile;
+    writeCube(&cubeFile, 9, matrix, "DOMAIN_MIN 0.05 0 0\nDOMAIN_MAX 1 0.9 1\n");
+    ColorLut3d lut;
+    ASSERT_TRUE(lut.load(cubeFile.fileName()));
+
+    RgbBuffer colors(1001);
+    for (int i = 0; i < colors.count(); ++i) {
+        colors.red()[i] = i * 37 % 4096;
+        colors.green()[i] = i % 3 == 0 ? colors.red()[i] : i * 1031 % 4096;
+        colors.blue()[i] = i % 5 == 0 ? colors.green()[i] : i * 2897 % 4096;
+    }
+    RgbBuffer result;
+    lut.apply(colors, result);
+
+    RgbBuffer single(1), singleResult;
+    for (int i = 0; i < colors.count(); ++i) {
+        single.set(0, colors.at(i));
+        lut.apply(single, singleResult);
+        ASSERT_EQ(singleResult.red()[0], result.red()[i]) << i;
+        ASSERT_EQ(singleResult.green()[0], result.green()[i]) << i;
+        ASSERT_EQ(singleResult.blue()[0], result.blue()[i]) << i;
+    }
+}
+
+namespace {
+RgbBuffer grayBuffer(int count, quint16 value) {
+    RgbBuffer colors(count);
+    StructRgb gray;
+    gray.r = gray.g = gray.b = value;
+    colors.fill(gray);
+    return colors;
+}
+}
+
+TEST(LightpackMathTest, TemporalInterpolatorTiming) {
+    TemporalInterpolator interpolator;
+    interpolator.setSmoothingTime(100);
+    RgbBuffer colors;
+
+    interpolator.setMode(TemporalInterpolator::ModeLinear);
+    interpolator.setTarget(grayBuffer(3, 0));
+    EXPECT_FALSE(interpolator.advance(1000, colors)) << "the first target is jumped to";
+    interpolator.setTarget(grayBuffer(3, 4000));
+    EXPECT_TRUE(interpolator.advance(25000, colors));
+    EXPECT_NEAR(1000, colors.at(2).g, 1);
+    EXPECT_TRUE(interpolator.advance(25000, colors));
+    EXPECT_NEAR(2000, colors.at(0).b, 1);
+    // a new target starts from where the colors are
+    interpolator.setTarget(grayBuffer(3, 0));
+    EXPECT_TRUE(interpolator.advance(50000, colors));
+    EXPECT_NEAR(1000, colors.at(1).r, 1);
+    EXPECT_FALSE(interpolator.advance(50000, colors));
+    EXPECT_EQ(0u, colors.at(1).r);
+
+    interpolator.setMode(TemporalInterpolator::ModeExponential);
+    interpolator.setTarget(grayBuffer(3, 4000));
+    for (int frame = 0; frame < 10; ++frame)
+        ASSERT_TRUE(interpolator.advance(10000, colors));
+    EXPECT_NEAR(4000 * (1 - std::exp(-1.0)), colors.at(0).r, 2);
+    int frames = 0;
+    while (interpolator.advance(10000, colors))
+        ASSERT_LT(++frames, 1000);
+    EXPECT_EQ(4000u, colors.at(0).r);
+
+    interpolator.setTarget(grayBuffer(4, 100));
+    EXPECT_FALSE(interpolator.advance(0, colors)) << "another count of LEDs is jumped to";
+    EXPECT_EQ(100u, colors.at(3).r);
+}
+
+TEST(LightpackMathTest, TemporalInterpolatorCriticallyDampedDoesNotOvershoot) {
+    TemporalInterpolator coarse, fine;
+    RgbBuffer coarseColors, fineColors;
+    TemporalInterpolator *interpolators[] = { &coarse, &fine };
+    for (int k = 0; k < 2; ++k) {
+        interpolators[k]->setMode(TemporalInterpolator::ModeCriticallyDamped);
+        interpolators[k]->setSmoothingTime(80);
+        interpolators[k]->setTarget(grayBuffer(1, 4095));
+        interpolators[k]->setTarget(grayBuffer(1, 0));
+    }
+
+    // frames of any length follow the same curve
+    unsigned int previous = 4095;
+    for (int frame = 0; frame < 20; ++frame) {
+        coarse.advance(20000, coarseColors);
+        for (int k = 0; k < 4; ++k)
+            fine.advance(5000, fineColors);
+        ASSERT_NEAR(coarseColors.at(0).r, fineColors.at(0).r, 2) << frame;
+        ASSERT_LE(coarseColors.at(0).r, previous) << frame;
+        previous = coarseColors.at(0).r;
+    }
+
+    // a target changed at the start of a move keeps the little speed there and doesn't pass the new one
+    coarse.setTarget(grayBuffer(1, 4095));
+    coarse.advance(1000, coarseColors);
+    coarse.setTarget(grayBuffer(1, 2000));
+    int frames = 0;
+    while (coarse.advance(5000, coarseColors)) {
+        ASSERT_LE(coarseColors.at(0).r, 2000u);
+        ASSERT_LT(++frames, 1000);
+    }
+    EXPECT_EQ(2000u, coarseColors.at(0).r);
+
+    // a fast move towards a close target passes it once and comes back without oscillating
+    coarse.setTarget(grayBuffer(1, 0));
+    while (coarse.advance(5000, coarseColors)) {}
+    coarse.setTarget(grayBuffer(1, 4095));
+    coarse.advance(20000, coarseColors);
+    coarse.setTarget(grayBuffer(1, 600));
+    bool isPassed = false;
+    for (frames = 0; coarse.advance(5000, coarseColors); ++frames) {
+        ASSERT_LT(frames, 1000);
+        isPassed = isPassed || coarseColors.at(0).r > 600;
+        if (isPassed)
+            ASSERT_GE(coarseColors.at(0).r, 600u) << frames;
+    }
+    EXPECT_TRUE(isPassed);
+    EXPECT_EQ(600u, coarseColors.at(0).r);
+}
@@ -5,6 +5,12 @@
 #-------------------------------------------------
 
 QT         += widgets network testlib
+win32 {
+    QT += serialport
+}
+macx {
+    QT += serialport
+}
 
 TARGET      = LightpackTests
 DESTDIR     = bin
@@ -63,10 +69,22 @@ HEADERS += \
     ../common/defs.h \
     ../grab/include/calculations.hpp \
     ../grab/include/GrabberContext.hpp \
+    ../grab/include/SummedAreaTable.hpp \
+    ../grab/include/ReductionPool.hpp \
+    ../grab/include/CaptureRegions.hpp \
+    ../grab/include/ColorsTripleBuffer.hpp \
+    ../grab/include/FramePacer.hpp \
+    ../grab/include/ReplayGrabber.hpp \
     ../math/include/PrismatikMath.hpp \
+    ../math/include/RgbBuffer.hpp \
+    ../math/include/ColorLut3d.hpp \
+    ../math/include/ColorTables.hpp \
+    ../math/include/TemporalInterpolator.hpp \
+    ../prismatic/AbstractLedDevice.hpp \
     ../prismatic/ApiServer.hpp \
     ../prismatic/ApiServerSetColorTask.hpp \
     ../prismatic/enums.hpp \
+    ../prismatic/LedDeviceMailbox.hpp \
     ../prismatic/LightpackCommandLineParser.hpp \
     ../prismatic/LightpackPluginInterface.hpp \
     ../prismatic/Plugin.hpp \
@@ -74,6 +92,9 @@ HEADERS += \
     ../prismatic/settings/Settings.hpp \
     ../prismatic/settings/SettingsSignals.hpp \
     ../prismatic/UpdatesProcessor.hpp \
+    ../prismatic/devices/BoardReportFilter.hpp \
+    ../prismatic/devices/SerialFrameEncoder.hpp \
+    ../prismatic/devices/SerialFrameWriter.hpp \
     mocks/SettingsSourceMockup.hpp \
     mocks/SettingsWindowMockup.hpp \
     mocks/SignalAndSlotObject.hpp \
@@ -81,8 +102,10 @@ HEADERS += \
 
 SOURCES += \
     ../third_party/gtest/src/gtest-all.cc \
+    ../prismatic/AbstractLedDevice.cpp \
     ../prismatic/ApiServer.cpp \
     ../prismatic/ApiServerSetColorTask.cpp \
+    ../prismatic/LedDeviceMailbox.cpp \
     ../prismatic/LightpackCommandLineParser.cpp \
     ../prismatic/LightpackPluginInterface.cpp \
     ../prismatic/Plugin.cpp \
@@ -93,10 +116,14 @@ SOURCES += \
     ../prismatic/settings/SettingsProfiles.cpp \
     ../prismatic/settings/SettingsSignals.cpp \
     ../prismatic/UpdatesProcessor.cpp \
+    ../prismatic/devices/BoardReportFilter.cpp \
+    ../prismatic/devices/SerialFrameEncoder.cpp \
+    ../prismatic/devices/SerialFrameWriter.cpp \
     AppVersionTest.cpp \
     GrabCalculationTest.cpp \
     GrabTests.cpp \
     LightpackApiTest.cpp \
+    LedDeviceTests.cpp \
     LightpackCommandLineParserTest.cpp \
     lightpackmathtest.cpp \
     mocks/SettingsSourceMockup.cpp \
@@ -110,8 +137,15 @@ SOURCES += \
     CommandSetColorParsingTests.cpp \
     PluginTest.cpp \
     PluginsManagerTest.cpp \
+    SerialDevicesTests.cpp \
     mocks/ProcessWaiter.cpp
 
+unix:!macx{
+    # For X11 grabber
+    LIBS += -lXext -lX11 -lX11-xcb -lxcb -lxcb-shm -lXdamage -lXfixes
+    LIBS += -L../qtserialport/lib -lQt5SerialPort
+}
+
 win32{
     HEADERS += \
         HooksTest.h \